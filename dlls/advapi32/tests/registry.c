@@ -4535,6 +4535,102 @@ static void test_RegRenameKey(void)
     RegCloseKey(key);
 }
 
+static void test_many_subkeys(void)
+{
+    DWORD count = winetest_interactive ? 100000 : 2000;
+    DWORD i, n, start, subkeys, values, size;
+    char name[32], prev[32];
+    HKEY key, subkey;
+    LSTATUS ret;
+
+    ret = RegCreateKeyExA(hkey_main, "TestManySubkeys", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+
+    /* create them in a scrambled order, 7919 is prime so every index is used */
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        n = (DWORD)(((ULONGLONG)i * 7919) % count);
+        sprintf(name, "Subkey%06lu", n);
+        ret = RegCreateKeyExA(key, name, 0, NULL, 0, KEY_READ, NULL, &subkey, NULL);
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+        RegCloseKey(subkey);
+        sprintf(name, "Value%06lu", n);
+        ret = RegSetValueExA(key, name, 0, REG_DWORD, (BYTE *)&n, sizeof(n));
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+    }
+    trace("created %lu subkeys and values in %lu ms\n", count, GetTickCount() - start);
+
+    ret = RegQueryInfoKeyA(key, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    ok(subkeys == count, "got %lu subkeys\n", subkeys);
+    ok(values == count, "got %lu values\n", values);
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        DWORD data = ~0u;
+
+        sprintf(name, "SUBKEY%06lu", i);
+        ret = RegOpenKeyExA(key, name, 0, KEY_READ, &subkey);
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+        RegCloseKey(subkey);
+        sprintf(name, "value%06lu", i);
+        size = sizeof(data);
+        ret = RegQueryValueExA(key, name, NULL, NULL, (BYTE *)&data, &size);
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+        ok(data == i, "%s: got %lu\n", name, data);
+    }
+    trace("opened %lu subkeys and values in %lu ms\n", count, GetTickCount() - start);
+
+    ret = RegOpenKeyExA(key, "Subkey", 0, KEY_READ, &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "Unexpected return value %ld.\n", ret);
+    ret = RegQueryValueExA(key, "Value", NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_FILE_NOT_FOUND, "Unexpected return value %ld.\n", ret);
+
+    /* enumeration is sorted */
+    prev[0] = 0;
+    for (i = 0; i < count; i += count / 100)
+    {
+        size = sizeof(name);
+        ret = RegEnumKeyExA(key, i, name, &size, NULL, NULL, NULL, NULL);
+        ok(!ret, "%lu: unexpected return value %ld.\n", i, ret);
+        ok(lstrcmpiA(prev, name) < 0, "%lu: got %s after %s\n", i, name, prev);
+        strcpy(prev, name);
+    }
+
+    ret = RegRenameKey(key, L"Subkey000000", L"Subkey999999");
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    size = sizeof(name);
+    ret = RegEnumKeyExA(key, count - 1, name, &size, NULL, NULL, NULL, NULL);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    ok(!strcmp(name, "Subkey999999"), "got %s\n", name);
+    ret = RegOpenKeyExA(key, "Subkey000000", 0, KEY_READ, &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "Unexpected return value %ld.\n", ret);
+    ret = RegDeleteKeyA(key, "Subkey999999");
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+
+    start = GetTickCount();
+    for (i = 1; i < count; i++)
+    {
+        sprintf(name, "Subkey%06lu", i);
+        ret = RegDeleteKeyA(key, name);
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+        sprintf(name, "Value%06lu", i);
+        ret = RegDeleteValueA(key, name);
+        ok(!ret, "%s: unexpected return value %ld.\n", name, ret);
+    }
+    trace("deleted %lu subkeys and values in %lu ms\n", count, GetTickCount() - start);
+
+    ret = RegQueryInfoKeyA(key, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(!ret, "Unexpected return value %ld.\n", ret);
+    ok(!subkeys, "got %lu subkeys\n", subkeys);
+    ok(values == 1, "got %lu values\n", values);
+
+    delete_key(key);
+    RegCloseKey(key);
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -4576,6 +4672,7 @@ START_TEST(registry)
     test_EnumDynamicTimeZoneInformation();
     test_perflib_key();
     test_RegRenameKey();
+    test_many_subkeys();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -36,6 +36,7 @@
 #include "wine/exception.h"
 #include "wine/debug.h"
 #include "wine/list.h"
+#include "wine/server.h"
 #include "ntdll_misc.h"
 #include "ddk/wdm.h"
 
@@ -97,6 +98,10 @@ static UNICODE_STRING dll_directory;  /* extra path for LdrSetDllDirectory */
 static UNICODE_STRING system_dll_path; /* path to search for system dependency dlls */
 static DWORD default_search_flags;  /* default flags set by LdrSetDefaultDllDirectories */
 static WCHAR *default_load_path;    /* default dll search path */
+static const struct import_cache_shm *import_cache;  /* shared import cache, mapped on first use */
+static BOOL import_cache_init_done;
+static HMODULE last_export_module;  /* module and export index last resolved by find_ordinal_export */
+static DWORD last_export_index;
 
 struct dll_dir_entry
 {
@@ -135,8 +140,25 @@ typedef struct _wine_modref
     struct file_id        id;
     ULONG                 CheckSum;
     BOOL                  system;
+    struct list           basename_entry;  /* entry in base name hash table */
+    struct list           fullname_entry;  /* entry in full name hash table */
+    struct list           fileid_entry;    /* entry in file id hash table */
 } WINE_MODREF;
 
+/* hash tables indexing the modules of the load order list; each bucket is kept in load order */
+#define MODULE_HASH_SIZE 61
+static struct list basename_hash[MODULE_HASH_SIZE];
+static struct list fullname_hash[MODULE_HASH_SIZE];
+static struct list fileid_hash[MODULE_HASH_SIZE];
+
+/* module lookup statistics, dumped with the module channel at process exit */
+static struct
+{
+    ULONG lookups;   /* number of name or file id lookups */
+    ULONG hits;      /* lookups that found a module */
+    ULONG probes;    /* modules compared in the hash buckets */
+} module_hash_stats;
+
 static UINT tls_module_count;      /* number of modules with TLS directory */
 static IMAGE_TLS_DIRECTORY *tls_dirs;  /* array of TLS directories */
 LIST_ENTRY tls_links = { &tls_links, &tls_links };
@@ -497,6 +519,65 @@ static void call_ldr_notifications( ULONG reason, LDR_DATA_TABLE_ENTRY *module )
     }
 }
 
+/*************************************************************************
+ *		hash_module_name
+ *
+ * Case-insensitive hash of a module name, consistent with RtlEqualUnicodeString.
+ */
+static ULONG hash_module_name( const UNICODE_STRING *name )
+{
+    ULONG i, hash = 0;
+
+    for (i = 0; i < name->Length / sizeof(WCHAR); i++)
+        hash = hash * 31 + RtlUpcaseUnicodeChar( name->Buffer[i] );
+    return hash % MODULE_HASH_SIZE;
+}
+
+static ULONG hash_file_id( const struct file_id *id )
+{
+    ULONG i, hash = 0;
+
+    for (i = 0; i < sizeof(id->ObjectId); i++) hash = hash * 31 + id->ObjectId[i];
+    return hash % MODULE_HASH_SIZE;
+}
+
+/*************************************************************************
+ *		add_module_hash
+ *
+ * Add a module to the lookup hash tables.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_module_hash( WINE_MODREF *wm )
+{
+    ULONG i;
+
+    if (!basename_hash[0].next)
+    {
+        for (i = 0; i < MODULE_HASH_SIZE; i++)
+        {
+            list_init( &basename_hash[i] );
+            list_init( &fullname_hash[i] );
+            list_init( &fileid_hash[i] );
+        }
+    }
+    list_add_tail( &basename_hash[hash_module_name( &wm->ldr.BaseDllName )], &wm->basename_entry );
+    list_add_tail( &fullname_hash[hash_module_name( &wm->ldr.FullDllName )], &wm->fullname_entry );
+    list_add_tail( &fileid_hash[hash_file_id( &wm->id )], &wm->fileid_entry );
+}
+
+/*************************************************************************
+ *		remove_module_hash
+ *
+ * Remove a module from the lookup hash tables.
+ * The loader_section must be locked while calling this function.
+ */
+static void remove_module_hash( WINE_MODREF *wm )
+{
+    list_remove( &wm->basename_entry );
+    list_remove( &wm->fullname_entry );
+    list_remove( &wm->fileid_entry );
+}
+
 /*************************************************************************
  *		get_modref
  *
@@ -529,25 +610,30 @@ static WINE_MODREF *get_modref( HMODULE hmod )
  */
 static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
     UNICODE_STRING name_str;
+    WINE_MODREF *mod;
 
     RtlInitUnicodeString( &name_str, name );
 
+    module_hash_stats.lookups++;
     if (cached_modref && RtlEqualUnicodeString( &name_str, &cached_modref->ldr.BaseDllName, TRUE ))
-        return cached_modref;
+        goto found;
+    if (!basename_hash[0].next) return NULL;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    LIST_FOR_EACH_ENTRY( mod, &basename_hash[hash_module_name( &name_str )], WINE_MODREF, basename_entry )
     {
-        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.InLoadOrderLinks);
+        module_hash_stats.probes++;
         if (RtlEqualUnicodeString( &name_str, &mod->ldr.BaseDllName, TRUE ) && !mod->system)
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
+            cached_modref = mod;
+            goto found;
         }
     }
     return NULL;
+
+found:
+    module_hash_stats.hits++;
+    return cached_modref;
 }
 
 
@@ -559,27 +645,32 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
 {
-    PLIST_ENTRY mark, entry;
     UNICODE_STRING name = *nt_name;
+    WINE_MODREF *mod;
 
     if (name.Length <= 4 * sizeof(WCHAR)) return NULL;
     name.Length -= 4 * sizeof(WCHAR);  /* for \??\ prefix */
     name.Buffer += 4;
 
+    module_hash_stats.lookups++;
     if (cached_modref && RtlEqualUnicodeString( &name, &cached_modref->ldr.FullDllName, TRUE ))
-        return cached_modref;
+        goto found;
+    if (!fullname_hash[0].next) return NULL;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    LIST_FOR_EACH_ENTRY( mod, &fullname_hash[hash_module_name( &name )], WINE_MODREF, fullname_entry )
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
-        if (RtlEqualUnicodeString( &name, &mod->FullDllName, TRUE ))
+        module_hash_stats.probes++;
+        if (RtlEqualUnicodeString( &name, &mod->ldr.FullDllName, TRUE ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
+            cached_modref = mod;
+            goto found;
         }
     }
     return NULL;
+
+found:
+    module_hash_stats.hits++;
+    return cached_modref;
 }
 
 
@@ -591,23 +682,26 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
  */
 static WINE_MODREF *find_fileid_module( const struct file_id *id )
 {
-    LIST_ENTRY *mark, *entry;
+    WINE_MODREF *wm;
 
-    if (cached_modref && !memcmp( &cached_modref->id, id, sizeof(*id) )) return cached_modref;
+    module_hash_stats.lookups++;
+    if (cached_modref && !memcmp( &cached_modref->id, id, sizeof(*id) )) goto found;
+    if (!fileid_hash[0].next) return NULL;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    LIST_FOR_EACH_ENTRY( wm, &fileid_hash[hash_file_id( id )], WINE_MODREF, fileid_entry )
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
-        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
-
+        module_hash_stats.probes++;
         if (!memcmp( &wm->id, id, sizeof(*id) ))
         {
             cached_modref = wm;
-            return wm;
+            goto found;
         }
     }
     return NULL;
+
+found:
+    module_hash_stats.hits++;
+    return cached_modref;
 }
 
 
@@ -942,6 +1036,9 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
         ((const char *)proc < (const char *)exports + exp_size))
         return find_forwarded_export( module, (const char *)proc, load_path );
 
+    last_export_module = module;
+    last_export_index = ordinal;
+
     if (TRACE_ON(snoop))
     {
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
@@ -1028,6 +1125,270 @@ void * WINAPI RtlFindExportedRoutineByName( HMODULE module, const char *name )
 }
 
 
+/*************************************************************************
+ *		is_module_at_image_base
+ *
+ * Check that a module the imports were bound to is loaded at its preferred base.
+ */
+static BOOL is_module_at_image_base( const WINE_MODREF *wm )
+{
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( wm->ldr.DllBase );
+
+    return (ULONG_PTR)wm->ldr.DllBase == nt->OptionalHeader.ImageBase;
+}
+
+
+/*************************************************************************
+ *		add_forward_dependency
+ *
+ * Keep a module that resolved imports were forwarded to loaded as long as the importer.
+ * The loader_section must be locked while calling this function.
+ */
+static void add_forward_dependency( WINE_MODREF *wm, const WINE_MODREF *imp )
+{
+    if (wm == imp || wm == current_modref) return;
+    if (!add_module_dependency( current_modref->ldr.DdagNode, wm->ldr.DdagNode )) return;
+    if (wm->ldr.LoadCount != -1) wm->ldr.LoadCount++;
+}
+
+
+/*************************************************************************
+ *		use_bound_imports
+ *
+ * Check whether the import address table for the given descriptor was filled
+ * in advance by binding the module, and still matches the loaded dlls. If so,
+ * add dependencies on the dlls that the bound imports are forwarded to.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL use_bound_imports( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, const WINE_MODREF *imp )
+{
+    const IMAGE_BOUND_IMPORT_DESCRIPTOR *bound, *ptr;
+    const IMAGE_BOUND_FORWARDER_REF *ref;
+    const char *name = get_rva( module, descr->Name );
+    const char *ref_name;
+    WINE_MODREF *wm;
+    WCHAR buffer[256];
+    ULONG size;
+    DWORD len;
+    WORD i;
+
+    if (!descr->TimeDateStamp || !descr->u.OriginalFirstThunk) return FALSE;
+    /* relay and snoop thunks have to be resolved at load time */
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return FALSE;
+    if (!is_module_at_image_base( imp )) return FALSE;
+
+    /* old style binding, only valid without forwarders */
+    if (descr->TimeDateStamp != ~0u)
+        return descr->ForwarderChain == ~0u && descr->TimeDateStamp == imp->ldr.TimeDateStamp;
+
+    if (!(bound = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT, &size )))
+        return FALSE;
+
+    for (ptr = bound; (const char *)(ptr + 1) <= (const char *)bound + size && ptr->OffsetModuleName;
+         ptr = (const IMAGE_BOUND_IMPORT_DESCRIPTOR *)(ref + ptr->NumberOfModuleForwarderRefs))
+    {
+        ref = (const IMAGE_BOUND_FORWARDER_REF *)(ptr + 1);
+        if (_stricmp( (const char *)bound + ptr->OffsetModuleName, name )) continue;
+        if (ptr->TimeDateStamp != imp->ldr.TimeDateStamp) return FALSE;
+        if ((const char *)(ref + ptr->NumberOfModuleForwarderRefs) > (const char *)bound + size) return FALSE;
+
+        /* forwarded imports point into other dlls, which must have been loaded already */
+        for (i = 0; i < ptr->NumberOfModuleForwarderRefs; i++)
+        {
+            ref_name = (const char *)bound + ref[i].OffsetModuleName;
+            if ((len = strlen( ref_name )) >= ARRAY_SIZE(buffer)) return FALSE;
+            ascii_to_unicode( buffer, ref_name, len + 1 );
+            if (!(wm = find_basename_module( buffer ))) return FALSE;
+            if (wm->ldr.TimeDateStamp != ref[i].TimeDateStamp || !is_module_at_image_base( wm )) return FALSE;
+        }
+        for (i = 0; i < ptr->NumberOfModuleForwarderRefs; i++)
+        {
+            ref_name = (const char *)bound + ref[i].OffsetModuleName;
+            ascii_to_unicode( buffer, ref_name, strlen( ref_name ) + 1 );
+            add_forward_dependency( find_basename_module( buffer ), imp );
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
+/*************************************************************************
+ *		get_import_cache
+ *
+ * Map the import cache section shared by all the processes of the session.
+ */
+static const struct import_cache_shm *get_import_cache(void)
+{
+    UNICODE_STRING name = RTL_CONSTANT_STRING( L"\\KernelObjects\\__wine_import_cache" );
+    OBJECT_ATTRIBUTES attr;
+    HANDLE handle;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+
+    if (import_cache_init_done) return import_cache;
+    import_cache_init_done = TRUE;
+
+    /* relay and snoop thunks have to be resolved at load time */
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return NULL;
+
+    InitializeObjectAttributes( &attr, &name, 0, NULL, NULL );
+    if (NtOpenSection( &handle, SECTION_MAP_READ, &attr )) return NULL;
+    if (!NtMapViewOfSection( handle, NtCurrentProcess(), &ptr, 0, 0, NULL, &size, ViewShare, 0, PAGE_READONLY ))
+        import_cache = ptr;
+    NtClose( handle );
+    return import_cache;
+}
+
+
+/*************************************************************************
+ *		get_import_cache_module
+ *
+ * Get the identity of a module in the import cache.
+ */
+static BOOL get_import_cache_module( const WINE_MODREF *wm, struct import_cache_module *id )
+{
+    static const struct file_id zero_id;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    ULONG size;
+
+    /* modules without a file identity can't be told apart from a different version */
+    if (!memcmp( &wm->id, &zero_id, sizeof(zero_id) )) return FALSE;
+
+    memcpy( id->file_id, wm->id.ObjectId, sizeof(id->file_id) );
+    id->timestamp  = wm->ldr.TimeDateStamp;
+    id->image_size = wm->ldr.SizeOfImage;
+    id->checksum   = wm->CheckSum;
+    exports = RtlImageDirectoryEntryToData( wm->ldr.DllBase, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+    id->exports    = exports ? exports->NumberOfFunctions : 0;
+    return TRUE;
+}
+
+
+/*************************************************************************
+ *		hash_import_cache_key
+ */
+static unsigned int hash_import_cache_key( const struct import_cache_module *importer, DWORD descr )
+{
+    const unsigned char *ptr = (const unsigned char *)importer;
+    unsigned int i, hash = descr;
+
+    for (i = 0; i < sizeof(*importer); i++) hash = hash * 31 + ptr[i];
+    return hash;
+}
+
+
+/*************************************************************************
+ *		import_from_cache
+ *
+ * Fill the import address table for the given descriptor from the import cache.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL import_from_cache( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, const WINE_MODREF *imp,
+                               IMAGE_THUNK_DATA *thunk_list, DWORD count )
+{
+    const struct import_cache_shm *cache = get_import_cache();
+    const struct import_cache_entry *entry = NULL;
+    const struct import_cache_module *modules;
+    const IMAGE_EXPORT_DIRECTORY *exports[IMPORT_CACHE_MAX_MODULES];
+    ULONG exp_size[IMPORT_CACHE_MAX_MODULES];
+    WINE_MODREF *targets[IMPORT_CACHE_MAX_MODULES];
+    struct import_cache_module importer, id;
+    DWORD rva = (const char *)descr - (const char *)module;
+    const unsigned int *thunks;
+    const DWORD *functions;
+    const char *proc;
+    unsigned int i, index, offset;
+
+    if (!cache || !get_import_cache_module( current_modref, &importer )) return FALSE;
+
+    offset = ReadAcquire( (LONG *)&cache->buckets[hash_import_cache_key( &importer, rva ) % IMPORT_CACHE_BUCKETS] );
+    for ( ; offset; offset = entry->next)
+    {
+        entry = (const struct import_cache_entry *)((const char *)cache + offset);
+        modules = (const struct import_cache_module *)(entry + 1);
+        if (entry->descr == rva && !memcmp( &modules[0], &importer, sizeof(importer) )) break;
+    }
+    if (!offset || entry->count != count || entry->modules > IMPORT_CACHE_MAX_MODULES) return FALSE;
+
+    /* all the modules must be the ones the entry was created with, and already loaded */
+    for (i = 1; i < entry->modules; i++)
+    {
+        if (i == 1) targets[i] = (WINE_MODREF *)imp;
+        else if (!(targets[i] = find_fileid_module( (const struct file_id *)modules[i].file_id ))) return FALSE;
+        if (!get_import_cache_module( targets[i], &id ) || memcmp( &modules[i], &id, sizeof(id) )) return FALSE;
+        if (!(exports[i] = RtlImageDirectoryEntryToData( targets[i]->ldr.DllBase, TRUE,
+                                                         IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size[i] )))
+            return FALSE;
+    }
+
+    thunks = (const unsigned int *)(modules + entry->modules);
+    for (i = 0; i < count; i++)
+    {
+        if (!(index = thunks[i] >> 16) || index >= entry->modules) return FALSE;
+        functions = get_rva( targets[index]->ldr.DllBase, exports[index]->AddressOfFunctions );
+        if ((thunks[i] & 0xffff) >= exports[index]->NumberOfFunctions) return FALSE;
+        if (!functions[thunks[i] & 0xffff]) return FALSE;
+        proc = get_rva( targets[index]->ldr.DllBase, functions[thunks[i] & 0xffff] );
+        /* forwards are stored with their final target */
+        if (proc >= (const char *)exports[index] && proc < (const char *)exports[index] + exp_size[index])
+            return FALSE;
+        thunk_list[i].u1.Function = (ULONG_PTR)proc;
+    }
+
+    for (i = 2; i < entry->modules; i++) add_forward_dependency( targets[i], imp );
+    return TRUE;
+}
+
+
+/*************************************************************************
+ *		record_import_cache_thunk
+ *
+ * Store the export that an import was last resolved to in an import cache entry,
+ * adding its module to the list of modules of the entry if needed.
+ */
+static BOOL record_import_cache_thunk( struct import_cache_module *modules, HMODULE *bases,
+                                       unsigned int *nb_modules, unsigned int *thunk )
+{
+    WINE_MODREF *wm;
+    unsigned int i;
+
+    if (!last_export_module || last_export_index > 0xffff) return FALSE;
+    for (i = 1; i < *nb_modules; i++) if (bases[i] == last_export_module) break;
+    if (i == *nb_modules)
+    {
+        if (i == IMPORT_CACHE_MAX_MODULES) return FALSE;
+        if (!(wm = get_modref( last_export_module )) || wm == current_modref) return FALSE;
+        if (!get_import_cache_module( wm, &modules[i] )) return FALSE;
+        bases[i] = last_export_module;
+        (*nb_modules)++;
+    }
+    *thunk = i << 16 | last_export_index;
+    return TRUE;
+}
+
+
+/*************************************************************************
+ *		add_import_cache
+ *
+ * Store the resolved imports of the given descriptor in the import cache.
+ */
+static void add_import_cache( DWORD rva, const struct import_cache_module *modules, unsigned int nb_modules,
+                              const unsigned int *thunks, DWORD count )
+{
+    SERVER_START_REQ( add_import_cache )
+    {
+        req->hash    = hash_import_cache_key( &modules[0], rva );
+        req->descr   = rva;
+        req->modules = nb_modules;
+        wine_server_add_data( req, modules, nb_modules * sizeof(*modules) );
+        wine_server_add_data( req, thunks, count * sizeof(*thunks) );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+
 /*************************************************************************
  *		import_dll
  *
@@ -1050,6 +1411,11 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
     PVOID protect_base;
     SIZE_T protect_size = 0;
     DWORD protect_old;
+    struct import_cache_module modules[IMPORT_CACHE_MAX_MODULES];
+    HMODULE bases[IMPORT_CACHE_MAX_MODULES];
+    unsigned int nb_modules = 2, *thunks = NULL;
+    DWORD i, count;
+    BOOL record;
 
     thunk_list = get_rva( module, (DWORD)descr->FirstThunk );
     if (descr->u.OriginalFirstThunk)
@@ -1078,14 +1444,31 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         return FALSE;
     }
 
+    if (use_bound_imports( module, descr, wmImp ))
+    {
+        TRACE_(imports)( "--- %s imports from %s are bound\n",
+                         debugstr_w(current_modref->ldr.BaseDllName.Buffer), name );
+        *pwm = wmImp;
+        return TRUE;
+    }
+
     /* unprotect the import address table since it can be located in
      * readonly section */
     while (import_list[protect_size].u1.Ordinal) protect_size++;
+    count = protect_size;
     protect_base = thunk_list;
     protect_size *= sizeof(*thunk_list);
     NtProtectVirtualMemory( NtCurrentProcess(), &protect_base,
                             &protect_size, PAGE_READWRITE, &protect_old );
 
+    /* the import list is needed to fall back to resolving the imports if the cache is stale */
+    if (descr->u.OriginalFirstThunk && import_from_cache( module, descr, wmImp, thunk_list, count ))
+    {
+        TRACE_(imports)( "--- %s imports from %s found in the import cache\n",
+                         debugstr_w(current_modref->ldr.BaseDllName.Buffer), name );
+        goto done;
+    }
+
     imp_mod = wmImp->ldr.DllBase;
     exports = RtlImageDirectoryEntryToData( imp_mod, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size );
 
@@ -1115,8 +1498,15 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         goto done;
     }
 
-    while (import_list->u1.Ordinal)
+    record = descr->u.OriginalFirstThunk && get_import_cache() &&
+             get_import_cache_module( current_modref, &modules[0] ) &&
+             get_import_cache_module( wmImp, &modules[1] ) &&
+             (thunks = RtlAllocateHeap( GetProcessHeap(), 0, count * sizeof(*thunks) ));
+    bases[1] = imp_mod;
+
+    for (i = 0; import_list->u1.Ordinal; i++)
     {
+        last_export_module = NULL;
         if (IMAGE_SNAP_BY_ORDINAL(import_list->u1.Ordinal))
         {
             int ordinal = IMAGE_ORDINAL(import_list->u1.Ordinal);
@@ -1125,6 +1515,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
                                                                       ordinal - exports->Base, load_path );
             if (!thunk_list->u1.Function)
             {
+                last_export_module = NULL;
                 thunk_list->u1.Function = allocate_stub( name, IntToPtr(ordinal) );
                 WARN("No implementation for %s.%d imported from %s, setting to %p\n",
                      name, ordinal, debugstr_w(current_modref->ldr.FullDllName.Buffer),
@@ -1141,6 +1532,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
                                                                     pe_name->Hint, load_path );
             if (!thunk_list->u1.Function)
             {
+                last_export_module = NULL;
                 thunk_list->u1.Function = allocate_stub( name, (const char*)pe_name->Name );
                 WARN("No implementation for %s.%s imported from %s, setting to %p\n",
                      name, pe_name->Name, debugstr_w(current_modref->ldr.FullDllName.Buffer),
@@ -1149,9 +1541,12 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
             TRACE_(imports)("--- %s %s.%d = %p\n",
                             pe_name->Name, name, pe_name->Hint, (void *)thunk_list->u1.Function);
         }
+        if (record) record = record_import_cache_thunk( modules, bases, &nb_modules, &thunks[i] );
         import_list++;
         thunk_list++;
     }
+    if (record) add_import_cache( (const char *)descr - (const char *)module, modules, nb_modules, thunks, count );
+    RtlFreeHeap( GetProcessHeap(), 0, thunks );
 
 done:
     /* restore old protection of the import address table */
@@ -1425,7 +1820,8 @@ static NTSTATUS fixup_imports( WINE_MODREF *wm, LPCWSTR load_path )
  * Allocate a WINE_MODREF structure and add it to the process list
  * The loader_section must be locked while calling this function.
  */
-static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name, BOOL builtin )
+static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name,
+                                  const struct file_id *id, BOOL builtin )
 {
     WCHAR *buffer;
     WINE_MODREF *wm;
@@ -1441,6 +1837,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
     wm->ldr.LoadCount     = 1;
     wm->CheckSum          = nt->OptionalHeader.CheckSum;
     wm->ldr.TimeDateStamp = nt->FileHeader.TimeDateStamp;
+    if (id) wm->id        = *id;
 
     if (!(buffer = RtlAllocateHeap( GetProcessHeap(), 0, nt_name->Length - 3 * sizeof(WCHAR) )))
     {
@@ -1476,6 +1873,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
                    &wm->ldr.InLoadOrderLinks);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderLinks);
+    add_module_hash( wm );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -2130,9 +2528,8 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
 
     /* create the MODREF */
 
-    if (!(wm = alloc_module( *module, nt_name, is_builtin ))) return STATUS_NO_MEMORY;
+    if (!(wm = alloc_module( *module, nt_name, id, is_builtin ))) return STATUS_NO_MEMORY;
 
-    if (id) wm->id = *id;
     if (image_info->LoaderFlags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->u.s.ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
     wm->system = system;
@@ -2154,6 +2551,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderLinks);
             RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+            remove_module_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2198,7 +2596,7 @@ static void build_ntdll_module( HMODULE module )
     UNICODE_STRING nt_name = RTL_CONSTANT_STRING( L"\\??\\C:\\windows\\system32\\ntdll.dll" );
     WINE_MODREF *wm;
 
-    wm = alloc_module( module, &nt_name, TRUE );
+    wm = alloc_module( module, &nt_name, NULL, TRUE );
     assert( wm );
     wm->ldr.Flags &= ~LDR_DONT_RESOLVE_REFS;
     node_ntdll = wm->ldr.DdagNode;
@@ -3702,6 +4100,8 @@ void WINAPI LdrShutdownProcess(void)
     BOOL detaching = process_detaching;
 
     TRACE("()\n");
+    TRACE( "module lookups: %lu, found %lu, %lu hash probes\n", module_hash_stats.lookups,
+           module_hash_stats.hits, module_hash_stats.probes );
 
     process_detaching = TRUE;
     if (!detaching)
@@ -3796,6 +4196,7 @@ static void free_modref( WINE_MODREF *wm )
     RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
     if (wm->ldr.InInitializationOrderLinks.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderLinks);
+    remove_module_hash( wm );
 
     while ((entry = wm->ldr.DdagNode->Dependencies.Tail))
     {
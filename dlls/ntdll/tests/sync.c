@@ -27,11 +27,15 @@
 #include "wine/test.h"
 
 static NTSTATUS (WINAPI *pNtAlertThreadByThreadId)( HANDLE );
+static NTSTATUS (WINAPI *pNtAssociateWaitCompletionPacket)( HANDLE, HANDLE, HANDLE, void *, void *, NTSTATUS, ULONG_PTR, BOOLEAN * );
+static NTSTATUS (WINAPI *pNtCancelWaitCompletionPacket)( HANDLE, BOOLEAN );
 static NTSTATUS (WINAPI *pNtClose)( HANDLE );
 static NTSTATUS (WINAPI *pNtCreateEvent) ( PHANDLE, ACCESS_MASK, const OBJECT_ATTRIBUTES *, EVENT_TYPE, BOOLEAN);
+static NTSTATUS (WINAPI *pNtCreateIoCompletion)( HANDLE *, ACCESS_MASK, OBJECT_ATTRIBUTES *, ULONG );
 static NTSTATUS (WINAPI *pNtCreateKeyedEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, ULONG );
 static NTSTATUS (WINAPI *pNtCreateMutant)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, BOOLEAN );
 static NTSTATUS (WINAPI *pNtCreateSemaphore)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, LONG, LONG );
+static NTSTATUS (WINAPI *pNtCreateWaitCompletionPacket)( HANDLE *, ACCESS_MASK, OBJECT_ATTRIBUTES * );
 static NTSTATUS (WINAPI *pNtOpenEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES * );
 static NTSTATUS (WINAPI *pNtOpenKeyedEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES * );
 static NTSTATUS (WINAPI *pNtPulseEvent)( HANDLE, LONG * );
@@ -42,6 +46,7 @@ static NTSTATUS (WINAPI *pNtQuerySystemTime)( LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtReleaseKeyedEvent)( HANDLE, const void *, BOOLEAN, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtReleaseMutant)( HANDLE, LONG * );
 static NTSTATUS (WINAPI *pNtReleaseSemaphore)( HANDLE, ULONG, ULONG * );
+static NTSTATUS (WINAPI *pNtRemoveIoCompletion)( HANDLE, ULONG_PTR *, ULONG_PTR *, IO_STATUS_BLOCK *, LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtResetEvent)( HANDLE, LONG * );
 static NTSTATUS (WINAPI *pNtSetEvent)( HANDLE, LONG * );
 static NTSTATUS (WINAPI *pNtWaitForAlertByThreadId)( void *, const LARGE_INTEGER * );
@@ -529,6 +534,99 @@ static void test_semaphore(void)
     NtClose( semaphore );
 }
 
+static void test_wait_completion_packet(void)
+{
+    HANDLE port, packet, event, semaphore;
+    ULONG_PTR key, value;
+    LARGE_INTEGER timeout;
+    IO_STATUS_BLOCK iosb;
+    BOOLEAN signaled;
+    NTSTATUS status;
+
+    if (!pNtCreateWaitCompletionPacket)
+    {
+        win_skip( "NtCreateWaitCompletionPacket is not available\n" );
+        return;
+    }
+
+    timeout.QuadPart = 0;
+
+    status = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( !status, "got %#lx\n", status );
+    status = pNtCreateWaitCompletionPacket( &packet, GENERIC_ALL, NULL );
+    ok( !status, "got %#lx\n", status );
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+    ok( !status, "got %#lx\n", status );
+
+    /* the packet is queued once the object is signaled */
+    signaled = 0xcc;
+    status = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)0x1234, (void *)0x5678,
+                                               STATUS_ALERTED, 42, &signaled );
+    ok( !status, "got %#lx\n", status );
+    ok( !signaled, "got %u\n", signaled );
+
+    status = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( status == STATUS_TIMEOUT, "got %#lx\n", status );
+
+    status = pNtAssociateWaitCompletionPacket( packet, port, event, NULL, NULL, STATUS_SUCCESS, 0, NULL );
+    ok( status == STATUS_INVALID_PARAMETER_1, "got %#lx\n", status );
+
+    pNtSetEvent( event, NULL );
+    key = value = 0;
+    memset( &iosb, 0xcc, sizeof(iosb) );
+    status = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( !status, "got %#lx\n", status );
+    ok( key == 0x1234, "got key %#Ix\n", key );
+    ok( value == 0x5678, "got value %#Ix\n", value );
+    ok( iosb.Status == STATUS_ALERTED, "got status %#lx\n", iosb.Status );
+    ok( iosb.Information == 42, "got information %Iu\n", iosb.Information );
+
+    /* the wait is satisfied, the auto-reset event is no longer signaled */
+    status = WaitForSingleObject( event, 0 );
+    ok( status == WAIT_TIMEOUT, "got %#lx\n", status );
+
+    status = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( status == STATUS_CANCELLED, "got %#lx\n", status );
+
+    /* already signaled objects queue the packet immediately */
+    status = pNtCreateSemaphore( &semaphore, SEMAPHORE_ALL_ACCESS, NULL, 1, 1 );
+    ok( !status, "got %#lx\n", status );
+    signaled = 0xcc;
+    status = pNtAssociateWaitCompletionPacket( packet, port, semaphore, (void *)1, NULL, STATUS_SUCCESS, 0, &signaled );
+    ok( !status, "got %#lx\n", status );
+    ok( signaled == TRUE, "got %u\n", signaled );
+
+    status = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( status == STATUS_PENDING, "got %#lx\n", status );
+    status = pNtCancelWaitCompletionPacket( packet, TRUE );
+    ok( !status, "got %#lx\n", status );
+    status = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( status == STATUS_TIMEOUT, "got %#lx\n", status );
+
+    /* cancelling a pending wait doesn't consume the object */
+    status = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)2, NULL, STATUS_SUCCESS, 0, NULL );
+    ok( !status, "got %#lx\n", status );
+    status = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( !status, "got %#lx\n", status );
+    pNtSetEvent( event, NULL );
+    status = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( status == STATUS_TIMEOUT, "got %#lx\n", status );
+    status = WaitForSingleObject( event, 0 );
+    ok( status == WAIT_OBJECT_0, "got %#lx\n", status );
+
+    /* closing the packet cancels the wait */
+    status = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)3, NULL, STATUS_SUCCESS, 0, NULL );
+    ok( !status, "got %#lx\n", status );
+    pNtClose( packet );
+    pNtSetEvent( event, NULL );
+    status = pNtRemoveIoCompletion( port, &key, &value, &iosb, &timeout );
+    ok( status == STATUS_TIMEOUT, "got %#lx\n", status );
+
+    pNtClose( semaphore );
+    pNtClose( event );
+    pNtClose( port );
+}
+
 static void test_wait_on_address(void)
 {
     SIZE_T size;
@@ -848,11 +946,15 @@ START_TEST(sync)
     if (argc > 2) return;
 
     pNtAlertThreadByThreadId        = (void *)GetProcAddress(module, "NtAlertThreadByThreadId");
+    pNtAssociateWaitCompletionPacket = (void *)GetProcAddress(module, "NtAssociateWaitCompletionPacket");
+    pNtCancelWaitCompletionPacket   = (void *)GetProcAddress(module, "NtCancelWaitCompletionPacket");
     pNtClose                        = (void *)GetProcAddress(module, "NtClose");
     pNtCreateEvent                  = (void *)GetProcAddress(module, "NtCreateEvent");
+    pNtCreateIoCompletion           = (void *)GetProcAddress(module, "NtCreateIoCompletion");
     pNtCreateKeyedEvent             = (void *)GetProcAddress(module, "NtCreateKeyedEvent");
     pNtCreateMutant                 = (void *)GetProcAddress(module, "NtCreateMutant");
     pNtCreateSemaphore              = (void *)GetProcAddress(module, "NtCreateSemaphore");
+    pNtCreateWaitCompletionPacket   = (void *)GetProcAddress(module, "NtCreateWaitCompletionPacket");
     pNtOpenEvent                    = (void *)GetProcAddress(module, "NtOpenEvent");
     pNtOpenKeyedEvent               = (void *)GetProcAddress(module, "NtOpenKeyedEvent");
     pNtPulseEvent                   = (void *)GetProcAddress(module, "NtPulseEvent");
@@ -863,6 +965,7 @@ START_TEST(sync)
     pNtReleaseKeyedEvent            = (void *)GetProcAddress(module, "NtReleaseKeyedEvent");
     pNtReleaseMutant                = (void *)GetProcAddress(module, "NtReleaseMutant");
     pNtReleaseSemaphore             = (void *)GetProcAddress(module, "NtReleaseSemaphore");
+    pNtRemoveIoCompletion           = (void *)GetProcAddress(module, "NtRemoveIoCompletion");
     pNtResetEvent                   = (void *)GetProcAddress(module, "NtResetEvent");
     pNtSetEvent                     = (void *)GetProcAddress(module, "NtSetEvent");
     pNtWaitForAlertByThreadId       = (void *)GetProcAddress(module, "NtWaitForAlertByThreadId");
@@ -882,6 +985,7 @@ START_TEST(sync)
     test_mutant();
     test_semaphore();
     test_keyed_events();
+    test_wait_completion_packet();
     test_resource();
     test_tid_alert( argv );
 }
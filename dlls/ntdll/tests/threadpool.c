@@ -832,6 +832,227 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+#define QUEUES_WORK_OBJECTS  64
+#define QUEUES_WORK_POSTS    64
+#define QUEUES_SIMPLE_POSTS  1024
+#define QUEUES_SUBMITTERS    4
+
+static struct
+{
+    TP_CALLBACK_ENVIRON *environment;
+    TP_WORK *works[QUEUES_WORK_OBJECTS];
+    LONG work_counts[QUEUES_WORK_OBJECTS];
+    LONG simple_counts[QUEUES_SUBMITTERS * QUEUES_SIMPLE_POSTS];
+    LONG simple_pending, running, max_running;
+    HANDLE blocker, semaphore, done;
+} queues_info;
+
+static void CALLBACK queues_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement(&queues_info.work_counts[(DWORD_PTR)userdata]);
+}
+
+static void CALLBACK queues_simple_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    InterlockedIncrement(&queues_info.simple_counts[(DWORD_PTR)userdata]);
+    if (!InterlockedDecrement(&queues_info.simple_pending)) SetEvent(queues_info.done);
+}
+
+static DWORD WINAPI queues_submit_thread(void *arg)
+{
+    DWORD index = (DWORD)(DWORD_PTR)arg;
+    NTSTATUS status;
+    int i, j;
+
+    for (i = 0; i < QUEUES_SIMPLE_POSTS; i++)
+    {
+        /* each submitter posts its own share of the work objects */
+        if (i < QUEUES_WORK_POSTS)
+            for (j = index; j < QUEUES_WORK_OBJECTS; j += QUEUES_SUBMITTERS)
+                pTpPostWork(queues_info.works[j]);
+        status = pTpSimpleTryPost(queues_simple_cb, (void *)(DWORD_PTR)(index * QUEUES_SIMPLE_POSTS + i),
+                                  queues_info.environment);
+        ok(!status, "TpSimpleTryPost failed with status %lx\n", status);
+    }
+    return 0;
+}
+
+static void CALLBACK queues_blocking_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    DWORD result;
+
+    ReleaseSemaphore(queues_info.semaphore, 1, NULL);
+    result = WaitForSingleObject(queues_info.blocker, 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+}
+
+static void CALLBACK queues_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    ReleaseSemaphore(queues_info.semaphore, 1, NULL);
+}
+
+static void CALLBACK queues_concurrency_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    LONG running = InterlockedIncrement(&queues_info.running), max_running;
+
+    while ((max_running = queues_info.max_running) < running &&
+           InterlockedCompareExchange(&queues_info.max_running, running, max_running) != max_running);
+    Sleep(5);
+    InterlockedDecrement(&queues_info.running);
+}
+
+static void test_tp_work_queues(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    HANDLE threads[QUEUES_SUBMITTERS];
+    TP_WORK *blocking[3];
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i, j;
+
+    queues_info.semaphore = CreateSemaphoreW(NULL, 0, QUEUES_WORK_OBJECTS, NULL);
+    ok(queues_info.semaphore != NULL, "failed to create semaphore\n");
+    queues_info.blocker = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(queues_info.blocker != NULL, "failed to create event\n");
+    queues_info.done = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ok(queues_info.done != NULL, "failed to create event\n");
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, 4);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    queues_info.environment = &environment;
+
+    /* every callback runs exactly once when posted from several threads */
+    for (i = 0; i < QUEUES_WORK_OBJECTS; i++)
+    {
+        queues_info.works[i] = NULL;
+        status = pTpAllocWork(&queues_info.works[i], queues_work_cb, (void *)(DWORD_PTR)i, &environment);
+        ok(!status, "TpAllocWork failed with status %lx\n", status);
+        ok(queues_info.works[i] != NULL, "expected work != NULL\n");
+    }
+
+    queues_info.simple_pending = ARRAY_SIZE(queues_info.simple_counts);
+    for (i = 0; i < QUEUES_SUBMITTERS; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, queues_submit_thread, (void *)(DWORD_PTR)i, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with error %lu\n", GetLastError());
+    }
+    result = WaitForMultipleObjects(QUEUES_SUBMITTERS, threads, TRUE, 10000);
+    ok(result == WAIT_OBJECT_0, "WaitForMultipleObjects returned %lu\n", result);
+    for (i = 0; i < QUEUES_SUBMITTERS; i++)
+        CloseHandle(threads[i]);
+
+    for (i = 0; i < QUEUES_WORK_OBJECTS; i++)
+    {
+        pTpWaitForWork(queues_info.works[i], FALSE);
+        ok(queues_info.work_counts[i] == QUEUES_WORK_POSTS, "work %d: expected %u callbacks, got %lu\n",
+           i, QUEUES_WORK_POSTS, queues_info.work_counts[i]);
+        pTpReleaseWork(queues_info.works[i]);
+    }
+
+    result = WaitForSingleObject(queues_info.done, 10000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    pTpReleasePool(pool);
+    for (i = 0; i < ARRAY_SIZE(queues_info.simple_counts); i++)
+    {
+        ok(queues_info.simple_counts[i] == 1, "simple callback %d: expected 1 call, got %lu\n",
+           i, queues_info.simple_counts[i]);
+        if (queues_info.simple_counts[i] != 1) break;
+    }
+
+    /* work queued anywhere is taken by the remaining worker while the others are blocked */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, ARRAY_SIZE(blocking) + 1);
+    environment.Pool = pool;
+
+    for (i = 0; i < ARRAY_SIZE(blocking); i++)
+    {
+        blocking[i] = NULL;
+        status = pTpAllocWork(&blocking[i], queues_blocking_cb, NULL, &environment);
+        ok(!status, "TpAllocWork failed with status %lx\n", status);
+        ok(blocking[i] != NULL, "expected work != NULL\n");
+        pTpPostWork(blocking[i]);
+    }
+    for (i = 0; i < ARRAY_SIZE(blocking); i++)
+    {
+        result = WaitForSingleObject(queues_info.semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    }
+
+    for (i = 0; i < QUEUES_WORK_OBJECTS; i++)
+    {
+        queues_info.works[i] = NULL;
+        status = pTpAllocWork(&queues_info.works[i], queues_release_cb, NULL, &environment);
+        ok(!status, "TpAllocWork failed with status %lx\n", status);
+        ok(queues_info.works[i] != NULL, "expected work != NULL\n");
+        pTpPostWork(queues_info.works[i]);
+    }
+    for (i = 0; i < QUEUES_WORK_OBJECTS; i++)
+    {
+        result = WaitForSingleObject(queues_info.semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "callback %d: WaitForSingleObject returned %lu\n", i, result);
+        if (result != WAIT_OBJECT_0) break;
+    }
+
+    SetEvent(queues_info.blocker);
+    for (i = 0; i < ARRAY_SIZE(blocking); i++)
+    {
+        pTpWaitForWork(blocking[i], FALSE);
+        pTpReleaseWork(blocking[i]);
+    }
+    for (i = 0; i < QUEUES_WORK_OBJECTS; i++)
+    {
+        pTpWaitForWork(queues_info.works[i], FALSE);
+        pTpReleaseWork(queues_info.works[i]);
+    }
+    pTpReleasePool(pool);
+
+    /* the maximum number of threads is honoured over all queues */
+    for (i = 1; i <= 2; i++)
+    {
+        pool = NULL;
+        status = pTpAllocPool(&pool, NULL);
+        ok(!status, "TpAllocPool failed with status %lx\n", status);
+        ok(pool != NULL, "expected pool != NULL\n");
+        pTpSetPoolMaxThreads(pool, i);
+        environment.Pool = pool;
+
+        queues_info.running = queues_info.max_running = 0;
+        for (j = 0; j < QUEUES_WORK_OBJECTS; j++)
+        {
+            queues_info.works[j] = NULL;
+            status = pTpAllocWork(&queues_info.works[j], queues_concurrency_cb, NULL, &environment);
+            ok(!status, "TpAllocWork failed with status %lx\n", status);
+            ok(queues_info.works[j] != NULL, "expected work != NULL\n");
+            pTpPostWork(queues_info.works[j]);
+        }
+        for (j = 0; j < QUEUES_WORK_OBJECTS; j++)
+        {
+            pTpWaitForWork(queues_info.works[j], FALSE);
+            pTpReleaseWork(queues_info.works[j]);
+        }
+        ok(queues_info.max_running <= i, "expected at most %d concurrent callbacks, got %lu\n",
+           i, queues_info.max_running);
+        pTpReleasePool(pool);
+    }
+
+    /* cleanup */
+    CloseHandle(queues_info.done);
+    CloseHandle(queues_info.blocker);
+    CloseHandle(queues_info.semaphore);
+}
+
 static void CALLBACK simple_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE *semaphores = userdata;
@@ -1877,6 +2098,105 @@ static void test_tp_wait(void)
     CloseHandle(semaphores[1]);
 }
 
+struct wait_mutex_info
+{
+    TP_WAIT *wait;
+    HANDLE mutex;
+};
+
+static DWORD WINAPI wait_mutex_thread(void *arg)
+{
+    struct wait_mutex_info *info = arg;
+    pTpSetWait(info->wait, info->mutex, NULL);
+    return 0;
+}
+
+static void test_tp_wait_mutex(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct wait_mutex_info mutex_info;
+    struct wait_info info;
+    HANDLE thread, mutex;
+    NTSTATUS status;
+    TP_WAIT *wait;
+    TP_POOL *pool;
+    DWORD result;
+    BOOL ret;
+
+    info.semaphore = CreateSemaphoreW(NULL, 0, 1, NULL);
+    ok(info.semaphore != NULL, "failed to create semaphore\n");
+    mutex = CreateMutexW(NULL, TRUE, NULL);
+    ok(mutex != NULL, "failed to create mutex\n");
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    /* allocate new wait item */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    wait = NULL;
+    status = pTpAllocWait(&wait, wait_cb, &info, &environment);
+    ok(!status, "TpAllocWait failed with status %lx\n", status);
+    ok(wait != NULL, "expected wait != NULL\n");
+
+    /* the thread setting the wait doesn't acquire the mutex */
+    info.userdata = 0;
+    pTpSetWait(wait, mutex, NULL);
+    ret = ReleaseMutex(mutex);
+    ok(ret, "ReleaseMutex failed with error %lu\n", GetLastError());
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %lu\n", info.userdata);
+    result = WaitForSingleObject(mutex, 0);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+    SetLastError(0xdeadbeef);
+    ret = ReleaseMutex(mutex);
+    ok(!ret, "ReleaseMutex succeeded\n");
+    ok(GetLastError() == ERROR_NOT_OWNER, "got error %lu\n", GetLastError());
+    pTpSetWait(wait, NULL, NULL);
+    pTpWaitForWait(wait, FALSE);
+    pTpReleaseWait(wait);
+
+    /* the mutex isn't abandoned when the thread setting the wait exits */
+    CloseHandle(mutex);
+    mutex = CreateMutexW(NULL, TRUE, NULL);
+    ok(mutex != NULL, "failed to create mutex\n");
+
+    wait = NULL;
+    status = pTpAllocWait(&wait, wait_cb, &info, &environment);
+    ok(!status, "TpAllocWait failed with status %lx\n", status);
+    ok(wait != NULL, "expected wait != NULL\n");
+
+    info.userdata = 0;
+    mutex_info.wait = wait;
+    mutex_info.mutex = mutex;
+    thread = CreateThread(NULL, 0, wait_mutex_thread, &mutex_info, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with error %lu\n", GetLastError());
+    result = WaitForSingleObject(thread, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    CloseHandle(thread);
+    ret = ReleaseMutex(mutex);
+    ok(ret, "ReleaseMutex failed with error %lu\n", GetLastError());
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %lu\n", info.userdata);
+    result = WaitForSingleObject(mutex, 0);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+    pTpSetWait(wait, NULL, NULL);
+    pTpWaitForWait(wait, FALSE);
+
+    /* cleanup */
+    pTpReleaseWait(wait);
+    pTpReleasePool(pool);
+    CloseHandle(mutex);
+    CloseHandle(info.semaphore);
+}
+
 static struct
 {
     HANDLE semaphore;
@@ -2386,6 +2706,7 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_queues();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
@@ -2393,6 +2714,7 @@ START_TEST(threadpool)
     test_tp_timer();
     test_tp_window_length();
     test_tp_wait();
+    test_tp_wait_mutex();
     test_tp_multi_wait();
     test_tp_io();
     test_kernel32_tp_io();
@@ -98,7 +98,18 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
-#define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
+#define WAITQUEUE_MAX_COMPLETIONS 64
+
+#define THREADPOOL_MAX_QUEUES 64
+
+/* queue of pending work items; objects are spread over several queues to
+ * avoid contention, and idle workers take work from any of them */
+struct threadpool_queue
+{
+    CRITICAL_SECTION        cs;
+    /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
+    struct list             pools[3];
+};
 
 /* internal threadpool representation */
 struct threadpool
@@ -107,16 +118,22 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
-    struct list             pools[3];
     RTL_CONDITION_VARIABLE  update_event;
-    /* information about worker threads, locked via .cs */
+    /* information about worker threads, locked via .cs; the counters are also read without it */
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;
+    LONG                    num_busy_workers;
+    LONG                    num_idle_workers;
+    LONG                    num_wakeups;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
+    /* number of objects queued for each priority, over all the queues */
+    LONG                    num_queued[3];
+    LONG                    next_queue;
+    LONG                    next_worker_queue;
+    unsigned int            num_queues;
+    struct threadpool_queue queues[1];
 };
 
 enum threadpool_objtype
@@ -143,6 +160,7 @@ struct threadpool_object
     /* read-only information */
     enum threadpool_objtype type;
     struct threadpool       *pool;
+    struct threadpool_queue *queue;
     struct threadpool_group *group;
     PVOID                   userdata;
     PTP_CLEANUP_GROUP_CANCEL_CALLBACK group_cancel_callback;
@@ -153,7 +171,7 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the pool, locked via .queue->cs */
     struct list             pool_entry;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
@@ -189,9 +207,13 @@ struct threadpool_object
             PTP_WAIT_CALLBACK callback;
             LONG            signaled;
             /* information about the wait object, locked via waitqueue.cs */
-            struct waitqueue_bucket *bucket;
+            HANDLE          packet;
             BOOL            wait_pending;
+            BOOL            wait_associated;
+            BOOL            wait_deferred;
+            ULONG           serial;
             struct list     wait_entry;
+            struct list     deferred_entry;
             ULONGLONG       timeout;
             HANDLE          handle;
             DWORD           flags;
@@ -200,7 +222,7 @@ struct threadpool_object
         struct
         {
             PTP_IO_CALLBACK callback;
-            /* locked via .pool->cs */
+            /* locked via .queue->cs */
             unsigned int    pending_count, skipped_count, completion_count, completion_max;
             BOOL            shutting_down;
             struct io_completion *completions;
@@ -269,14 +291,22 @@ static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug;
 static struct
 {
     CRITICAL_SECTION        cs;
-    LONG                    num_buckets;
-    struct list             buckets;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    DWORD                   thread_id;
+    HANDLE                  port;
+    struct list             pending_timeouts;
+    struct list             deferred_waits;
 }
 waitqueue =
 {
     { &waitqueue_debug, -1, 0, 0, 0, 0 },       /* cs */
-    0,                                          /* num_buckets */
-    LIST_INIT( waitqueue.buckets )              /* buckets */
+    0,                                          /* objcount */
+    FALSE,                                      /* thread_running */
+    0,                                          /* thread_id */
+    NULL,                                       /* port */
+    LIST_INIT( waitqueue.pending_timeouts ),    /* pending_timeouts */
+    LIST_INIT( waitqueue.deferred_waits )       /* deferred_waits */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
@@ -286,16 +316,6 @@ static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
 };
 
-struct waitqueue_bucket
-{
-    struct list             bucket_entry;
-    LONG                    objcount;
-    struct list             reserved;
-    struct list             waiting;
-    HANDLE                  update_event;
-    BOOL                    alertable;
-};
-
 /* global I/O completion queue object */
 static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug;
 
@@ -1238,18 +1258,151 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
     RtlLeaveCriticalSection( &timerqueue.cs );
 }
 
+/***********************************************************************
+ *           tp_wait_is_mutant    (internal)
+ *
+ * Checks whether the handle of a wait object refers to a mutant.
+ */
+static BOOL tp_wait_is_mutant( struct threadpool_object *wait )
+{
+    static const WCHAR mutantW[] = {'M','u','t','a','n','t'};
+    char buffer[sizeof(OBJECT_TYPE_INFORMATION) + 64];
+    OBJECT_TYPE_INFORMATION *info = (OBJECT_TYPE_INFORMATION *)buffer;
+
+    if (NtQueryObject( wait->u.wait.handle, ObjectTypeInformation, info, sizeof(buffer), NULL ))
+        return FALSE;
+    return info->TypeName.Length == sizeof(mutantW) &&
+           !memcmp( info->TypeName.Buffer, mutantW, sizeof(mutantW) );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_associate    (internal)
+ *
+ * Asks the server to queue a completion to the wait queue port once the
+ * handle of a wait object is signaled. The pending completion holds a
+ * reference to the object. waitqueue.cs has to be held.
+ */
+static void tp_waitqueue_associate( struct threadpool_object *wait )
+{
+    NTSTATUS status;
+
+    /* A mutant is acquired by the thread which associated the wait, leave
+     * that to the wait queue thread so that it keeps owning satisfied mutants. */
+    if (HandleToULong( NtCurrentTeb()->ClientId.UniqueThread ) != waitqueue.thread_id &&
+        tp_wait_is_mutant( wait ))
+    {
+        if (!wait->u.wait.wait_deferred)
+        {
+            list_add_tail( &waitqueue.deferred_waits, &wait->u.wait.deferred_entry );
+            wait->u.wait.wait_deferred = TRUE;
+            NtSetIoCompletion( waitqueue.port, 0, 0, STATUS_SUCCESS, 0 );
+        }
+        return;
+    }
+
+    InterlockedIncrement( &wait->refcount );
+    wait->u.wait.serial++;
+
+    status = NtAssociateWaitCompletionPacket( wait->u.wait.packet, waitqueue.port, wait->u.wait.handle,
+                                              wait, ULongToPtr( wait->u.wait.serial ), STATUS_SUCCESS, 0, NULL );
+    if (status)
+    {
+        WARN( "failed to wait for handle %p, status %#lx\n", wait->u.wait.handle, status );
+        InterlockedDecrement( &wait->refcount );
+        return;
+    }
+
+    wait->u.wait.wait_associated = TRUE;
+}
+
+/***********************************************************************
+ *           tp_waitqueue_cancel    (internal)
+ *
+ * Cancels the pending completion of a wait object, waitqueue.cs has to
+ * be held. The caller has to hold a reference to the object.
+ */
+static void tp_waitqueue_cancel( struct threadpool_object *wait )
+{
+    if (wait->u.wait.wait_deferred)
+    {
+        list_remove( &wait->u.wait.deferred_entry );
+        wait->u.wait.wait_deferred = FALSE;
+    }
+
+    if (!wait->u.wait.wait_associated) return;
+    wait->u.wait.wait_associated = FALSE;
+
+    /* If the completion was already removed from the port, the wait queue
+     * thread will drop the reference when it sees the outdated serial. */
+    if (!NtCancelWaitCompletionPacket( wait->u.wait.packet, TRUE ))
+        InterlockedDecrement( &wait->refcount );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_add_timeout    (internal)
+ *
+ * Inserts a wait object into the list of pending timeouts, which is
+ * sorted by timeout. New timeouts usually expire last, so the insertion
+ * point is searched from the end. waitqueue.cs has to be held.
+ */
+static void tp_waitqueue_add_timeout( struct threadpool_object *wait )
+{
+    struct threadpool_object *other_wait;
+    struct list *ptr = &waitqueue.pending_timeouts;
+
+    LIST_FOR_EACH_ENTRY_REV( other_wait, &waitqueue.pending_timeouts, struct threadpool_object, u.wait.wait_entry )
+    {
+        assert( other_wait->type == TP_OBJECT_TYPE_WAIT );
+        if (other_wait->u.wait.timeout <= wait->u.wait.timeout) break;
+        ptr = &other_wait->u.wait.wait_entry;
+    }
+    list_add_before( ptr, &wait->u.wait.wait_entry );
+
+    /* Wake up the wait queue thread when the timeout has to be updated. */
+    if (list_head( &waitqueue.pending_timeouts ) == &wait->u.wait.wait_entry)
+        NtSetIoCompletion( waitqueue.port, 0, 0, STATUS_SUCCESS, 0 );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_trigger    (internal)
+ *
+ * Runs or queues the callback of a wait object that was signaled or has
+ * timed out, waitqueue.cs has to be held.
+ */
+static void tp_waitqueue_trigger( struct threadpool_object *wait, BOOL signaled )
+{
+    assert( wait->type == TP_OBJECT_TYPE_WAIT );
+
+    if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
+    {
+        InterlockedIncrement( &wait->refcount );
+        RtlEnterCriticalSection( &wait->queue->cs );
+        if (signaled) wait->u.wait.signaled++;
+        wait->num_pending_callbacks++;
+        tp_object_execute( wait, TRUE );
+        RtlLeaveCriticalSection( &wait->queue->cs );
+        tp_object_release( wait );
+    }
+    else tp_object_submit( wait, signaled );
+}
+
 /***********************************************************************
  *           waitqueue_thread_proc    (internal)
+ *
+ * All wait objects of the process share a single thread and a single
+ * completion port: the server queues a completion when the handle of a
+ * wait object is signaled, so the cost of arming a wait does not depend
+ * on the number of registered waits.
  */
 static void CALLBACK waitqueue_thread_proc( void *param )
 {
-    struct threadpool_object *objects[MAXIMUM_WAITQUEUE_OBJECTS];
-    HANDLE handles[MAXIMUM_WAITQUEUE_OBJECTS + 1];
-    struct waitqueue_bucket *bucket = param;
-    struct threadpool_object *wait, *next;
+    FILE_IO_COMPLETION_INFORMATION info[WAITQUEUE_MAX_COMPLETIONS];
+    struct threadpool_object *wait;
     LARGE_INTEGER now, timeout;
-    DWORD num_handles;
+    struct list expired, *ptr;
+    ULONG i, count;
     NTSTATUS status;
+    BOOL idle;
 
     TRACE( "starting wait queue thread\n" );
     set_thread_name(L"wine_threadpool_waitqueue");
@@ -1258,158 +1411,97 @@ static void CALLBACK waitqueue_thread_proc( void *param )
 
     for (;;)
     {
+        /* Associate the waits which have to be satisfied by this thread. */
+        while ((ptr = list_head( &waitqueue.deferred_waits )))
+        {
+            wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.deferred_entry );
+            list_remove( ptr );
+            wait->u.wait.wait_deferred = FALSE;
+            tp_waitqueue_associate( wait );
+        }
+
         NtQuerySystemTime( &now );
-        timeout.QuadPart = MAXLONGLONG;
-        num_handles = 0;
 
-        LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->waiting, struct threadpool_object,
-                                  u.wait.wait_entry )
+        /* Move all timed out wait objects to a private list first, the list
+         * of pending timeouts can change while callbacks are executed. */
+        list_init( &expired );
+        while ((ptr = list_head( &waitqueue.pending_timeouts )))
         {
-            assert( wait->type == TP_OBJECT_TYPE_WAIT );
-            if (wait->u.wait.timeout <= now.QuadPart)
-            {
-                /* Wait object timed out. */
-                if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
-                {
-                    list_remove( &wait->u.wait.wait_entry );
-                    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
-                }
-                if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
-                {
-                    InterlockedIncrement( &wait->refcount );
-                    wait->num_pending_callbacks++;
-                    RtlEnterCriticalSection( &wait->pool->cs );
-                    tp_object_execute( wait, TRUE );
-                    RtlLeaveCriticalSection( &wait->pool->cs );
-                    tp_object_release( wait );
-                }
-                else tp_object_submit( wait, FALSE );
-            }
-            else
+            wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry );
+            if (wait->u.wait.timeout > now.QuadPart) break;
+            list_remove( ptr );
+            list_add_tail( &expired, ptr );
+        }
+
+        while ((ptr = list_head( &expired )))
+        {
+            /* Wait object timed out. */
+            wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry );
+            InterlockedIncrement( &wait->refcount );
+            tp_waitqueue_cancel( wait );
+            list_remove( ptr );
+            if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
             {
-                if (wait->u.wait.timeout < timeout.QuadPart)
-                    timeout.QuadPart = wait->u.wait.timeout;
-
-                assert( num_handles < MAXIMUM_WAITQUEUE_OBJECTS );
-                InterlockedIncrement( &wait->refcount );
-                objects[num_handles] = wait;
-                handles[num_handles] = wait->u.wait.handle;
-                num_handles++;
+                list_init( ptr );
+                wait->u.wait.wait_pending = FALSE;
             }
+            else list_add_head( &waitqueue.pending_timeouts, ptr );
+            tp_waitqueue_trigger( wait, FALSE );
+            tp_object_release( wait );
         }
 
-        if (!bucket->objcount)
+        idle = FALSE;
+        if ((ptr = list_head( &waitqueue.pending_timeouts )))
+            timeout.QuadPart = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry )->u.wait.timeout;
+        else if (!waitqueue.objcount)
         {
             /* All wait objects have been destroyed, if no new wait objects are created
              * within some amount of time, then we can shutdown this thread. */
-            assert( num_handles == 0 );
-            RtlLeaveCriticalSection( &waitqueue.cs );
             timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-            status = NtWaitForMultipleObjects( 1, &bucket->update_event, TRUE, bucket->alertable, &timeout );
-            RtlEnterCriticalSection( &waitqueue.cs );
-
-            if (status == STATUS_TIMEOUT && !bucket->objcount)
-                break;
+            idle = TRUE;
         }
-        else
-        {
-            handles[num_handles] = bucket->update_event;
-            RtlLeaveCriticalSection( &waitqueue.cs );
-            status = NtWaitForMultipleObjects( num_handles + 1, handles, TRUE, bucket->alertable, &timeout );
-            RtlEnterCriticalSection( &waitqueue.cs );
+        else timeout.QuadPart = MAXLONGLONG;
 
-            if (status >= STATUS_WAIT_0 && status < STATUS_WAIT_0 + num_handles)
-            {
-                wait = objects[status - STATUS_WAIT_0];
-                assert( wait->type == TP_OBJECT_TYPE_WAIT );
-                if (wait->u.wait.bucket)
-                {
-                    /* Wait object signaled. */
-                    assert( wait->u.wait.bucket == bucket );
-                    if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
-                    {
-                        list_remove( &wait->u.wait.wait_entry );
-                        list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
-                    }
-                    if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
-                    {
-                        wait->u.wait.signaled++;
-                        wait->num_pending_callbacks++;
-                        RtlEnterCriticalSection( &wait->pool->cs );
-                        tp_object_execute( wait, TRUE );
-                        RtlLeaveCriticalSection( &wait->pool->cs );
-                    }
-                    else tp_object_submit( wait, TRUE );
-                }
-                else
-                    WARN("wait object %p triggered while object was destroyed\n", wait);
-            }
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        status = NtRemoveIoCompletionEx( waitqueue.port, info, ARRAY_SIZE(info), &count,
+                                         timeout.QuadPart == MAXLONGLONG ? NULL : &timeout, TRUE );
+        RtlEnterCriticalSection( &waitqueue.cs );
 
-            /* Release temporary references to wait objects. */
-            while (num_handles)
-            {
-                wait = objects[--num_handles];
-                assert( wait->type == TP_OBJECT_TYPE_WAIT );
-                tp_object_release( wait );
-            }
-        }
+        if (status == STATUS_TIMEOUT && idle && !waitqueue.objcount)
+            break;
+        if (status != STATUS_SUCCESS) continue;
 
-        /* Try to merge bucket with other threads. */
-        if (waitqueue.num_buckets > 1 && bucket->objcount &&
-            bucket->objcount <= MAXIMUM_WAITQUEUE_OBJECTS * 1 / 3)
+        for (i = 0; i < count; i++)
         {
-            struct waitqueue_bucket *other_bucket;
-            LIST_FOR_EACH_ENTRY( other_bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
+            if (!(wait = (struct threadpool_object *)info[i].CompletionKey)) continue;
+            assert( wait->type == TP_OBJECT_TYPE_WAIT );
+
+            if (wait->u.wait.wait_associated && info[i].CompletionValue == wait->u.wait.serial)
             {
-                if (other_bucket != bucket && other_bucket->objcount && other_bucket->alertable == bucket->alertable &&
-                    other_bucket->objcount + bucket->objcount <= MAXIMUM_WAITQUEUE_OBJECTS * 2 / 3)
+                /* Wait object signaled. */
+                wait->u.wait.wait_associated = FALSE;
+                if ((wait->u.wait.flags & WT_EXECUTEONLYONCE))
                 {
-                    other_bucket->objcount += bucket->objcount;
-                    bucket->objcount = 0;
-
-                    /* Update reserved list. */
-                    LIST_FOR_EACH_ENTRY( wait, &bucket->reserved, struct threadpool_object, u.wait.wait_entry )
-                    {
-                        assert( wait->type == TP_OBJECT_TYPE_WAIT );
-                        wait->u.wait.bucket = other_bucket;
-                    }
-                    list_move_tail( &other_bucket->reserved, &bucket->reserved );
-
-                    /* Update waiting list. */
-                    LIST_FOR_EACH_ENTRY( wait, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
-                    {
-                        assert( wait->type == TP_OBJECT_TYPE_WAIT );
-                        wait->u.wait.bucket = other_bucket;
-                    }
-                    list_move_tail( &other_bucket->waiting, &bucket->waiting );
-
-                    /* Move bucket to the end, to keep the probability of
-                     * newly added wait objects as small as possible. */
-                    list_remove( &bucket->bucket_entry );
-                    list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
-
-                    NtSetEvent( other_bucket->update_event, NULL );
-                    break;
+                    list_remove( &wait->u.wait.wait_entry );
+                    list_init( &wait->u.wait.wait_entry );
+                    wait->u.wait.wait_pending = FALSE;
                 }
+                else tp_waitqueue_associate( wait );
+                tp_waitqueue_trigger( wait, TRUE );
             }
+            else
+                TRACE( "ignoring outdated completion for wait object %p\n", wait );
+
+            /* Release the reference held by the completion. */
+            tp_object_release( wait );
         }
     }
 
-    /* Remove this bucket from the list. */
-    list_remove( &bucket->bucket_entry );
-    if (!--waitqueue.num_buckets)
-        assert( list_empty( &waitqueue.buckets ) );
-
+    waitqueue.thread_running = FALSE;
     RtlLeaveCriticalSection( &waitqueue.cs );
 
     TRACE( "terminating wait queue thread\n" );
 
-    assert( bucket->objcount == 0 );
-    assert( list_empty( &bucket->reserved ) );
-    assert( list_empty( &bucket->waiting ) );
-    NtClose( bucket->update_event );
-
-    RtlFreeHeap( GetProcessHeap(), 0, bucket );
     RtlExitUserThread( 0 );
 }
 
@@ -1418,76 +1510,50 @@ static void CALLBACK waitqueue_thread_proc( void *param )
  */
 static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
 {
-    struct waitqueue_bucket *bucket;
+    CLIENT_ID client_id;
     NTSTATUS status;
     HANDLE thread;
-    BOOL alertable = (wait->u.wait.flags & WT_EXECUTEINIOTHREAD) != 0;
     assert( wait->type == TP_OBJECT_TYPE_WAIT );
 
-    wait->u.wait.signaled       = 0;
-    wait->u.wait.bucket         = NULL;
-    wait->u.wait.wait_pending   = FALSE;
-    wait->u.wait.timeout        = 0;
-    wait->u.wait.handle         = INVALID_HANDLE_VALUE;
+    wait->u.wait.signaled        = 0;
+    wait->u.wait.packet          = NULL;
+    wait->u.wait.wait_pending    = FALSE;
+    wait->u.wait.wait_associated = FALSE;
+    wait->u.wait.wait_deferred   = FALSE;
+    wait->u.wait.serial          = 0;
+    wait->u.wait.timeout         = 0;
+    wait->u.wait.handle          = INVALID_HANDLE_VALUE;
+    list_init( &wait->u.wait.wait_entry );
+
+    if ((status = NtCreateWaitCompletionPacket( &wait->u.wait.packet, GENERIC_ALL, NULL )))
+        return status;
 
     RtlEnterCriticalSection( &waitqueue.cs );
 
-    /* Try to assign to existing bucket if possible. */
-    LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
-    {
-        if (bucket->objcount < MAXIMUM_WAITQUEUE_OBJECTS && bucket->alertable == alertable)
-        {
-            list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
-            wait->u.wait.bucket = bucket;
-            bucket->objcount++;
-
-            status = STATUS_SUCCESS;
-            goto out;
-        }
-    }
-
-    /* Create a new bucket and corresponding worker thread. */
-    bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) );
-    if (!bucket)
-    {
-        status = STATUS_NO_MEMORY;
+    if (!waitqueue.port && (status = NtCreateIoCompletion( &waitqueue.port,
+            IO_COMPLETION_ALL_ACCESS, NULL, 0 )))
         goto out;
-    }
-
-    bucket->objcount = 0;
-    bucket->alertable = alertable;
-    list_init( &bucket->reserved );
-    list_init( &bucket->waiting );
 
-    status = NtCreateEvent( &bucket->update_event, EVENT_ALL_ACCESS,
-                            NULL, SynchronizationEvent, FALSE );
-    if (status)
+    if (!waitqueue.thread_running)
     {
-        RtlFreeHeap( GetProcessHeap(), 0, bucket );
-        goto out;
+        if ((status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
+                                           waitqueue_thread_proc, NULL, &thread, &client_id )))
+            goto out;
+        waitqueue.thread_running = TRUE;
+        waitqueue.thread_id = HandleToULong( client_id.UniqueThread );
+        NtClose( thread );
     }
 
-    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
-                                  waitqueue_thread_proc, bucket, &thread, NULL );
-    if (status == STATUS_SUCCESS)
-    {
-        list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
-        waitqueue.num_buckets++;
+    waitqueue.objcount++;
 
-        list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
-        wait->u.wait.bucket = bucket;
-        bucket->objcount++;
+out:
+    RtlLeaveCriticalSection( &waitqueue.cs );
 
-        NtClose( thread );
-    }
-    else
+    if (status)
     {
-        NtClose( bucket->update_event );
-        RtlFreeHeap( GetProcessHeap(), 0, bucket );
+        NtClose( wait->u.wait.packet );
+        wait->u.wait.packet = NULL;
     }
-
-out:
-    RtlLeaveCriticalSection( &waitqueue.cs );
     return status;
 }
 
@@ -1499,16 +1565,21 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
     assert( wait->type == TP_OBJECT_TYPE_WAIT );
 
     RtlEnterCriticalSection( &waitqueue.cs );
-    if (wait->u.wait.bucket)
+    if (wait->u.wait.packet)
     {
-        struct waitqueue_bucket *bucket = wait->u.wait.bucket;
-        assert( bucket->objcount > 0 );
+        assert( waitqueue.objcount > 0 );
 
+        tp_waitqueue_cancel( wait );
         list_remove( &wait->u.wait.wait_entry );
-        wait->u.wait.bucket = NULL;
-        bucket->objcount--;
+        list_init( &wait->u.wait.wait_entry );
+        wait->u.wait.wait_pending = FALSE;
 
-        NtSetEvent( bucket->update_event, NULL );
+        NtClose( wait->u.wait.packet );
+        wait->u.wait.packet = NULL;
+
+        /* Let the wait queue thread start its idle timeout. */
+        if (!--waitqueue.objcount)
+            NtSetIoCompletion( waitqueue.port, 0, 0, STATUS_SUCCESS, 0 );
     }
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
@@ -1541,7 +1612,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
 
         if (io && (io->shutdown || io->u.io.shutting_down))
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            RtlEnterCriticalSection( &io->queue->cs );
             if (!io->u.io.pending_count)
             {
                 if (io->u.io.skipped_count)
@@ -1552,7 +1623,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                 else
                     destroy = TRUE;
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlLeaveCriticalSection( &io->queue->cs );
             if (skip) continue;
         }
 
@@ -1565,7 +1636,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
         }
         else if (io)
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            RtlEnterCriticalSection( &io->queue->cs );
 
             TRACE( "pending_count %u.\n", io->u.io.pending_count );
 
@@ -1576,7 +1647,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                         io->u.io.completion_count + 1, sizeof(*io->u.io.completions)))
                 {
                     ERR( "Failed to allocate memory.\n" );
-                    RtlLeaveCriticalSection( &io->pool->cs );
+                    RtlLeaveCriticalSection( &io->queue->cs );
                     continue;
                 }
 
@@ -1586,7 +1657,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
 
                 tp_object_submit( io, FALSE );
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlLeaveCriticalSection( &io->queue->cs );
         }
 
         if (!ioqueue.objcount)
@@ -1665,10 +1736,11 @@ static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
 static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
     IMAGE_NT_HEADERS *nt = RtlImageNtHeader( NtCurrentTeb()->Peb->ImageBaseAddress );
+    unsigned int num_queues = min( max( NtCurrentTeb()->Peb->NumberOfProcessors, 1 ), THREADPOOL_MAX_QUEUES );
     struct threadpool *pool;
-    unsigned int i;
+    unsigned int i, j;
 
-    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct threadpool, queues[num_queues] ));
     if (!pool)
         return STATUS_NO_MEMORY;
 
@@ -1679,16 +1751,28 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        list_init( &pool->pools[i] );
+    for (i = 0; i < num_queues; ++i)
+    {
+        RtlInitializeCriticalSection( &pool->queues[i].cs );
+        pool->queues[i].cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool_queue.cs");
+        for (j = 0; j < ARRAY_SIZE(pool->queues[i].pools); ++j)
+            list_init( &pool->queues[i].pools[j] );
+    }
     RtlInitializeConditionVariable( &pool->update_event );
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
     pool->num_workers             = 0;
     pool->num_busy_workers        = 0;
+    pool->num_idle_workers        = 0;
+    pool->num_wakeups             = 0;
     pool->stack_info.StackReserve = nt->OptionalHeader.SizeOfStackReserve;
     pool->stack_info.StackCommit  = nt->OptionalHeader.SizeOfStackCommit;
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued); ++i)
+        pool->num_queued[i] = 0;
+    pool->next_queue              = 0;
+    pool->next_worker_queue       = 0;
+    pool->num_queues              = num_queues;
 
     TRACE( "allocated threadpool %p\n", pool );
 
@@ -1707,8 +1791,10 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
 {
     assert( pool != default_threadpool );
 
+    RtlEnterCriticalSection( &pool->cs );
     pool->shutdown = TRUE;
     RtlWakeAllConditionVariable( &pool->update_event );
+    RtlLeaveCriticalSection( &pool->cs );
 }
 
 /***********************************************************************
@@ -1718,7 +1804,7 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
  */
 static BOOL tp_threadpool_release( struct threadpool *pool )
 {
-    unsigned int i;
+    unsigned int i, j;
 
     if (InterlockedDecrement( &pool->refcount ))
         return FALSE;
@@ -1727,8 +1813,13 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        assert( list_empty( &pool->pools[i] ) );
+    for (i = 0; i < pool->num_queues; ++i)
+    {
+        for (j = 0; j < ARRAY_SIZE(pool->queues[i].pools); ++j)
+            assert( list_empty( &pool->queues[i].pools[j] ) );
+        pool->queues[i].cs.DebugInfo->Spare[0] = 0;
+        RtlDeleteCriticalSection( &pool->queues[i].cs );
+    }
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1897,6 +1988,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     object->shutdown                = FALSE;
 
     object->pool                    = pool;
+    object->queue                   = &pool->queues[(ULONG)InterlockedIncrement( &pool->next_queue ) % pool->num_queues];
     object->group                   = NULL;
     object->userdata                = userdata;
     object->group_cancel_callback   = NULL;
@@ -1931,7 +2023,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
             TP_CALLBACK_ENVIRON_V3 *environment_v3 = (TP_CALLBACK_ENVIRON_V3 *)environment;
 
             object->priority = environment_v3->CallbackPriority;
-            assert( object->priority < ARRAY_SIZE(pool->pools) );
+            assert( object->priority < ARRAY_SIZE(pool->num_queued) );
         }
 
         if (environment->ActivationContext)
@@ -1970,8 +2062,50 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 
 static void tp_object_prio_queue( struct threadpool_object *object )
 {
-    ++object->pool->num_busy_workers;
-    list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
+    InterlockedIncrement( &object->pool->num_busy_workers );
+    list_add_tail( &object->queue->pools[object->priority], &object->pool_entry );
+    InterlockedIncrement( &object->pool->num_queued[object->priority] );
+}
+
+static void tp_object_prio_dequeue( struct threadpool_object *object )
+{
+    list_remove( &object->pool_entry );
+    InterlockedDecrement( &object->pool->num_queued[object->priority] );
+}
+
+/***********************************************************************
+ *           tp_threadpool_notify    (internal)
+ *
+ * Makes sure that a worker thread picks up newly queued work, either by
+ * starting a new one or by waking up an idle one. Busy workers look for
+ * more work before going idle, so there is nothing to do when neither is
+ * needed, and the pool lock is not taken in that case.
+ */
+static void tp_threadpool_notify( struct threadpool *pool )
+{
+    BOOL need_worker = ReadNoFence( &pool->num_busy_workers ) >= ReadNoFence( &pool->num_workers ) &&
+                       ReadNoFence( &pool->num_workers ) < pool->max_workers;
+
+    if (!need_worker && !ReadNoFence( &pool->num_idle_workers )) return;
+
+    RtlEnterCriticalSection( &pool->cs );
+
+    /* Start new worker threads if required. */
+    if (pool->num_busy_workers >= pool->num_workers && pool->num_workers < pool->max_workers &&
+        tp_new_worker_thread( pool ) == STATUS_SUCCESS)
+    {
+        RtlLeaveCriticalSection( &pool->cs );
+        return;
+    }
+
+    /* No new thread started - wake up one existing thread. */
+    if (pool->num_wakeups < pool->num_idle_workers)
+    {
+        pool->num_wakeups++;
+        RtlWakeConditionVariable( &pool->update_event );
+    }
+
+    RtlLeaveCriticalSection( &pool->cs );
 }
 
 /***********************************************************************
@@ -1983,17 +2117,11 @@ static void tp_object_prio_queue( struct threadpool_object *object )
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
-    RtlEnterCriticalSection( &pool->cs );
-
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+    RtlEnterCriticalSection( &object->queue->cs );
 
     /* Queue work item and increment refcount. */
     InterlockedIncrement( &object->refcount );
@@ -2004,14 +2132,9 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
         object->u.wait.signaled++;
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
-    {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
-    }
+    RtlLeaveCriticalSection( &object->queue->cs );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    tp_threadpool_notify( pool );
 }
 
 /***********************************************************************
@@ -2021,15 +2144,14 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
  */
 static void tp_object_cancel( struct threadpool_object *object )
 {
-    struct threadpool *pool = object->pool;
     LONG pending_callbacks = 0;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlEnterCriticalSection( &object->queue->cs );
     if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
+        tp_object_prio_dequeue( object );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2039,7 +2161,7 @@ static void tp_object_cancel( struct threadpool_object *object )
         object->u.io.skipped_count += object->u.io.pending_count;
         object->u.io.pending_count = 0;
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &object->queue->cs );
 
     while (pending_callbacks--)
         tp_object_release( object );
@@ -2066,17 +2188,17 @@ static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlEnterCriticalSection( &queue->cs );
     while (!object_is_finished( object, group_wait ))
     {
         if (group_wait)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableCS( &object->group_finished_event, &queue->cs, NULL );
         else
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableCS( &object->finished_event, &queue->cs, NULL );
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
 }
 
 static void tp_ioqueue_unlock( struct threadpool_object *io )
@@ -2153,24 +2275,64 @@ static BOOL tp_object_release( struct threadpool_object *object )
     return TRUE;
 }
 
-static struct list *threadpool_get_next_item( const struct threadpool *pool )
+static BOOL threadpool_has_work( struct threadpool *pool )
 {
-    struct list *ptr;
     unsigned int i;
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued); ++i)
+        if (ReadNoFence( &pool->num_queued[i] )) return TRUE;
+    return FALSE;
+}
+
+/***********************************************************************
+ *           threadpool_get_next_item    (internal)
+ *
+ * Takes the next object to execute, starting with the home queue of the
+ * worker and stealing from the other queues when it is empty. Higher
+ * priority work is always taken first, whatever queue it is in. On
+ * success, the lock of the object queue is held.
+ */
+static struct threadpool_object *threadpool_get_next_item( struct threadpool *pool, unsigned int home )
+{
+    struct threadpool_object *object;
+    struct threadpool_queue *queue;
+    unsigned int i, j;
+    struct list *ptr;
+
+    for (i = 0; i < ARRAY_SIZE(pool->num_queued); ++i)
     {
-        if ((ptr = list_head( &pool->pools[i] )))
-            break;
-    }
+        if (!ReadNoFence( &pool->num_queued[i] )) continue;
+
+        for (j = 0; j < pool->num_queues; ++j)
+        {
+            queue = &pool->queues[(home + j) % pool->num_queues];
+
+            /* unlocked check to skip empty queues, it is redone below */
+            if (list_empty( &queue->pools[i] )) continue;
 
-    return ptr;
+            RtlEnterCriticalSection( &queue->cs );
+            if ((ptr = list_head( &queue->pools[i] )))
+            {
+                object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+                assert( object->num_pending_callbacks > 0 );
+
+                /* If further pending callbacks are queued, move the work item to
+                 * the end of the pool list. Otherwise remove it from the pool. */
+                tp_object_prio_dequeue( object );
+                if (object->num_pending_callbacks > 1)
+                    tp_object_prio_queue( object );
+                return object;
+            }
+            RtlLeaveCriticalSection( &queue->cs );
+        }
+    }
+    return NULL;
 }
 
 /***********************************************************************
  *           tp_object_execute    (internal)
  *
- * Executes a threadpool object callback, object->pool->cs has to be
+ * Executes a threadpool object callback, object->queue->cs has to be
  * held.
  */
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
@@ -2178,7 +2340,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct io_completion completion;
-    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
     TP_WAIT_RESULT wait_result = 0;
     NTSTATUS status;
 
@@ -2199,7 +2361,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
     /* Leave critical section and do the actual callback. */
     object->num_associated_callbacks++;
     object->num_running_callbacks++;
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
     if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
 
     /* Initialize threadpool instance struct. */
@@ -2305,7 +2467,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
 
 skip_cleanup:
     if (wait_thread) RtlEnterCriticalSection( &waitqueue.cs );
-    RtlEnterCriticalSection( &pool->cs );
+    RtlEnterCriticalSection( &queue->cs );
 
     /* Simple callbacks are automatically shutdown after execution. */
     if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2332,52 +2494,64 @@ skip_cleanup:
 static void CALLBACK threadpool_worker_proc( void *param )
 {
     struct threadpool *pool = param;
+    unsigned int home = (ULONG)InterlockedIncrement( &pool->next_worker_queue ) % pool->num_queues;
+    struct threadpool_object *object;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
     set_thread_name(L"wine_threadpool_worker");
 
-    RtlEnterCriticalSection( &pool->cs );
     for (;;)
     {
-        while ((ptr = threadpool_get_next_item( pool )))
+        while ((object = threadpool_get_next_item( pool, home )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (object->num_pending_callbacks > 1)
-                tp_object_prio_queue( object );
-
             tp_object_execute( object, FALSE );
+            RtlLeaveCriticalSection( &object->queue->cs );
 
             assert(pool->num_busy_workers);
-            pool->num_busy_workers--;
+            InterlockedDecrement( &pool->num_busy_workers );
 
             tp_object_release( object );
         }
 
+        RtlEnterCriticalSection( &pool->cs );
+
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
+        {
+            pool->num_workers--;
             break;
+        }
 
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        /* Wait for new tasks or until the timeout expires. Work queued after
+         * the idle count is raised always triggers a wakeup, anything queued
+         * before that is seen by the check below. */
+        InterlockedIncrement( &pool->num_idle_workers );
+        status = STATUS_SUCCESS;
+        if (!pool->num_wakeups && !threadpool_has_work( pool ))
+        {
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        }
+        InterlockedDecrement( &pool->num_idle_workers );
+        if (pool->num_wakeups) pool->num_wakeups--;
+
+        /* A thread only terminates when no new tasks are available, and the number
+         * of threads can be decreased without violating the min_workers limit. An
+         * exception is when min_workers == 0, then objcount is used to detect if
+         * the last thread can be terminated. Work submitted concurrently either
+         * sees the reduced worker count and starts a new thread, or is seen here. */
+        if (status == STATUS_TIMEOUT && !pool->shutdown && !threadpool_has_work( pool ) &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
-            break;
+            InterlockedDecrement( &pool->num_workers );
+            if (!threadpool_has_work( pool )) break;
+            InterlockedIncrement( &pool->num_workers );
         }
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    pool->num_workers--;
     RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
@@ -2578,7 +2752,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlEnterCriticalSection( &this->queue->cs );
 
     TRACE("pending_count %u.\n", this->u.io.pending_count);
 
@@ -2588,7 +2762,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
     if (object_is_finished( this, FALSE ))
         RtlWakeAllConditionVariable( &this->finished_event );
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlLeaveCriticalSection( &this->queue->cs );
 }
 
 /***********************************************************************
@@ -2708,7 +2882,7 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
+    struct threadpool_queue *queue;
 
     TRACE( "%p\n", instance );
 
@@ -2721,14 +2895,14 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
+    queue = object->queue;
+    RtlEnterCriticalSection( &queue->cs );
 
     object->num_associated_callbacks--;
     if (object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
     this->associated = FALSE;
 }
 
@@ -2852,10 +3026,10 @@ void WINAPI TpReleaseIoCompletion( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlEnterCriticalSection( &this->queue->cs );
     this->u.io.shutting_down = TRUE;
     can_destroy = !this->u.io.pending_count && !this->u.io.skipped_count;
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlLeaveCriticalSection( &this->queue->cs );
 
     if (can_destroy)
     {
@@ -3054,13 +3228,14 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
 
     RtlEnterCriticalSection( &waitqueue.cs );
 
-    assert( this->u.wait.bucket );
+    assert( this->u.wait.packet );
     this->u.wait.handle = handle;
 
     if (handle || this->u.wait.wait_pending)
     {
-        struct waitqueue_bucket *bucket = this->u.wait.bucket;
+        tp_waitqueue_cancel( this );
         list_remove( &this->u.wait.wait_entry );
+        list_init( &this->u.wait.wait_entry );
 
         /* Convert relative timeout to absolute timestamp. */
         if (handle && timeout)
@@ -3074,21 +3249,17 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
             }
         }
 
-        /* Add wait object back into one of the queues. */
+        /* Start waiting for the new handle, only waits with a timeout
+         * have to be tracked by the wait queue thread. */
         if (handle)
         {
-            list_add_tail( &bucket->waiting, &this->u.wait.wait_entry );
             this->u.wait.wait_pending = TRUE;
             this->u.wait.timeout = timestamp;
+            tp_waitqueue_associate( this );
+            if (timestamp != MAXLONGLONG) tp_waitqueue_add_timeout( this );
         }
         else
-        {
-            list_add_tail( &bucket->reserved, &this->u.wait.wait_entry );
             this->u.wait.wait_pending = FALSE;
-        }
-
-        /* Wake up the wait queue thread. */
-        NtSetEvent( bucket->update_event, NULL );
     }
 
     RtlLeaveCriticalSection( &waitqueue.cs );
@@ -3133,11 +3304,11 @@ void WINAPI TpStartAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlEnterCriticalSection( &this->queue->cs );
 
     this->u.io.pending_count++;
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlLeaveCriticalSection( &this->queue->cs );
 }
 
 /***********************************************************************
@@ -3329,11 +3500,11 @@ NTSTATUS WINAPI RtlDeregisterWaitEx( HANDLE handle, HANDLE event )
         object->completed_event = event;
     }
 
-    RtlEnterCriticalSection( &object->pool->cs );
+    RtlEnterCriticalSection( &object->queue->cs );
     if (object->num_pending_callbacks + object->num_running_callbacks
         + object->num_associated_callbacks) status = STATUS_PENDING;
     else status = STATUS_SUCCESS;
-    RtlLeaveCriticalSection( &object->pool->cs );
+    RtlLeaveCriticalSection( &object->queue->cs );
 
     TpReleaseWait( (TP_WAIT *)object );
     return status;
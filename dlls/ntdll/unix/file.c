@@ -84,6 +84,11 @@
 #ifdef HAVE_LINUX_IOCTL_H
 #include <linux/ioctl.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
@@ -231,6 +236,26 @@ struct dir_data
     struct dir_data_buffer *buffer;  /* head of data buffers list */
 };
 
+/* case-insensitive index of the names of a directory, used by find_file_in_dir */
+struct dir_index_name
+{
+    unsigned int            next;       /* next name in the hash chain */
+    unsigned int            hash;       /* case-insensitive hash of the Unicode name */
+    unsigned int            unix_name;  /* offset of the Unix name in the buffer */
+};
+
+struct dir_index
+{
+    struct list             entry;      /* entry in the LRU list */
+    struct file_identity    id;         /* directory file identity */
+    ULONGLONG               mtime;      /* directory modification time */
+    unsigned int            count;      /* number of names */
+    unsigned int            hash_size;  /* size of the hash table, a power of 2 */
+    unsigned int           *hash_table; /* first name of each hash chain */
+    struct dir_index_name  *names;      /* names array */
+    char                   *buffer;     /* Unix names buffer */
+};
+
 static const unsigned int dir_data_buffer_initial_size = 4096;
 static const unsigned int dir_data_cache_initial_size  = 256;
 static const unsigned int dir_data_names_initial_size  = 64;
@@ -246,6 +271,13 @@ static const BOOL is_case_sensitive = FALSE;
 
 static pthread_mutex_t dir_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t mnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t dir_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define MAX_DIR_INDEXES 64
+
+static struct list dir_indexes = LIST_INIT( dir_indexes );  /* most recently used first */
+static unsigned int dir_index_count;
+static unsigned int dir_index_hits, dir_index_misses;
 
 /* check if a given Unicode char is OK in a DOS short name */
 static inline BOOL is_invalid_dos_char( WCHAR ch )
@@ -2695,6 +2727,201 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* return the modification time of a directory in nanoseconds */
+static ULONGLONG get_dir_mtime( const struct stat *st )
+{
+    ULONGLONG ret = (ULONGLONG)st->st_mtime * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    ret += st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    ret += st->st_mtimespec.tv_nsec;
+#endif
+    return ret;
+}
+
+static unsigned int hash_dir_name( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    while (length--) hash = hash * 31 + towupper( *name++ );
+    return hash;
+}
+
+static void free_dir_index( struct dir_index *index )
+{
+    free( index->hash_table );
+    free( index->names );
+    free( index->buffer );
+    free( index );
+}
+
+/* read all the names of a directory and build its case-insensitive index */
+static struct dir_index *create_dir_index( const char *unix_name, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_index *index;
+    struct dirent *de;
+    unsigned int i, len, names_size = 64, buffer_size = 4096, buffer_pos = 0;
+    DIR *dir;
+    int ret;
+
+    if (!(index = calloc( 1, sizeof(*index) ))) return NULL;
+    index->id.dev = st->st_dev;
+    index->id.ino = st->st_ino;
+    index->mtime  = get_dir_mtime( st );
+    if (!(index->names = malloc( names_size * sizeof(*index->names) ))) goto error;
+    if (!(index->buffer = malloc( buffer_size ))) goto error;
+    if (!(dir = opendir( unix_name ))) goto error;
+
+    while ((de = readdir( dir )))
+    {
+        len = strlen( de->d_name ) + 1;
+        ret = ntdll_umbstowcs( de->d_name, len - 1, buffer, MAX_DIR_ENTRY_LEN );
+
+        if (index->count == names_size)
+        {
+            struct dir_index_name *new_names;
+
+            names_size *= 2;
+            if (!(new_names = realloc( index->names, names_size * sizeof(*new_names) ))) break;
+            index->names = new_names;
+        }
+        if (buffer_pos + len > buffer_size)
+        {
+            char *new_buffer;
+
+            while (buffer_pos + len > buffer_size) buffer_size *= 2;
+            if (!(new_buffer = realloc( index->buffer, buffer_size ))) break;
+            index->buffer = new_buffer;
+        }
+        memcpy( index->buffer + buffer_pos, de->d_name, len );
+        index->names[index->count].hash = hash_dir_name( buffer, ret );
+        index->names[index->count].unix_name = buffer_pos;
+        index->count++;
+        buffer_pos += len;
+    }
+    closedir( dir );
+    if (de) goto error;  /* out of memory */
+
+    for (index->hash_size = 16; index->hash_size < index->count; index->hash_size *= 2) /* nothing */;
+    if (!(index->hash_table = malloc( index->hash_size * sizeof(*index->hash_table) ))) goto error;
+    memset( index->hash_table, 0xff, index->hash_size * sizeof(*index->hash_table) );
+
+    /* insert in reverse order so that chains follow the readdir order */
+    for (i = index->count; i > 0; i--)
+    {
+        unsigned int bucket = index->names[i - 1].hash & (index->hash_size - 1);
+        index->names[i - 1].next = index->hash_table[bucket];
+        index->hash_table[bucket] = i - 1;
+    }
+    return index;
+
+error:
+    free_dir_index( index );
+    return NULL;
+}
+
+/* get the index of a directory, creating it if needed; must be called with dir_index_mutex held */
+static struct dir_index *get_dir_index( const char *unix_name )
+{
+    struct dir_index *index;
+    struct stat st;
+
+    if (stat( unix_name, &st ) == -1) return NULL;
+
+    LIST_FOR_EACH_ENTRY( index, &dir_indexes, struct dir_index, entry )
+    {
+        if (index->id.dev != st.st_dev || index->id.ino != st.st_ino) continue;
+        list_remove( &index->entry );
+        if (index->mtime == get_dir_mtime( &st ))
+        {
+            list_add_head( &dir_indexes, &index->entry );
+            dir_index_hits++;
+            return index;
+        }
+        free_dir_index( index );
+        dir_index_count--;
+        break;
+    }
+    dir_index_misses++;
+
+    /* the directory could still be modified without changing its timestamp, don't cache it yet */
+    if (st.st_mtime >= time( NULL ) - 1) return NULL;
+
+    if (!(index = create_dir_index( unix_name, &st ))) return NULL;
+    TRACE( "indexed %s, %u names (hits %u misses %u)\n", debugstr_a(unix_name),
+           index->count, dir_index_hits, dir_index_misses );
+
+    if (dir_index_count == MAX_DIR_INDEXES)
+    {
+        struct dir_index *lru = LIST_ENTRY( list_tail( &dir_indexes ), struct dir_index, entry );
+        list_remove( &lru->entry );
+        free_dir_index( lru );
+        dir_index_count--;
+    }
+    list_add_head( &dir_indexes, &index->entry );
+    dir_index_count++;
+    return index;
+}
+
+/* look for a file through the index of its directory; return FALSE if the directory can't be indexed */
+static BOOL find_file_in_dir_index( char *unix_name, int pos, const WCHAR *name, int length,
+                                    BOOLEAN is_name_8_dot_3, NTSTATUS *status )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    const struct dir_index_name *entry;
+    struct dir_index *index;
+    unsigned int i, hash;
+    int ret;
+
+    mutex_lock( &dir_index_mutex );
+    if (!(index = get_dir_index( unix_name )))
+    {
+        mutex_unlock( &dir_index_mutex );
+        return FALSE;
+    }
+
+    *status = STATUS_SUCCESS;
+    hash = hash_dir_name( name, length );
+    for (i = index->hash_table[hash & (index->hash_size - 1)]; i != ~0u; i = entry->next)
+    {
+        const char *unix_entry;
+
+        entry = &index->names[i];
+        if (entry->hash != hash) continue;
+        unix_entry = index->buffer + entry->unix_name;
+        ret = ntdll_umbstowcs( unix_entry, strlen(unix_entry), buffer, MAX_DIR_ENTRY_LEN );
+        if (ret == length && !wcsnicmp( buffer, name, ret ))
+        {
+            strcpy( unix_name + pos, unix_entry );
+            goto done;
+        }
+    }
+
+    if (is_name_8_dot_3)
+    {
+        for (i = 0; i < index->count; i++)
+        {
+            const char *unix_entry = index->buffer + index->names[i].unix_name;
+            WCHAR short_nameW[12];
+
+            ret = ntdll_umbstowcs( unix_entry, strlen(unix_entry), buffer, MAX_DIR_ENTRY_LEN );
+            if (is_legal_8dot3_name( buffer, ret )) continue;
+            ret = hash_short_file_name( buffer, ret, short_nameW );
+            if (ret == length && !wcsnicmp( short_nameW, name, length ))
+            {
+                strcpy( unix_name + pos, unix_entry );
+                goto done;
+            }
+        }
+    }
+    *status = STATUS_OBJECT_NAME_NOT_FOUND;
+
+done:
+    mutex_unlock( &dir_index_mutex );
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2707,6 +2934,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     BOOLEAN is_name_8_dot_3;
+    NTSTATUS status;
     DIR *dir;
     struct dirent *de;
     struct stat st;
@@ -2785,6 +3013,13 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    if (find_file_in_dir_index( unix_name, pos, name, length, is_name_8_dot_3, &status ))
+    {
+        if (status) goto not_found;
+        unix_name[pos - 1] = '/';
+        return STATUS_SUCCESS;
+    }
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
     unix_name[pos - 1] = '/';
@@ -5317,6 +5552,251 @@ void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULONG info
     SERVER_END_REQ;
 }
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+/* Overlapped reads and writes of regular files at an explicit offset can
+ * be handed to the kernel through an io_uring instead of being done
+ * synchronously. Completions are reaped by a dedicated thread, which then
+ * fills the I/O status block, signals the event and posts to the
+ * completion port exactly like the synchronous path would have done.
+ * The application may close its handles as soon as the request is pending,
+ * so the request keeps its own duplicates of the ones it needs. */
+
+#define URING_ENTRIES 256
+
+struct uring_io
+{
+    HANDLE        handle;   /* duplicated file handle, for the completion port */
+    HANDLE        event;    /* duplicated event to signal on completion */
+    ULONG_PTR     cvalue;   /* completion port value */
+    client_ptr_t  iosb;     /* I/O status block */
+    struct iovec  iov;      /* user buffer */
+    ULONGLONG     offset;   /* file offset */
+    int           fd;       /* duplicated unix fd, to retry reads that faulted */
+    BOOL          write;    /* whether this is a write request */
+};
+
+static struct
+{
+    int                  fd;
+    unsigned int        *sq_head;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned int         sq_entries;
+    unsigned int         cq_entries;
+    unsigned int         pending;   /* requests submitted but not reaped yet */
+} uring = { -1 };
+
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t uring_once = PTHREAD_ONCE_INIT;
+
+static void free_uring_io( struct uring_io *io )
+{
+    if (io->handle) NtClose( io->handle );
+    if (io->event) NtClose( io->event );
+    if (io->fd != -1) close( io->fd );
+    free( io );
+}
+
+static void complete_uring_io( struct uring_io *io, int res )
+{
+    NTSTATUS status;
+    UINT total = 0;
+
+    /* the kernel doesn't handle guard pages and write watches, do it like the synchronous path */
+    if (res == -EFAULT && !io->write)
+    {
+        res = virtual_locked_pread( io->fd, io->iov.iov_base, io->iov.iov_len, io->offset );
+        if (res == -1) res = -errno;
+    }
+
+    if (res >= 0)
+    {
+        total = res;
+        status = (total || io->write || !io->iov.iov_len) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    else if (res == -EFAULT && io->write) status = STATUS_INVALID_USER_BUFFER;
+    else status = errno_to_status( -res );
+
+    TRACE( "%s of %p done, status %#x total %u\n", io->write ? "write" : "read", io->handle, (int)status, total );
+
+    set_async_iosb( io->iosb, status, total );
+    if (io->event) NtSetEvent( io->event, NULL );
+    if (io->cvalue) add_completion( io->handle, io->cvalue, status, total, TRUE );
+    free_uring_io( io );
+}
+
+static void CALLBACK uring_completion_thread( void *arg )
+{
+    for (;;)
+    {
+        unsigned int head = *uring.cq_head;
+        struct io_uring_cqe *cqe;
+        struct uring_io *io;
+        int res;
+
+        if (head == (unsigned int)ReadAcquire( (LONG *)uring.cq_tail ))
+        {
+            syscall( __NR_io_uring_enter, uring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+            continue;
+        }
+        cqe = &uring.cqes[head & *uring.cq_mask];
+        io = (struct uring_io *)(ULONG_PTR)cqe->user_data;
+        res = cqe->res;
+        WriteRelease( (LONG *)uring.cq_head, head + 1 );
+
+        mutex_lock( &uring_mutex );
+        uring.pending--;
+        mutex_unlock( &uring_mutex );
+
+        complete_uring_io( io, res );
+    }
+}
+
+static void init_uring(void)
+{
+    struct io_uring_params params;
+    const char *env = getenv( "WINEIOURING" );
+    size_t sq_size, cq_size;
+    char *sq_ring, *cq_ring;
+    HANDLE thread;
+    int fd;
+
+    if (!env || !atoi( env )) return;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available, errno %d\n", errno );
+        return;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sq_ring = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    cq_ring = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+    uring.sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || uring.sqes == MAP_FAILED)
+    {
+        WARN( "failed to map the io_uring, errno %d\n", errno );
+        close( fd );
+        return;
+    }
+
+    uring.sq_head    = (unsigned int *)(sq_ring + params.sq_off.head);
+    uring.sq_tail    = (unsigned int *)(sq_ring + params.sq_off.tail);
+    uring.sq_mask    = (unsigned int *)(sq_ring + params.sq_off.ring_mask);
+    uring.sq_array   = (unsigned int *)(sq_ring + params.sq_off.array);
+    uring.cq_head    = (unsigned int *)(cq_ring + params.cq_off.head);
+    uring.cq_tail    = (unsigned int *)(cq_ring + params.cq_off.tail);
+    uring.cq_mask    = (unsigned int *)(cq_ring + params.cq_off.ring_mask);
+    uring.cqes       = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    uring.sq_entries = params.sq_entries;
+    uring.cq_entries = params.cq_entries;
+    uring.fd         = fd;
+
+    if (NtCreateThreadEx( &thread, THREAD_ALL_ACCESS, NULL, GetCurrentProcess(),
+                          uring_completion_thread, NULL, 0, 0, 0, 0, NULL ))
+    {
+        WARN( "failed to create the io_uring completion thread\n" );
+        uring.fd = -1;
+        close( fd );
+        return;
+    }
+    NtClose( thread );
+    TRACE( "using io_uring with %u entries\n", uring.sq_entries );
+}
+
+/* queue an overlapped read or write of a regular file to the io_uring;
+ * return FALSE if the caller should do the I/O synchronously instead */
+static BOOL uring_submit( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue, client_ptr_t iosb,
+                          void *buffer, ULONG length, ULONGLONG offset, BOOL write )
+{
+    struct io_uring_sqe *sqe;
+    struct uring_io *io;
+    unsigned int tail;
+    int ret;
+
+    if (in_wow64_call()) return FALSE;
+    pthread_once( &uring_once, init_uring );
+    if (uring.fd == -1) return FALSE;
+
+    if (!(io = calloc( 1, sizeof(*io) ))) return FALSE;
+    io->cvalue       = cvalue;
+    io->iosb         = iosb;
+    io->iov.iov_base = buffer;
+    io->iov.iov_len  = length;
+    io->offset       = offset;
+    io->fd           = write ? -1 : dup( fd );
+    io->write        = write;
+
+    /* the file handle keeps the completion port of the file alive */
+    if ((!write && io->fd == -1) ||
+        (cvalue && NtDuplicateObject( NtCurrentProcess(), handle, NtCurrentProcess(), &io->handle,
+                                      0, 0, DUPLICATE_SAME_ACCESS )) ||
+        (event && NtDuplicateObject( NtCurrentProcess(), event, NtCurrentProcess(), &io->event,
+                                     0, 0, DUPLICATE_SAME_ACCESS )))
+    {
+        free_uring_io( io );
+        return FALSE;
+    }
+
+    /* the completion thread may signal the event before we return */
+    if (event) NtResetEvent( event, NULL );
+
+    mutex_lock( &uring_mutex );
+    tail = *uring.sq_tail;
+    if (uring.pending >= uring.cq_entries ||
+        tail - ReadAcquire( (LONG *)uring.sq_head ) >= uring.sq_entries)
+    {
+        mutex_unlock( &uring_mutex );
+        free_uring_io( io );
+        return FALSE;
+    }
+
+    sqe = &uring.sqes[tail & *uring.sq_mask];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode    = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd        = fd;
+    sqe->off       = offset;
+    sqe->addr      = (ULONG_PTR)&io->iov;
+    sqe->len       = 1;
+    sqe->user_data = (ULONG_PTR)io;
+    uring.sq_array[tail & *uring.sq_mask] = tail & *uring.sq_mask;
+    WriteRelease( (LONG *)uring.sq_tail, tail + 1 );
+
+    /* the kernel takes its own reference to the file, so the fd can be closed once this returns */
+    while ((ret = syscall( __NR_io_uring_enter, uring.fd, 1, 0, 0, NULL, 0 )) == -1 && errno == EINTR);
+    if (ret != 1)
+    {
+        WARN( "io_uring submission failed, errno %d\n", errno );
+        WriteRelease( (LONG *)uring.sq_tail, tail );
+        mutex_unlock( &uring_mutex );
+        free_uring_io( io );
+        return FALSE;
+    }
+    uring.pending++;
+    mutex_unlock( &uring_mutex );
+    return TRUE;
+}
+
+#else
+
+static BOOL uring_submit( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue, client_ptr_t iosb,
+                          void *buffer, ULONG length, ULONGLONG offset, BOOL write )
+{
+    return FALSE;
+}
+
+#endif
+
 static unsigned int set_pending_write( HANDLE device )
 {
     unsigned int status;
@@ -5374,6 +5854,13 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
+            if (async_read && !apc && length &&
+                uring_submit( handle, unix_handle, event, cvalue, iosb_ptr, buffer, length, offset->QuadPart, FALSE ))
+            {
+                if (needs_close) close( unix_handle );
+                return STATUS_PENDING;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = virtual_locked_pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
@@ -5691,6 +6178,14 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
                 goto done;
             }
 
+            if (async_write && !apc && length && !append_write &&
+                offset->QuadPart != FILE_WRITE_TO_END_OF_FILE &&
+                uring_submit( handle, unix_handle, event, cvalue, iosb_ptr, (void *)buffer, length, off, TRUE ))
+            {
+                if (needs_close) close( unix_handle );
+                return STATUS_PENDING;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
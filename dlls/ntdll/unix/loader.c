@@ -135,11 +135,13 @@ static void * const syscalls[] =
     NtAllocateVirtualMemoryEx,
     NtAreMappedFilesTheSame,
     NtAssignProcessToJobObject,
+    NtAssociateWaitCompletionPacket,
     NtCallbackReturn,
     NtCancelIoFile,
     NtCancelIoFileEx,
     NtCancelSynchronousIoFile,
     NtCancelTimer,
+    NtCancelWaitCompletionPacket,
     NtClearEvent,
     NtClose,
     NtCommitTransaction,
@@ -170,6 +172,7 @@ static void * const syscalls[] =
     NtCreateTimer,
     NtCreateTransaction,
     NtCreateUserProcess,
+    NtCreateWaitCompletionPacket,
     NtDebugActiveProcess,
     NtDebugContinue,
     NtDelayExecution,
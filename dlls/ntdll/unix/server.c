@@ -37,6 +37,7 @@
 #ifdef HAVE_PWD_H
 # include <pwd.h>
 #endif
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -177,6 +178,69 @@ static DECLSPEC_NORETURN void server_protocol_perror( const char *err )
 }
 
 
+#ifdef __linux__
+
+#define FUTEX_WAIT 0
+
+static inline int request_shm_futex_wait( int *addr, int val, struct timespec *timeout )
+{
+#if (defined(__i386__) || defined(__arm__)) && _TIME_BITS==64
+    if (timeout && sizeof(*timeout) != 8)
+    {
+        struct {
+            long tv_sec;
+            long tv_nsec;
+        } timeout32 = { timeout->tv_sec, timeout->tv_nsec };
+
+        return syscall( __NR_futex, addr, FUTEX_WAIT, val, &timeout32, 0, 0 );
+    }
+#endif
+    return syscall( __NR_futex, addr, FUTEX_WAIT, val, timeout, 0, 0 );
+}
+
+/***********************************************************************
+ *           wait_shm_reply
+ *
+ * Wait for a reply sent through the shared memory; helper for wait_reply.
+ */
+static unsigned int wait_shm_reply( struct request_shm *shm, struct __server_request_info *req )
+{
+    union generic_reply *reply = (union generic_reply *)(shm + 1);
+    struct timespec timeout = { 1, 0 };
+    struct pollfd pfd;
+    int i, state;
+
+    /* short requests are usually answered before we would get to sleep */
+    for (i = 0; i < 200; i++)
+    {
+        if (ReadAcquire( (LONG *)&shm->state ) == REQUEST_SHM_REPLY) goto done;
+        YieldProcessor();
+    }
+
+    while ((state = InterlockedCompareExchange( (LONG *)&shm->state, REQUEST_SHM_WAITING,
+                                                REQUEST_SHM_PENDING )) != REQUEST_SHM_REPLY)
+    {
+        if (state == REQUEST_SHM_CLOSED) abort_thread(0);
+        if (!request_shm_futex_wait( &shm->state, REQUEST_SHM_WAITING, &timeout ) ||
+            errno != ETIMEDOUT) continue;
+
+        /* make sure the server is still there */
+        pfd.fd = ntdll_get_thread_data()->reply_fd;
+        pfd.events = POLLIN;
+        if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR))) abort_thread(0);
+    }
+
+done:
+    req->u.reply = *reply;
+    if (reply->reply_header.reply_size)
+        memcpy( req->reply_data, reply + 1, reply->reply_header.reply_size );
+    shm->state = REQUEST_SHM_IDLE;
+    return req->u.reply.reply_header.error;
+}
+
+#endif  /* __linux__ */
+
+
 /***********************************************************************
  *           send_request
  *
@@ -184,9 +248,13 @@ static DECLSPEC_NORETURN void server_protocol_perror( const char *err )
  */
 static unsigned int send_request( const struct __server_request_info *req )
 {
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
     unsigned int i;
     int ret;
 
+    /* ask for the reply to be sent through the shared memory if it fits */
+    if (shm && req->u.req.request_header.reply_size <= shm->size) shm->state = REQUEST_SHM_PENDING;
+
     if (!req->u.req.request_header.request_size)
     {
         if ((ret = write( ntdll_get_thread_data()->request_fd, &req->u.req,
@@ -210,7 +278,11 @@ static unsigned int send_request( const struct __server_request_info *req )
 
     if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
     if (errno == EPIPE) abort_thread(0);
-    if (errno == EFAULT) return STATUS_ACCESS_VIOLATION;
+    if (errno == EFAULT)
+    {
+        if (shm) shm->state = REQUEST_SHM_IDLE;
+        return STATUS_ACCESS_VIOLATION;
+    }
     server_protocol_perror( "write" );
 }
 
@@ -249,6 +321,11 @@ static void read_reply_data( void *buffer, size_t size )
  */
 static inline unsigned int wait_reply( struct __server_request_info *req )
 {
+#ifdef __linux__
+    struct request_shm *shm = ntdll_get_thread_data()->request_shm;
+
+    if (shm && shm->state != REQUEST_SHM_IDLE) return wait_shm_reply( shm, req );
+#endif
     read_reply_data( &req->u.reply, sizeof(req->u.reply) );
     if (req->u.reply.reply_header.reply_size)
         read_reply_data( req->reply_data, req->u.reply.reply_header.reply_size );
@@ -926,6 +1003,11 @@ C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
 
 static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
 static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
+static unsigned int *fd_cache_generation[FD_CACHE_ENTRIES];
+static unsigned int fd_cache_initial_generation[FD_CACHE_BLOCK_SIZE];
+
+static const struct handle_shm_entry *handle_shm;  /* handle table mirrored by the server */
+static unsigned int handle_shm_count;
 
 static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 {
@@ -935,13 +1017,44 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 }
 
 
+/***********************************************************************
+ *           get_handle_generation
+ *
+ * Get the generation of a handle from the handle table mirrored by the server.
+ * It is odd if the handle is in use, and changes every time the handle is closed.
+ */
+static inline BOOL get_handle_generation( HANDLE handle, unsigned int *generation )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+
+    if (!handle_shm || idx >= handle_shm_count) return FALSE;
+    *generation = ReadAcquire( (LONG *)&handle_shm[idx].generation );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           is_handle_closed
+ *
+ * Check if a handle is known to be invalid without asking the server. This is
+ * only possible when the server mirrors the handle table, otherwise the
+ * server has to be asked.
+ */
+static inline BOOL is_handle_closed( HANDLE handle )
+{
+    unsigned int generation;
+
+    return get_handle_generation( handle, &generation ) && !(generation & 1);
+}
+
+
 /***********************************************************************
  *           add_fd_to_cache
  *
  * Caller must hold fd_cache_mutex.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
-                            unsigned int access, unsigned int options )
+                            unsigned int access, unsigned int options, unsigned int generation )
 {
     unsigned int entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
@@ -954,12 +1067,17 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 
     if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
     {
-        if (!entry) fd_cache[0] = fd_cache_initial_block;
+        if (!entry)
+        {
+            fd_cache_generation[0] = fd_cache_initial_generation;
+            fd_cache[0] = fd_cache_initial_block;
+        }
         else
         {
-            void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
+            void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * (sizeof(union fd_cache_entry) + sizeof(unsigned int)),
                                          PROT_READ | PROT_WRITE );
             if (ptr == MAP_FAILED) return FALSE;
+            fd_cache_generation[entry] = (unsigned int *)((union fd_cache_entry *)ptr + FD_CACHE_BLOCK_SIZE);
             fd_cache[entry] = ptr;
         }
     }
@@ -969,6 +1087,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    fd_cache_generation[entry][idx] = generation;
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
     assert( !cache.s.fd );
     return TRUE;
@@ -981,7 +1100,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_type *type,
                                       unsigned int *access, unsigned int *options )
 {
-    unsigned int entry, idx = handle_to_index( handle, &entry );
+    unsigned int generation, entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
 
     if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return STATUS_INVALID_HANDLE;
@@ -989,6 +1108,10 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
     cache.data = InterlockedCompareExchange64( &fd_cache[entry][idx].data, 0, 0 );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
+    /* the handle may have been closed by another process */
+    if (get_handle_generation( handle, &generation ) && generation != fd_cache_generation[entry][idx])
+        return STATUS_INVALID_HANDLE;
+
     /* if fd type is invalid, fd stores an error value */
     if (cache.s.type == FD_TYPE_INVALID) return cache.s.fd - 1;
 
@@ -1030,7 +1153,7 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     sigset_t sigset;
     obj_handle_t fd_handle;
     int ret, fd = -1;
-    unsigned int access = 0;
+    unsigned int access = 0, generation = 0;
 
     *unix_fd = -1;
     *needs_close = 0;
@@ -1043,29 +1166,37 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     ret = get_cached_fd( handle, &fd, type, &access, options );
     if (ret == STATUS_INVALID_HANDLE)
     {
-        SERVER_START_REQ( get_handle_fd )
+        /* drop the entry of a handle that was closed behind our back */
+        if ((fd = remove_fd_from_cache( handle )) != -1) close( fd );
+        fd = -1;
+
+        /* no need to ask the server about a handle that is known to be closed */
+        if (!get_handle_generation( handle, &generation ) || (generation & 1))
         {
-            req->handle = wine_server_obj_handle( handle );
-            if (!(ret = wine_server_call( req )))
+            SERVER_START_REQ( get_handle_fd )
             {
-                if (type) *type = reply->type;
-                if (options) *options = reply->options;
-                access = reply->access;
-                if ((fd = receive_fd( &fd_handle )) != -1)
+                req->handle = wine_server_obj_handle( handle );
+                if (!(ret = wine_server_call( req )))
                 {
-                    assert( wine_server_ptr_handle(fd_handle) == handle );
-                    *needs_close = (!reply->cacheable ||
-                                    !add_fd_to_cache( handle, fd, reply->type,
-                                                      reply->access, reply->options ));
+                    if (type) *type = reply->type;
+                    if (options) *options = reply->options;
+                    access = reply->access;
+                    if ((fd = receive_fd( &fd_handle )) != -1)
+                    {
+                        assert( wine_server_ptr_handle(fd_handle) == handle );
+                        *needs_close = (!reply->cacheable ||
+                                        !add_fd_to_cache( handle, fd, reply->type,
+                                                          reply->access, reply->options, generation ));
+                    }
+                    else ret = STATUS_TOO_MANY_OPENED_FILES;
+                }
+                else if (reply->cacheable)
+                {
+                    add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0, generation );
                 }
-                else ret = STATUS_TOO_MANY_OPENED_FILES;
-            }
-            else if (reply->cacheable)
-            {
-                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0 );
             }
+            SERVER_END_REQ;
         }
-        SERVER_END_REQ;
     }
     server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
 
@@ -1080,6 +1211,192 @@ done:
 }
 
 
+/***********************************************************************/
+/* fast synchronization support */
+
+union fast_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index : 24;   /* slot index + 1, or 0 if the object has no slot */
+        unsigned int access : 3;   /* query, modify and synchronize access */
+        unsigned int valid : 1;    /* entry is valid */
+        unsigned int serial;       /* slot serial number */
+    } s;
+};
+
+C_ASSERT( sizeof(union fast_sync_cache_entry) == sizeof(LONG64) );
+
+static union fast_sync_cache_entry *fast_sync_cache[FD_CACHE_ENTRIES];
+static unsigned int *fast_sync_cache_generation[FD_CACHE_ENTRIES];
+static struct fast_sync_slot *fast_sync_slots;  /* slots of the objects created by this process */
+static unsigned int fast_sync_count;
+
+/* the query and modify access rights are the same for events and semaphores */
+static inline unsigned int fast_sync_access( ACCESS_MASK access )
+{
+    return (access & (EVENT_QUERY_STATE | EVENT_MODIFY_STATE)) | ((access & SYNCHRONIZE) ? 4 : 0);
+}
+
+/***********************************************************************
+ *           init_fast_sync
+ *
+ * Map the slots of the objects created by the process. They are only
+ * available when the server was started with WINEFASTSYNC set.
+ */
+static void init_fast_sync(void)
+{
+    obj_handle_t handle;
+    unsigned int count = 0;
+    sigset_t sigset;
+    void *ptr;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    SERVER_START_REQ( get_fast_sync_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            count = reply->count;
+            fd = receive_fd( &handle );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+
+    if (fd != -1)
+    {
+        ptr = mmap( NULL, count * sizeof(*fast_sync_slots), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        close( fd );
+        if (ptr != MAP_FAILED)
+        {
+            fast_sync_count = count;
+            fast_sync_slots = ptr;
+        }
+    }
+    TRACE( "fast synchronization %s\n", fast_sync_slots ? "enabled" : "unavailable" );
+}
+
+
+/***********************************************************************
+ *           add_fast_sync_to_cache
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static void add_fast_sync_to_cache( HANDLE handle, union fast_sync_cache_entry cache, unsigned int generation )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry >= FD_CACHE_ENTRIES) return;
+    if (!fast_sync_cache[entry])
+    {
+        void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE *
+                                     (sizeof(union fast_sync_cache_entry) + sizeof(unsigned int)),
+                                     PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return;
+        fast_sync_cache_generation[entry] = (unsigned int *)((union fast_sync_cache_entry *)ptr + FD_CACHE_BLOCK_SIZE);
+        fast_sync_cache[entry] = ptr;
+    }
+    fast_sync_cache_generation[entry][idx] = generation;
+    interlocked_xchg64( &fast_sync_cache[entry][idx].data, cache.data );
+}
+
+
+/***********************************************************************
+ *           remove_fast_sync_from_cache
+ */
+static void remove_fast_sync_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry < FD_CACHE_ENTRIES && fast_sync_cache[entry])
+        interlocked_xchg64( &fast_sync_cache[entry][idx].data, 0 );
+}
+
+
+/***********************************************************************
+ *           get_fast_sync_slot
+ *
+ * Return the shared memory slot of an event, semaphore or socket if the
+ * handle grants the requested access, NULL if the server must be used
+ * instead. The serial number must be checked again when using the slot.
+ */
+struct fast_sync_slot *get_fast_sync_slot( HANDLE handle, ACCESS_MASK access, unsigned int *serial )
+{
+    unsigned int generation = 0, entry, idx = handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache;
+    struct fast_sync_slot *slot;
+    sigset_t sigset;
+
+    if (!fast_sync_slots || entry >= FD_CACHE_ENTRIES) return NULL;
+
+    cache.data = fast_sync_cache[entry] ? InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, 0, 0 ) : 0;
+
+    /* the handle may have been closed and reused behind our back, e.g. by another process */
+    if (cache.data && get_handle_generation( handle, &generation ) &&
+        generation != fast_sync_cache_generation[entry][idx])
+        cache.data = 0;
+
+    if (!cache.data)
+    {
+        /* no need to ask the server about a handle that is known to be closed */
+        if (get_handle_generation( handle, &generation ) && !(generation & 1)) return NULL;
+
+        server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+        SERVER_START_REQ( get_fast_sync_slot )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            switch (wine_server_call( req ))
+            {
+            case STATUS_SUCCESS:
+                cache.s.index  = reply->index + 1;
+                cache.s.access = fast_sync_access( reply->access );
+                cache.s.serial = reply->serial;
+                cache.s.valid  = 1;
+                add_fast_sync_to_cache( handle, cache, generation );
+                break;
+            case STATUS_NOT_IMPLEMENTED:  /* remember that the object has no slot */
+                cache.s.valid = 1;
+                add_fast_sync_to_cache( handle, cache, generation );
+                break;
+            }
+        }
+        SERVER_END_REQ;
+        server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    }
+
+    if (!cache.s.index || cache.s.index > fast_sync_count) return NULL;
+    if ((cache.s.access & fast_sync_access( access )) != fast_sync_access( access )) return NULL;
+    slot = &fast_sync_slots[cache.s.index - 1];
+    if (ReadNoFence( (LONG *)&slot->serial ) != cache.s.serial)
+    {
+        /* the handle was closed behind our back, e.g. by another process */
+        remove_fast_sync_from_cache( handle );
+        return NULL;
+    }
+    *serial = cache.s.serial;
+    return slot;
+}
+
+
+/***********************************************************************
+ *           fast_sync_wake
+ *
+ * Wake up the threads that started waiting in the server while we were
+ * raising the object state.
+ */
+void fast_sync_wake( HANDLE handle )
+{
+    SERVER_START_REQ( fast_sync_wake )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle
  */
@@ -1460,6 +1777,79 @@ static int init_thread_pipe(void)
 }
 
 
+/***********************************************************************
+ *           init_request_shm
+ *
+ * Map the shared memory used by the server to send the replies to the current thread.
+ */
+static void init_request_shm(void)
+{
+#ifdef __linux__
+    obj_handle_t handle;
+    data_size_t size = 0;
+    sigset_t sigset;
+    void *ptr;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    SERVER_START_REQ( get_request_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &handle );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+
+    if (fd == -1) return;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr != MAP_FAILED) ntdll_get_thread_data()->request_shm = ptr;
+#endif
+}
+
+
+/***********************************************************************
+ *           init_handle_shm
+ *
+ * Map the shared memory mirroring the handle table of the process.
+ */
+static void init_handle_shm(void)
+{
+    obj_handle_t handle;
+    unsigned int count = 0;
+    sigset_t sigset;
+    void *ptr;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    SERVER_START_REQ( get_handle_table_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            count = reply->count;
+            fd = receive_fd( &handle );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+
+    if (fd != -1)
+    {
+        ptr = mmap( NULL, count * sizeof(*handle_shm), PROT_READ, MAP_SHARED, fd, 0 );
+        close( fd );
+        if (ptr != MAP_FAILED)
+        {
+            handle_shm_count = count;
+            handle_shm = ptr;
+        }
+    }
+    TRACE( "shared handle table %s\n", handle_shm ? "enabled" : "unavailable" );
+}
+
+
 /***********************************************************************
  *           process_exit_wrapper
  *
@@ -1568,6 +1958,9 @@ size_t server_init_process(void)
     close( reply_pipe );
 
     if (ret) server_protocol_error( "init_first_thread failed with status %x\n", ret );
+    init_request_shm();
+    init_handle_shm();
+    init_fast_sync();
 
     if (!supported_machines_count)
         fatal_error( "'%s' is a 64-bit installation, it cannot be used with a 32-bit wineserver.\n",
@@ -1674,6 +2067,7 @@ void server_init_thread( void *entry_point, BOOL *suspend )
     }
     SERVER_END_REQ;
     close( reply_pipe );
+    init_request_shm();
 }
 
 
@@ -1715,7 +2109,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        remove_fast_sync_from_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1776,13 +2173,18 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    remove_fast_sync_from_cache( handle );
 
-    SERVER_START_REQ( close_handle )
+    if (is_handle_closed( handle )) ret = STATUS_INVALID_HANDLE;
+    else
     {
-        req->handle = wine_server_obj_handle( handle );
-        ret = wine_server_call( req );
+        SERVER_START_REQ( close_handle )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            ret = wine_server_call( req );
+        }
+        SERVER_END_REQ;
     }
-    SERVER_END_REQ;
 
     server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
 
@@ -25,6 +25,7 @@
 #include "config.h"
 #include <assert.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
@@ -849,6 +850,18 @@ static BOOL is_icmp_over_dgram( int fd )
 #endif
 }
 
+/* check if a request that succeeds immediately may be completed without telling the server */
+static BOOL sock_can_complete_locally( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, unsigned int flag )
+{
+    struct fast_sync_slot *slot;
+    unsigned int serial;
+    int flags;
+
+    if (event || apc) return FALSE;
+    if (!(slot = get_fast_sync_slot( handle, 0, &serial )) || slot->type != FAST_SYNC_SOCKET) return FALSE;
+    return fast_sync_read( slot, serial, &flags ) && (flags & flag);
+}
+
 static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
                            int fd, struct async_recv_ioctl *async, int force_async )
 {
@@ -866,6 +879,24 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
+    if (!(async->unix_flags & MSG_OOB) && !async->icmp_over_dgram &&
+        sock_can_complete_locally( handle, event, apc, FAST_SYNC_SOCKET_RECV ))
+    {
+        ULONG_PTR information;
+
+        /* if no data is available, nothing was consumed and the server can take over */
+        if ((status = try_recv( fd, async, &information )) != STATUS_DEVICE_NOT_READY)
+        {
+            if (!NT_ERROR(status))
+            {
+                io->Status = status;
+                io->Information = information;
+            }
+            release_fileio( &async->io );
+            return status;
+        }
+    }
+
     SERVER_START_REQ( recv_socket )
     {
         req->force_async = force_async;
@@ -1103,6 +1134,21 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
     unsigned int status;
     ULONG options;
 
+    if (sock_can_complete_locally( handle, event, apc, FAST_SYNC_SOCKET_SEND ))
+    {
+        /* on a short write, the server takes over the rest of the buffers */
+        if ((status = try_send( fd, async )) != STATUS_DEVICE_NOT_READY)
+        {
+            if (!NT_ERROR(status))
+            {
+                io->Status = status;
+                io->Information = async->sent_len;
+            }
+            release_fileio( &async->io );
+            return status;
+        }
+    }
+
     SERVER_START_REQ( send_socket )
     {
         req->force_async = force_async;
@@ -1485,6 +1531,193 @@ static int get_sock_type( HANDLE handle )
 }
 
 
+#define MAX_LOCAL_POLL_SOCKETS 64
+
+/* compute the AFD poll flags of a socket from the unix poll results, like the server does */
+static int get_local_poll_flags( int fd, unsigned int sock_flags, short revents )
+{
+    int flags = 0;
+
+    /* hangups and errors update the socket state, let the server handle them */
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) return -1;
+
+    if (revents & POLLIN)
+    {
+        if (sock_flags & FAST_SYNC_SOCKET_LISTENING)
+            flags |= AFD_POLL_ACCEPT;
+        else
+        {
+            if (sock_flags & FAST_SYNC_SOCKET_STREAM)
+            {
+                char dummy;
+
+                /* a graceful or abortive close is only reported as POLLIN */
+                if (recv( fd, &dummy, 1, MSG_PEEK ) <= 0) return -1;
+            }
+            flags |= AFD_POLL_READ;
+        }
+    }
+    /* only requested when out-of-band data is not inline */
+    if (revents & POLLPRI)
+        flags |= AFD_POLL_OOB;
+    if (revents & POLLOUT)
+        flags |= AFD_POLL_WRITE;
+    if (sock_flags & FAST_SYNC_SOCKET_CONNECTED)
+        flags |= AFD_POLL_CONNECT;
+    return flags;
+}
+
+/* Try to complete a poll in the client with poll(2) on the unix fds.
+ * This is only done when the poll doesn't have to wait, i.e. a socket
+ * is already signaled or the timeout is zero, and the server reports
+ * that the poll results of all the sockets only depend on their fd.
+ * Everything else, including exclusive polls, is left to the server. */
+static NTSTATUS sock_poll_locally( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                                   IO_STATUS_BLOCK *io, const void *in_buffer, UINT in_size,
+                                   void *out_buffer, UINT out_size )
+{
+    struct pollfd pollfds[MAX_LOCAL_POLL_SOCKETS];
+    unsigned int sock_flags[MAX_LOCAL_POLL_SOCKETS];
+    int masks[MAX_LOCAL_POLL_SOCKETS], results[MAX_LOCAL_POLL_SOCKETS];
+    HANDLE handles[MAX_LOCAL_POLL_SOCKETS];
+    BOOL close_fds[MAX_LOCAL_POLL_SOCKETS];
+    struct fast_sync_slot *slot;
+    unsigned int i, count, serial, signaled = 0;
+    int flags;
+    NTSTATUS status = STATUS_BAD_DEVICE_TYPE;
+    LONGLONG timeout;
+    ULONG size;
+
+    if (apc || apc_user) return STATUS_BAD_DEVICE_TYPE;
+
+    /* the completion port of the polling socket has to receive the result */
+    if (!(slot = get_fast_sync_slot( handle, 0, &serial )) || slot->type != FAST_SYNC_SOCKET)
+        return STATUS_BAD_DEVICE_TYPE;
+    if (!fast_sync_read( slot, serial, &flags ) || (flags & FAST_SYNC_SOCKET_COMPLETION))
+        return STATUS_BAD_DEVICE_TYPE;
+
+    if (in_wow64_call())
+    {
+        const struct afd_poll_params_32 *params = in_buffer;
+
+        if (in_size < sizeof(*params) || params->exclusive) return STATUS_BAD_DEVICE_TYPE;
+        count = params->count;
+        if (!count || count > MAX_LOCAL_POLL_SOCKETS) return STATUS_BAD_DEVICE_TYPE;
+        if (in_size < offsetof( struct afd_poll_params_32, sockets[count] ) || out_size < in_size)
+            return STATUS_BAD_DEVICE_TYPE;
+        timeout = params->timeout;
+        for (i = 0; i < count; ++i)
+        {
+            handles[i] = ULongToHandle( params->sockets[i].socket );
+            masks[i] = params->sockets[i].flags;
+        }
+    }
+    else
+    {
+        const struct afd_poll_params_64 *params = in_buffer;
+
+        if (in_size < sizeof(*params) || params->exclusive) return STATUS_BAD_DEVICE_TYPE;
+        count = params->count;
+        if (!count || count > MAX_LOCAL_POLL_SOCKETS) return STATUS_BAD_DEVICE_TYPE;
+        if (in_size < offsetof( struct afd_poll_params_64, sockets[count] ) || out_size < in_size)
+            return STATUS_BAD_DEVICE_TYPE;
+        timeout = params->timeout;
+        for (i = 0; i < count; ++i)
+        {
+            handles[i] = wine_server_ptr_handle( params->sockets[i].socket );
+            masks[i] = params->sockets[i].flags;
+        }
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        close_fds[i] = FALSE;
+        pollfds[i].fd = -1;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        int fd, needs_close;
+
+        if (!(slot = get_fast_sync_slot( handles[i], 0, &serial )) || slot->type != FAST_SYNC_SOCKET) goto done;
+        if (!fast_sync_read( slot, serial, &flags )) goto done;
+        sock_flags[i] = flags;
+        if (!(sock_flags[i] & FAST_SYNC_SOCKET_POLL)) goto done;
+        if (server_get_unix_fd( handles[i], 0, &fd, &needs_close, NULL, NULL )) goto done;
+        pollfds[i].fd = fd;
+        close_fds[i] = needs_close;
+
+        pollfds[i].events = 0;
+        if (masks[i] & (AFD_POLL_READ | AFD_POLL_ACCEPT))
+            pollfds[i].events |= POLLIN;
+        if ((masks[i] & AFD_POLL_HUP) && (sock_flags[i] & FAST_SYNC_SOCKET_STREAM))
+            pollfds[i].events |= POLLIN;
+        if (masks[i] & AFD_POLL_OOB)
+        {
+            int oobinline = 0;
+            socklen_t len = sizeof(oobinline);
+
+            getsockopt( fd, SOL_SOCKET, SO_OOBINLINE, (char *)&oobinline, &len );
+            pollfds[i].events |= oobinline ? POLLIN : POLLPRI;
+        }
+        if (masks[i] & AFD_POLL_WRITE)
+            pollfds[i].events |= POLLOUT;
+    }
+
+    if (poll( pollfds, count, 0 ) < 0) goto done;
+
+    for (i = 0; i < count; ++i)
+    {
+        if ((results[i] = get_local_poll_flags( pollfds[i].fd, sock_flags[i], pollfds[i].revents )) < 0)
+            goto done;
+        if ((results[i] &= masks[i])) ++signaled;
+    }
+    if (!signaled && timeout) goto done;
+
+    if (in_wow64_call())
+    {
+        struct afd_poll_params_32 *output = out_buffer;
+
+        size = offsetof( struct afd_poll_params_32, sockets[signaled] );
+        memset( output, 0, size );
+        output->timeout = timeout;
+        for (i = 0; i < count; ++i)
+        {
+            if (!results[i]) continue;
+            output->sockets[output->count].socket = HandleToULong( handles[i] );
+            output->sockets[output->count].flags = results[i];
+            output->sockets[output->count].status = STATUS_SUCCESS;
+            ++output->count;
+        }
+    }
+    else
+    {
+        struct afd_poll_params_64 *output = out_buffer;
+
+        size = offsetof( struct afd_poll_params_64, sockets[signaled] );
+        memset( output, 0, size );
+        output->timeout = timeout;
+        for (i = 0; i < count; ++i)
+        {
+            if (!results[i]) continue;
+            output->sockets[output->count].socket = wine_server_obj_handle( handles[i] );
+            output->sockets[output->count].flags = results[i];
+            output->sockets[output->count].status = STATUS_SUCCESS;
+            ++output->count;
+        }
+    }
+
+    status = STATUS_SUCCESS;
+    io->Status = status;
+    io->Information = size;
+    if (event) NtSetEvent( event, NULL );
+
+done:
+    for (i = 0; i < count; ++i)
+        if (close_fds[i]) close( pollfds[i].fd );
+    return status;
+}
+
 NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
                      UINT code, void *in_buffer, UINT in_size, void *out_buffer, UINT out_size )
 {
@@ -1543,7 +1776,7 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
             break;
 
         case IOCTL_AFD_POLL:
-            status = STATUS_BAD_DEVICE_TYPE;
+            status = sock_poll_locally( handle, event, apc, apc_user, io, in_buffer, in_size, out_buffer, out_size );
             break;
 
         case IOCTL_AFD_RECV:
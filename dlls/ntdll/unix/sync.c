@@ -150,6 +150,117 @@ static inline int use_futexes(void)
 #endif
 
 
+/* fast synchronization path, see server/fast_sync.c
+ *
+ * The state of the events and semaphores created by the process is read and
+ * raised directly in shared memory; waking up and satisfying waiters is
+ * always left to the server. A slot reused behind our back makes the state
+ * updates fail, and the server is used instead. */
+
+static inline BOOL is_fast_sync_event( const struct fast_sync_slot *slot )
+{
+    return slot->type == FAST_SYNC_AUTO_EVENT || slot->type == FAST_SYNC_MANUAL_EVENT;
+}
+
+static inline LONG fast_sync_waiters( struct fast_sync_slot *slot )
+{
+    return InterlockedCompareExchange( (LONG *)&slot->waiters, 0, 0 );
+}
+
+static NTSTATUS fast_sync_set_event( HANDLE handle, LONG *prev_state )
+{
+    unsigned int serial;
+    struct fast_sync_slot *slot = get_fast_sync_slot( handle, EVENT_MODIFY_STATE, &serial );
+    int prev;
+
+    if (!slot || !is_fast_sync_event( slot )) return STATUS_NOT_IMPLEMENTED;
+    /* let the server wake up the threads already waiting */
+    if (fast_sync_waiters( slot )) return STATUS_NOT_IMPLEMENTED;
+    do
+    {
+        if (!fast_sync_read( slot, serial, &prev )) return STATUS_NOT_IMPLEMENTED;
+    } while (!fast_sync_cmpxchg( slot, serial, prev, 1 ));
+    if (!prev && fast_sync_waiters( slot )) fast_sync_wake( handle );
+    if (prev_state) *prev_state = prev;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_sync_reset_event( HANDLE handle, LONG *prev_state )
+{
+    unsigned int serial;
+    struct fast_sync_slot *slot = get_fast_sync_slot( handle, EVENT_MODIFY_STATE, &serial );
+    int prev;
+
+    if (!slot || !is_fast_sync_event( slot )) return STATUS_NOT_IMPLEMENTED;
+    do
+    {
+        if (!fast_sync_read( slot, serial, &prev )) return STATUS_NOT_IMPLEMENTED;
+    } while (!fast_sync_cmpxchg( slot, serial, prev, 0 ));
+    if (prev_state) *prev_state = prev;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_sync_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    unsigned int serial;
+    struct fast_sync_slot *slot = get_fast_sync_slot( handle, EVENT_QUERY_STATE, &serial );
+    int state;
+
+    if (!slot || !is_fast_sync_event( slot )) return STATUS_NOT_IMPLEMENTED;
+    info->EventType = slot->type == FAST_SYNC_MANUAL_EVENT ? NotificationEvent : SynchronizationEvent;
+    if (!fast_sync_read( slot, serial, &state )) return STATUS_NOT_IMPLEMENTED;
+    info->EventState = state;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_sync_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    unsigned int serial;
+    struct fast_sync_slot *slot = get_fast_sync_slot( handle, SEMAPHORE_MODIFY_STATE, &serial );
+    ULONG max;
+    int prev;
+
+    if (!slot || slot->type != FAST_SYNC_SEMAPHORE) return STATUS_NOT_IMPLEMENTED;
+    if (fast_sync_waiters( slot )) return STATUS_NOT_IMPLEMENTED;
+    max = ReadNoFence( (LONG *)&slot->max );
+    do
+    {
+        if (!fast_sync_read( slot, serial, &prev )) return STATUS_NOT_IMPLEMENTED;
+        if ((ULONG)prev + count < (ULONG)prev || (ULONG)prev + count > max) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (!fast_sync_cmpxchg( slot, serial, prev, prev + count ));
+    if (!prev && fast_sync_waiters( slot )) fast_sync_wake( handle );
+    if (previous) *previous = prev;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_sync_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    unsigned int serial;
+    struct fast_sync_slot *slot = get_fast_sync_slot( handle, SEMAPHORE_QUERY_STATE, &serial );
+    int count;
+
+    if (!slot || slot->type != FAST_SYNC_SEMAPHORE) return STATUS_NOT_IMPLEMENTED;
+    info->MaximumCount = ReadNoFence( (LONG *)&slot->max );
+    if (!fast_sync_read( slot, serial, &count )) return STATUS_NOT_IMPLEMENTED;
+    info->CurrentCount = count;
+    return STATUS_SUCCESS;
+}
+
+/* a signaled manual-reset event can be waited on without consuming anything */
+static NTSTATUS fast_sync_wait( HANDLE handle, BOOLEAN alertable )
+{
+    struct fast_sync_slot *slot;
+    unsigned int serial;
+    int state;
+
+    if (alertable) return STATUS_NOT_IMPLEMENTED;
+    if (!(slot = get_fast_sync_slot( handle, SYNCHRONIZE, &serial ))) return STATUS_NOT_IMPLEMENTED;
+    if (slot->type != FAST_SYNC_MANUAL_EVENT) return STATUS_NOT_IMPLEMENTED;
+    if (!fast_sync_read( slot, serial, &state ) || !state) return STATUS_NOT_IMPLEMENTED;
+    return STATUS_WAIT_0;
+}
+
+
 /* create a struct security_descriptor and contained information in one contiguous piece of memory */
 unsigned int alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                       data_size_t *ret_len )
@@ -333,6 +444,12 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 
     if (len != sizeof(SEMAPHORE_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = fast_sync_query_semaphore( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(SEMAPHORE_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -355,6 +472,9 @@ NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, ULONG *previous
 {
     unsigned int ret;
 
+    if ((ret = fast_sync_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -431,6 +551,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     unsigned int ret;
 
+    if ((ret = fast_sync_set_event( handle, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -450,6 +572,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     unsigned int ret;
 
+    if ((ret = fast_sync_reset_event( handle, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -510,6 +634,12 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 
     if (len != sizeof(EVENT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = fast_sync_query_event( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(EVENT_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_event )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1433,6 +1563,9 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles, BO
  */
 NTSTATUS WINAPI NtWaitForSingleObject( HANDLE handle, BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
+    unsigned int ret;
+
+    if ((ret = fast_sync_wait( handle, alertable )) != STATUS_NOT_IMPLEMENTED) return ret;
     return NtWaitForMultipleObjects( 1, &handle, FALSE, alertable, timeout );
 }
 
@@ -1864,8 +1997,9 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_entry entries[64];
     unsigned int status;
-    ULONG i = 0;
+    ULONG i = 0, j, size, ret;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, (int)count, written, timeout, alertable );
 
@@ -1873,20 +2007,29 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
     {
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            size = min( count - i, ARRAY_SIZE(entries) );
+            ret = 0;
+            SERVER_START_REQ( remove_completions )
             {
                 req->handle = wine_server_obj_handle( handle );
+                wine_server_set_reply( req, entries, size * sizeof(*entries) );
                 if (!(status = wine_server_call( req )))
-                {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
-                }
+                    ret = wine_server_reply_size( reply ) / sizeof(*entries);
             }
             SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
-            ++i;
+            for (j = 0; j < ret; j++, i++)
+            {
+                info[i].CompletionKey             = entries[j].ckey;
+                info[i].CompletionValue           = entries[j].cvalue;
+                info[i].IoStatusBlock.Information = entries[j].information;
+                info[i].IoStatusBlock.u.Status    = entries[j].status;
+            }
+            if (ret < size)  /* the queue is empty */
+            {
+                status = STATUS_PENDING;
+                break;
+            }
         }
         if (i || status != STATUS_PENDING)
         {
@@ -1938,6 +2081,82 @@ NTSTATUS WINAPI NtQueryIoCompletion( HANDLE handle, IO_COMPLETION_INFORMATION_CL
 }
 
 
+/***********************************************************************
+ *             NtCreateWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtCreateWaitCompletionPacket( HANDLE *handle, ACCESS_MASK access, OBJECT_ATTRIBUTES *attr )
+{
+    unsigned int status;
+    data_size_t len;
+    struct object_attributes *objattr;
+
+    TRACE( "(%p, %x, %p)\n", handle, (int)access, attr );
+
+    *handle = 0;
+    if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
+
+    SERVER_START_REQ( create_wait_completion_packet )
+    {
+        req->access = access;
+        wine_server_add_data( req, objattr, len );
+        if (!(status = wine_server_call( req ))) *handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    free( objattr );
+    return status;
+}
+
+
+/***********************************************************************
+ *             NtAssociateWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtAssociateWaitCompletionPacket( HANDLE packet, HANDLE completion, HANDLE target,
+                                                 void *key, void *value, NTSTATUS status,
+                                                 ULONG_PTR information, BOOLEAN *already_signaled )
+{
+    unsigned int ret;
+
+    TRACE( "(%p, %p, %p, %p, %p, %x, %lx, %p)\n", packet, completion, target, key, value,
+           (int)status, information, already_signaled );
+
+    SERVER_START_REQ( associate_wait_completion_packet )
+    {
+        req->packet      = wine_server_obj_handle( packet );
+        req->completion  = wine_server_obj_handle( completion );
+        req->target      = wine_server_obj_handle( target );
+        req->ckey        = wine_server_client_ptr( key );
+        req->cvalue      = wine_server_client_ptr( value );
+        req->information = information;
+        req->status      = status;
+        if (!(ret = wine_server_call( req )) && already_signaled)
+            *already_signaled = reply->signaled;
+    }
+    SERVER_END_REQ;
+    return ret;
+}
+
+
+/***********************************************************************
+ *             NtCancelWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtCancelWaitCompletionPacket( HANDLE packet, BOOLEAN remove_signaled )
+{
+    unsigned int status;
+
+    TRACE( "(%p, %d)\n", packet, remove_signaled );
+
+    SERVER_START_REQ( cancel_wait_completion_packet )
+    {
+        req->packet          = wine_server_obj_handle( packet );
+        req->remove_signaled = remove_signaled;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
+
 /***********************************************************************
  *             NtCreateSection (NTDLL.@)
  */
@@ -1057,6 +1057,8 @@ static void pthread_exit_wrapper( int status )
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    if (ntdll_get_thread_data()->request_shm)
+        munmap( ntdll_get_thread_data()->request_shm, REQUEST_SHM_SIZE );
     pthread_exit( UIntToPtr(status) );
 }
 
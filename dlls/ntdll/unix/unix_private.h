@@ -60,6 +60,7 @@ struct ntdll_thread_data
     int                request_fd;    /* fd for sending server requests */
     int                reply_fd;      /* fd for receiving server replies */
     int                wait_fd[2];    /* fd for sleeping server requests */
+    struct request_shm *request_shm;  /* shared memory for server replies */
     pthread_t          pthread_id;    /* pthread thread id */
     struct list        entry;         /* entry in TEB list */
     PRTL_THREAD_START_ROUTINE start;  /* thread entry point */
@@ -170,6 +171,8 @@ extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *
                                               apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
+extern struct fast_sync_slot *get_fast_sync_slot( HANDLE handle, ACCESS_MASK access, unsigned int *serial ) DECLSPEC_HIDDEN;
+extern void fast_sync_wake( HANDLE handle ) DECLSPEC_HIDDEN;
 extern void wine_server_send_fd( int fd ) DECLSPEC_HIDDEN;
 extern void process_exit_wrapper( int status ) DECLSPEC_HIDDEN;
 extern size_t server_init_process(void) DECLSPEC_HIDDEN;
@@ -349,6 +352,40 @@ static inline void mutex_unlock( pthread_mutex_t *mutex )
     if (!process_exiting) pthread_mutex_unlock( mutex );
 }
 
+/* the state of a fast synchronization slot is updated together with its serial number */
+union fast_sync_word
+{
+    LONG64 value;
+    struct
+    {
+        int          state;
+        unsigned int serial;
+    } s;
+};
+
+/* read the state of a slot, failing if it has been reused since the handle was looked up */
+static inline BOOL fast_sync_read( struct fast_sync_slot *slot, unsigned int serial, int *state )
+{
+    union fast_sync_word word;
+
+    word.value = InterlockedCompareExchange64( (LONG64 *)&slot->state, 0, 0 );
+    if (word.s.serial != serial) return FALSE;
+    *state = word.s.state;
+    return TRUE;
+}
+
+/* replace the state of a slot if it didn't change, and the slot wasn't reused */
+static inline BOOL fast_sync_cmpxchg( struct fast_sync_slot *slot, unsigned int serial, int old_state, int state )
+{
+    union fast_sync_word old, word;
+
+    old.s.state   = old_state;
+    old.s.serial  = serial;
+    word.s.state  = state;
+    word.s.serial = serial;
+    return InterlockedCompareExchange64( (LONG64 *)&slot->state, word.value, old.value ) == old.value;
+}
+
 static inline async_data_t server_async( HANDLE handle, struct async_fileio *user, HANDLE event,
                                          PIO_APC_ROUTINE apc, void *apc_context, client_ptr_t iosb )
 {
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
 #include "user_private.h"
 #include "controls.h"
 #include "winver.h"
@@ -40,10 +42,26 @@ static HWND *list_window_children( HDESK desktop, HWND hwnd, UNICODE_STRING *cla
     HWND *list;
     int i, size = 128;
     ATOM atom = class ? get_int_atom_value( class ) : 0;
+    NTSTATUS status;
+    ULONG count;
 
     /* empty class is not the same as NULL class */
     if (!atom && class && !class->Length) return NULL;
 
+    while (!class)  /* win32u can avoid the server call */
+    {
+        if (!(list = HeapAlloc( GetProcessHeap(), 0, size * sizeof(HWND) ))) return NULL;
+        status = NtUserBuildHwndList( desktop, hwnd, TRUE, FALSE, tid, size, list, &count );
+        if (!status && count > 1)
+        {
+            list[count - 1] = 0;  /* replace the HWND_BOTTOM terminator */
+            return list;
+        }
+        HeapFree( GetProcessHeap(), 0, list );
+        if (status != STATUS_BUFFER_TOO_SMALL) return NULL;
+        size = count;  /* restart with a large enough buffer */
+    }
+
     for (;;)
     {
         int count = 0;
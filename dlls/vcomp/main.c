@@ -60,6 +60,9 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+/* number of iterations a thread spins in a barrier before going to sleep */
+#define VCOMP_BARRIER_SPIN_COUNT        4000
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -77,12 +80,18 @@ struct vcomp_thread_data
 
     /* section */
     unsigned int            section;
+    int                     num_sections;
 
     /* dynamic */
     unsigned int            dynamic;
     unsigned int            dynamic_type;
     unsigned int            dynamic_begin;
     unsigned int            dynamic_end;
+    unsigned int            dynamic_first;
+    unsigned int            dynamic_last;
+    unsigned int            dynamic_iterations;
+    int                     dynamic_step;
+    unsigned int            dynamic_chunksize;
 };
 
 struct vcomp_team_data
@@ -97,27 +106,24 @@ struct vcomp_team_data
     va_list                 valist;
 
     /* barrier */
-    unsigned int            barrier;
-    int                     barrier_count;
+    LONG                    barrier;
+    LONG                    barrier_count;
 };
 
+/* The task state is only updated with atomic operations, so that the threads
+ * of a team never contend on a lock. Sections and dynamic loops pack the
+ * generation of the construct in the high 32 bits and the next section index
+ * or the number of iterations handed out so far in the low 32 bits. */
 struct vcomp_task_data
 {
     /* single */
-    unsigned int            single;
+    LONG                    single;
 
     /* section */
-    unsigned int            section;
-    int                     num_sections;
-    int                     section_index;
+    LONG64                  section;
 
     /* dynamic */
-    unsigned int            dynamic;
-    unsigned int            dynamic_first;
-    unsigned int            dynamic_last;
-    unsigned int            dynamic_iterations;
-    int                     dynamic_step;
-    unsigned int            dynamic_chunksize;
+    LONG64                  dynamic;
 };
 
 static void **ptr_from_va_list(va_list valist)
@@ -1057,26 +1063,35 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    LONG barrier;
+    int i;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    barrier = ReadAcquire(&team_data->barrier);
+    if (InterlockedIncrement(&team_data->barrier_count) >= team_data->num_threads)
     {
-        team_data->barrier++;
         team_data->barrier_count = 0;
-        WakeAllConditionVariable(&team_data->cond);
+        InterlockedIncrement(&team_data->barrier);
+        RtlWakeAddressAll(&team_data->barrier);
+        return;
     }
-    else
+
+    /* spinning only makes sense if every thread of the team can run at the same time */
+    if (team_data->num_threads <= vcomp_num_procs)
     {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
+        for (i = 0; i < VCOMP_BARRIER_SPIN_COUNT; i++)
+        {
+            if (ReadAcquire(&team_data->barrier) != barrier) return;
+            YieldProcessor();
+        }
     }
-    LeaveCriticalSection(&vcomp_section);
+
+    while (ReadAcquire(&team_data->barrier) == barrier)
+        RtlWaitOnAddress(&team_data->barrier, &barrier, sizeof(barrier), NULL);
 }
 
 void CDECL _vcomp_set_num_threads(int num_threads)
@@ -1102,20 +1117,19 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    LONG single = ReadAcquire(&task_data->single), prev;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        if ((prev = InterlockedCompareExchange(&task_data->single, thread_data->single, single)) == single)
+            return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
 
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -1128,36 +1142,40 @@ void CDECL _vcomp_sections_init(int n)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
+    LONG64 section, prev;
 
     TRACE("(%d)\n", n);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->section++;
-    if ((int)(thread_data->section - task_data->section) > 0)
+    thread_data->num_sections = n;
+
+    section = InterlockedCompareExchange64(&task_data->section, 0, 0);
+    while ((int)(thread_data->section - (unsigned int)(section >> 32)) > 0)
     {
-        task_data->section       = thread_data->section;
-        task_data->num_sections  = n;
-        task_data->section_index = 0;
+        if ((prev = InterlockedCompareExchange64(&task_data->section,
+                                                 (LONG64)thread_data->section << 32, section)) == section)
+            break;
+        section = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
 }
 
 int CDECL _vcomp_sections_next(void)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int i = -1;
+    LONG64 section, prev;
 
     TRACE("()\n");
 
-    EnterCriticalSection(&vcomp_section);
-    if (thread_data->section == task_data->section &&
-        task_data->section_index != task_data->num_sections)
+    section = InterlockedCompareExchange64(&task_data->section, 0, 0);
+    while ((unsigned int)(section >> 32) == thread_data->section &&
+           (int)section != thread_data->num_sections)
     {
-        i = task_data->section_index++;
+        if ((prev = InterlockedCompareExchange64(&task_data->section, section + 1, section)) == section)
+            return (int)section;
+        section = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-    return i;
+    return -1;
 }
 
 void CDECL _vcomp_for_static_simple_init(unsigned int first, unsigned int last, int step,
@@ -1419,6 +1437,7 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_team_data *team_data = thread_data->team;
     struct vcomp_task_data *task_data = thread_data->task;
+    LONG64 dynamic, prev;
     int num_threads = team_data ? team_data->num_threads : 1;
     int thread_num = thread_data->thread_num;
     unsigned int type = flags & ~VCOMP_DYNAMIC_FLAGS_INCREMENT;
@@ -1467,19 +1486,24 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
+        /* every thread of the team gets the same loop parameters, so only
+         * the number of iterations handed out so far needs to be shared */
         thread_data->dynamic++;
-        thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
+        thread_data->dynamic_type       = type;
+        thread_data->dynamic_first      = first;
+        thread_data->dynamic_last       = last;
+        thread_data->dynamic_iterations = iterations;
+        thread_data->dynamic_step       = step;
+        thread_data->dynamic_chunksize  = chunksize;
+
+        dynamic = InterlockedCompareExchange64(&task_data->dynamic, 0, 0);
+        while ((int)(thread_data->dynamic - (unsigned int)(dynamic >> 32)) > 0)
         {
-            task_data->dynamic              = thread_data->dynamic;
-            task_data->dynamic_first        = first;
-            task_data->dynamic_last         = last;
-            task_data->dynamic_iterations   = iterations;
-            task_data->dynamic_step         = step;
-            task_data->dynamic_chunksize    = chunksize;
+            if ((prev = InterlockedCompareExchange64(&task_data->dynamic,
+                                                     (LONG64)thread_data->dynamic << 32, dynamic)) == dynamic)
+                break;
+            dynamic = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
     }
 }
 
@@ -1502,26 +1526,36 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        unsigned int iterations, remaining, taken;
+        LONG64 dynamic, prev;
+
+        dynamic = InterlockedCompareExchange64(&task_data->dynamic, 0, 0);
+        while ((unsigned int)(dynamic >> 32) == thread_data->dynamic)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            taken = (unsigned int)dynamic;
+            if (!(remaining = thread_data->dynamic_iterations - taken)) break;
+
+            iterations = min(remaining, thread_data->dynamic_chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * thread_data->dynamic_chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
-                *end = task_data->dynamic_last;
+            if (!iterations) break;
+
+            if ((prev = InterlockedCompareExchange64(&task_data->dynamic, dynamic + iterations, dynamic)) != dynamic)
+            {
+                dynamic = prev;
+                continue;
+            }
+
+            *begin = thread_data->dynamic_first + taken * thread_data->dynamic_step;
+            *end   = *begin + (iterations - 1) * thread_data->dynamic_step;
+            if (iterations == remaining)
+                *end = thread_data->dynamic_last;
+            return 1;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
+        return 0;
     }
 
     return 0;
@@ -2624,6 +2624,59 @@ static void test_omp_get_num_procs(void)
     ok(num_procs == sysinfo.dwNumberOfProcessors, "got dwNumberOfProcessors %ld num_procs %d\n", sysinfo.dwNumberOfProcessors, num_procs);
 }
 
+static void CDECL scaling_cb(LONG *iterations, LONG *sections)
+{
+    unsigned int begin, end;
+    int i;
+
+    for (i = 0; i < 1000; i++)
+        p_vcomp_barrier();
+
+    for (i = 0; i < 100; i++)
+    {
+        p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 9999, 1, 16);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+            InterlockedExchangeAdd(iterations, end - begin + 1);
+
+        p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_GUIDED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 9999, 1, 1);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+            InterlockedExchangeAdd(iterations, end - begin + 1);
+
+        p_vcomp_sections_init(64);
+        while (p_vcomp_sections_next() != -1)
+            InterlockedIncrement(sections);
+
+        p_vcomp_barrier();
+    }
+}
+
+static void test_vcomp_scaling(void)
+{
+    int max_threads = pomp_get_max_threads();
+    int num_procs = pomp_get_num_procs();
+    LARGE_INTEGER freq, start, stop;
+    LONG iterations, sections;
+    int i;
+
+    QueryPerformanceFrequency(&freq);
+
+    for (i = 1; i <= max(2 * num_procs, 4); i *= 2)
+    {
+        pomp_set_num_threads(i);
+
+        iterations = sections = 0;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 2, scaling_cb, &iterations, &sections);
+        QueryPerformanceCounter(&stop);
+
+        ok(iterations == 2 * 100 * 10000, "%d threads: got %ld iterations\n", i, iterations);
+        ok(sections == 100 * 64, "%d threads: got %ld sections\n", i, sections);
+        trace("%d threads: %.2f ms\n", i, (stop.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 START_TEST(vcomp)
 {
     if (!init_vcomp())
@@ -2654,6 +2707,7 @@ START_TEST(vcomp)
     test_reduction_integer32();
     test_reduction_integer64();
     test_reduction_float_double();
+    test_vcomp_scaling();
 
     release_vcomp();
 }
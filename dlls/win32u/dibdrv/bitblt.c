@@ -23,6 +23,8 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -470,6 +472,207 @@ static int get_overlap( const dib_info *dst, const RECT *dst_rect,
     return ret;
 }
 
+/* Large operations are split into bands of rows that are executed in parallel
+ * by a pool of worker threads, the calling thread taking its share. Only one
+ * operation uses the pool at a time; the others are executed serially. The
+ * workers only run the primitive functions, which have no side effects
+ * outside of the destination rows. They are not Wine threads and can't handle
+ * page faults, so they are only used on bits that the app can't see. */
+
+#define BAND_MIN_PIXELS  (512 * 512)  /* don't split operations smaller than this */
+#define BAND_MIN_ROWS    16
+#define MAX_BAND_THREADS 8
+
+struct band_job
+{
+    void (*func)( const void *params, const RECT *band );  /* run the operation on a band */
+    const void *params;
+    RECT        bounds;  /* bounding rectangle of the operation */
+    int         count;   /* number of bands */
+    int         next;    /* next band to run */
+    int         users;   /* number of worker threads using the job */
+};
+
+static pthread_mutex_t band_submit_mutex = PTHREAD_MUTEX_INITIALIZER;  /* held while a job is running */
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_job_cond = PTHREAD_COND_INITIALIZER;   /* a job has been submitted */
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;  /* a worker released the job */
+static struct band_job *band_job;  /* current job, protected by band_mutex */
+static unsigned int band_serial;   /* serial number of the current job */
+static int band_threads;           /* number of worker threads */
+
+static void run_bands( struct band_job *job )
+{
+    int i, height = job->bounds.bottom - job->bounds.top;
+    RECT band = job->bounds;
+
+    while ((i = __atomic_fetch_add( &job->next, 1, __ATOMIC_RELAXED )) < job->count)
+    {
+        band.top    = job->bounds.top + (LONGLONG)height * i / job->count;
+        band.bottom = job->bounds.top + (LONGLONG)height * (i + 1) / job->count;
+        job->func( job->params, &band );
+    }
+}
+
+static void *band_thread( void *arg )
+{
+    unsigned int serial = 0;
+    struct band_job *job;
+
+    pthread_mutex_lock( &band_mutex );
+    for (;;)
+    {
+        while (serial == band_serial) pthread_cond_wait( &band_job_cond, &band_mutex );
+        serial = band_serial;
+        if (!(job = band_job)) continue;
+        job->users++;
+        pthread_mutex_unlock( &band_mutex );
+
+        run_bands( job );
+
+        pthread_mutex_lock( &band_mutex );
+        if (!--job->users) pthread_cond_signal( &band_done_cond );
+    }
+    return NULL;
+}
+
+static void init_band_threads(void)
+{
+    int i, count = min( system_info.NumberOfProcessors, MAX_BAND_THREADS ) - 1;
+    sigset_t mask, old_mask;
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    /* the workers are not Wine threads, keep the signals away from them */
+    sigfillset( &mask );
+    pthread_sigmask( SIG_SETMASK, &mask, &old_mask );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    for (i = 0; i < count; i++)
+    {
+        if (pthread_create( &thread, &attr, band_thread, NULL )) break;
+        band_threads++;
+    }
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_mask, NULL );
+    TRACE( "using %d threads\n", band_threads );
+}
+
+/* run an operation on bands of rows of the rectangles using the worker threads;
+ * return FALSE if it can't be done or isn't worth it and the caller should run it serially */
+static BOOL run_band_job( void (*func)( const void *params, const RECT *band ), const void *params,
+                          const dib_info *dst, const dib_info *src, const RECT *rects, int count )
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+    struct band_job job;
+    LONGLONG pixels = 0;
+    int i;
+
+    if (count <= 0) return FALSE;
+    if (!dst->private_bits || (src && !src->private_bits)) return FALSE;
+    reset_bounds( &job.bounds );
+    for (i = 0; i < count; i++)
+    {
+        pixels += (LONGLONG)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+        add_bounds_rect( &job.bounds, &rects[i] );
+    }
+    if (pixels < BAND_MIN_PIXELS) return FALSE;
+
+    pthread_once( &init_once, init_band_threads );
+    job.count = min( band_threads + 1, (job.bounds.bottom - job.bounds.top) / BAND_MIN_ROWS );
+    if (job.count <= 1) return FALSE;
+    if (pthread_mutex_trylock( &band_submit_mutex )) return FALSE;
+
+    job.func   = func;
+    job.params = params;
+    job.next   = 0;
+    job.users  = 0;
+
+    pthread_mutex_lock( &band_mutex );
+    band_job = &job;
+    band_serial++;
+    pthread_cond_broadcast( &band_job_cond );
+    pthread_mutex_unlock( &band_mutex );
+
+    run_bands( &job );
+
+    pthread_mutex_lock( &band_mutex );
+    while (job.users) pthread_cond_wait( &band_done_cond, &band_mutex );
+    band_job = NULL;
+    pthread_mutex_unlock( &band_mutex );
+
+    pthread_mutex_unlock( &band_submit_mutex );
+    return TRUE;
+}
+
+struct solid_rects_params
+{
+    const dib_info *dib;
+    const RECT     *rects;
+    int             count;
+    DWORD           and;
+    DWORD           xor;
+};
+
+static void solid_rects_band( const void *ptr, const RECT *band )
+{
+    const struct solid_rects_params *params = ptr;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < params->count; i++)
+        if (intersect_rect( &rect, &params->rects[i], band ))
+            params->dib->funcs->solid_rects( params->dib, 1, &rect, params->and, params->xor );
+}
+
+struct copy_rect_params
+{
+    const dib_info *dst;
+    const RECT     *dst_rect;
+    const dib_info *src;
+    const RECT     *src_rect;
+    const RECT     *rects;
+    int             count;
+    int             rop2;
+};
+
+static void copy_rect_band( const void *ptr, const RECT *band )
+{
+    const struct copy_rect_params *params = ptr;
+    POINT origin;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < params->count; i++)
+    {
+        if (!intersect_rect( &rect, &params->rects[i], band )) continue;
+        origin.x = params->src_rect->left + rect.left - params->dst_rect->left;
+        origin.y = params->src_rect->top  + rect.top  - params->dst_rect->top;
+        params->dst->funcs->copy_rect( params->dst, &rect, params->src, &origin, params->rop2, 0 );
+    }
+}
+
+struct blend_rects_params
+{
+    const dib_info *dst;
+    const dib_info *src;
+    const RECT     *rects;
+    int             count;
+    POINT           offset;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_rects_band( const void *ptr, const RECT *band )
+{
+    const struct blend_rects_params *params = ptr;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < params->count; i++)
+        if (intersect_rect( &rect, &params->rects[i], band ))
+            params->dst->funcs->blend_rects( params->dst, 1, &rect, params->src, &params->offset, params->blend );
+}
+
 static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                         const struct clipped_rects *clipped_rects, INT rop2 )
 {
@@ -496,13 +699,25 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     case R2_WHITE: xor = ~0u;
         /* fall through */
     case R2_BLACK:
-        dst->funcs->solid_rects( dst, count, rects, and, xor );
+    {
+        struct solid_rects_params params = { dst, rects, count, and, xor };
+
+        if (!run_band_job( solid_rects_band, &params, dst, NULL, rects, count ))
+            dst->funcs->solid_rects( dst, count, rects, and, xor );
+    }
         /* fall through */
     case R2_NOP:
         return;
     }
 
     overlap = get_overlap( dst, dst_rect, src, src_rect );
+    if (!overlap)
+    {
+        struct copy_rect_params params = { dst, dst_rect, src, src_rect, rects, count, rop2 };
+
+        if (run_band_job( copy_rect_band, &params, dst, src, rects, count )) return;
+    }
+
     if (overlap & OVERLAP_BELOW)
     {
         if (overlap & OVERLAP_RIGHT)  /* right to left, bottom to top */
@@ -595,6 +810,16 @@ static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *sr
 
     offset.x = src_rect->left - dst_rect->left;
     offset.y = src_rect->top  - dst_rect->top;
+    if (!get_overlap( dst, dst_rect, src, src_rect ))
+    {
+        struct blend_rects_params params = { dst, src, clipped_rects.rects, clipped_rects.count, offset, blend };
+
+        if (run_band_job( blend_rects_band, &params, dst, src, clipped_rects.rects, clipped_rects.count ))
+        {
+            free_clipped_rects( &clipped_rects );
+            return ERROR_SUCCESS;
+        }
+    }
     dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
 
     free_clipped_rects( &clipped_rects );
@@ -715,6 +940,7 @@ static DWORD copy_src_bits( dib_info *src, RECT *src_rect )
     src->bits.ptr = ptr;
     src->bits.free = free_heap_bits;
     src->bits.param = NULL;
+    src->private_bits = TRUE;
 
     OffsetRect( src_rect, 0, -src_rect->top );
     return ERROR_SUCCESS;
@@ -734,6 +960,7 @@ static DWORD create_tmp_dib( const dib_info *copy, int width, int height, dib_in
     ret->bits.is_copy = TRUE;
     ret->bits.free = free_heap_bits;
     ret->bits.param = NULL;
+    ret->private_bits = TRUE;
 
     return ret->bits.ptr ? ERROR_SUCCESS : ERROR_OUTOFMEMORY;
 }
@@ -964,6 +1191,7 @@ DWORD put_image_into_bitmap( BITMAPOBJ *bmp, HRGN clip, BITMAPINFO *info,
 
     init_dib_info_from_bitmapinfo( &src_dib, info, bits->ptr );
     src_dib.bits.is_copy = bits->is_copy;
+    src_dib.private_bits = bits->is_copy;
 
     if (get_clipped_rects( &dib, &dst->visrect, clip, &clipped_rects ))
     {
@@ -1012,6 +1240,7 @@ DWORD CDECL dibdrv_PutImage( PHYSDEV dev, HRGN clip, BITMAPINFO *info,
 
     init_dib_info_from_bitmapinfo( &src_dib, info, bits->ptr );
     src_dib.bits.is_copy = bits->is_copy;
+    src_dib.private_bits = bits->is_copy;
 
     if (clip && pdev->clip)
     {
@@ -1074,6 +1303,7 @@ DWORD CDECL dibdrv_BlendImage( PHYSDEV dev, BITMAPINFO *info, const struct gdi_i
 
     init_dib_info_from_bitmapinfo( &src_dib, info, bits->ptr );
     src_dib.bits.is_copy = bits->is_copy;
+    src_dib.private_bits = bits->is_copy;
     add_clipped_bounds( pdev, &dst->visrect, pdev->clip );
     return blend_rect( &pdev->dib, &dst->visrect, &src_dib, &src->visrect, pdev->clip, blend );
 
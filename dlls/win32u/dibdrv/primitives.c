@@ -23,6 +23,11 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -268,8 +273,322 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+/* SIMD versions of the hot 32-bpp and 24-bpp loops, selected at run time.
+ * They must give exactly the same results as the scalar code. */
+
+struct simd_funcs
+{
+    void (*solid_line_32)( DWORD *ptr, DWORD and, DWORD xor, int len );
+    void (*rop_codes_line)( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len );
+    void (*rop_codes_line_rev)( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len );
+    /* the blend functions return the number of pixels processed, the caller blends the rest */
+    int  (*blend_line_argb)( DWORD *dst, const DWORD *src, int len, DWORD alpha );
+    int  (*blend_line_constant_alpha)( DWORD *dst, const DWORD *src, int len, DWORD alpha, DWORD src_or );
+};
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static void SSE2_TARGET solid_line_32_sse2( DWORD *ptr, DWORD and, DWORD xor, int len )
+{
+    const __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+
+    for (; len >= 4; len -= 4, ptr += 4)
+    {
+        __m128i d = _mm_loadu_si128( (const __m128i *)ptr );
+        _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( d, and_vec ), xor_vec ));
+    }
+    for (; len > 0; len--) do_rop_32( ptr++, and, xor );
+}
+
+static inline __m128i SSE2_TARGET rop_codes_sse2( __m128i d, __m128i s, __m128i a1, __m128i a2,
+                                                  __m128i x1, __m128i x2 )
+{
+    d = _mm_and_si128( d, _mm_xor_si128( _mm_and_si128( s, a1 ), a2 ));
+    return _mm_xor_si128( d, _mm_xor_si128( _mm_and_si128( s, x1 ), x2 ));
+}
+
+/* the rop codes are either 0 or ~0, so the lines can be processed as bytes for any depth */
+static void SSE2_TARGET rop_codes_line_sse2( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len )
+{
+    const __m128i a1 = _mm_set1_epi32( codes->a1 ), a2 = _mm_set1_epi32( codes->a2 );
+    const __m128i x1 = _mm_set1_epi32( codes->x1 ), x2 = _mm_set1_epi32( codes->x2 );
+
+    for (; len >= 16; len -= 16, src += 16, dst += 16)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)src );
+        __m128i d = _mm_loadu_si128( (const __m128i *)dst );
+        _mm_storeu_si128( (__m128i *)dst, rop_codes_sse2( d, s, a1, a2, x1, x2 ));
+    }
+    do_rop_codes_line_8( dst, src, codes, len );
+}
+
+static void SSE2_TARGET rop_codes_line_rev_sse2( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len )
+{
+    const __m128i a1 = _mm_set1_epi32( codes->a1 ), a2 = _mm_set1_epi32( codes->a2 );
+    const __m128i x1 = _mm_set1_epi32( codes->x1 ), x2 = _mm_set1_epi32( codes->x2 );
+
+    while (len >= 16)
+    {
+        __m128i s, d;
+
+        len -= 16;
+        s = _mm_loadu_si128( (const __m128i *)(src + len) );
+        d = _mm_loadu_si128( (const __m128i *)(dst + len) );
+        _mm_storeu_si128( (__m128i *)(dst + len), rop_codes_sse2( d, s, a1, a2, x1, x2 ));
+    }
+    do_rop_codes_line_rev_8( dst, src, codes, len );
+}
+
+/* (v + 127) / 255 on 16-bit lanes, exact for v <= 255 * 255 */
+static inline __m128i SSE2_TARGET div255_sse2( __m128i v )
+{
+    v = _mm_add_epi16( v, _mm_set1_epi16( 127 ));
+    v = _mm_add_epi16( v, _mm_add_epi16( _mm_srli_epi16( v, 8 ), _mm_set1_epi16( 1 )));
+    return _mm_srli_epi16( v, 8 );
+}
+
+/* combine 16-bit channels into pixels; like the scalar code, a channel that
+ * overflowed 8 bits is or'ed into the next one */
+static inline __m128i SSE2_TARGET pack_channels_sse2( __m128i lo, __m128i hi )
+{
+    const __m128i mask16 = _mm_set1_epi32( 0xffff );
+    const __m128i mask32 = _mm_set_epi32( 0, ~0, 0, ~0 );
+
+    lo = _mm_or_si128( _mm_and_si128( lo, mask16 ), _mm_slli_epi32( _mm_srli_epi32( lo, 16 ), 8 ));
+    lo = _mm_or_si128( _mm_and_si128( lo, mask32 ), _mm_slli_epi64( _mm_srli_epi64( lo, 32 ), 16 ));
+    hi = _mm_or_si128( _mm_and_si128( hi, mask16 ), _mm_slli_epi32( _mm_srli_epi32( hi, 16 ), 8 ));
+    hi = _mm_or_si128( _mm_and_si128( hi, mask32 ), _mm_slli_epi64( _mm_srli_epi64( hi, 32 ), 16 ));
+    return _mm_unpacklo_epi64( _mm_shuffle_epi32( lo, _MM_SHUFFLE( 3, 1, 2, 0 )),
+                               _mm_shuffle_epi32( hi, _MM_SHUFFLE( 3, 1, 2, 0 )));
+}
+
+/* same as blend_argb_alpha(), or blend_argb() if alpha is 255 */
+static int SSE2_TARGET blend_line_argb_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    const __m128i zero = _mm_setzero_si128(), max = _mm_set1_epi16( 255 ), ca = _mm_set1_epi16( alpha );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        __m128i s_lo = _mm_unpacklo_epi8( s, zero ), s_hi = _mm_unpackhi_epi8( s, zero );
+        __m128i d_lo = _mm_unpacklo_epi8( d, zero ), d_hi = _mm_unpackhi_epi8( d, zero );
+        __m128i a_lo, a_hi;
+
+        if (alpha != 255)
+        {
+            s_lo = div255_sse2( _mm_mullo_epi16( s_lo, ca ));
+            s_hi = div255_sse2( _mm_mullo_epi16( s_hi, ca ));
+        }
+        a_lo = _mm_sub_epi16( max, _mm_shufflehi_epi16( _mm_shufflelo_epi16( s_lo, 0xff ), 0xff ));
+        a_hi = _mm_sub_epi16( max, _mm_shufflehi_epi16( _mm_shufflelo_epi16( s_hi, 0xff ), 0xff ));
+        d_lo = _mm_add_epi16( s_lo, div255_sse2( _mm_mullo_epi16( d_lo, a_lo )));
+        d_hi = _mm_add_epi16( s_hi, div255_sse2( _mm_mullo_epi16( d_hi, a_hi )));
+        _mm_storeu_si128( (__m128i *)(dst + x), pack_channels_sse2( d_lo, d_hi ));
+    }
+    return x;
+}
+
+/* same as blend_argb_constant_alpha() on (src | src_or) */
+static int SSE2_TARGET blend_line_constant_alpha_sse2( DWORD *dst, const DWORD *src, int len,
+                                                       DWORD alpha, DWORD src_or )
+{
+    const __m128i zero = _mm_setzero_si128(), or = _mm_set1_epi32( src_or );
+    const __m128i ca = _mm_set1_epi16( alpha ), inv = _mm_set1_epi16( 255 - alpha );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), or );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), ca ),
+                                    _mm_mullo_epi16( _mm_unpacklo_epi8( d, zero ), inv ));
+        __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), ca ),
+                                    _mm_mullo_epi16( _mm_unpackhi_epi8( d, zero ), inv ));
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( div255_sse2( lo ), div255_sse2( hi )));
+    }
+    return x;
+}
+
+static void AVX2_TARGET solid_line_32_avx2( DWORD *ptr, DWORD and, DWORD xor, int len )
+{
+    const __m256i and_vec = _mm256_set1_epi32( and ), xor_vec = _mm256_set1_epi32( xor );
+
+    for (; len >= 8; len -= 8, ptr += 8)
+    {
+        __m256i d = _mm256_loadu_si256( (const __m256i *)ptr );
+        _mm256_storeu_si256( (__m256i *)ptr, _mm256_xor_si256( _mm256_and_si256( d, and_vec ), xor_vec ));
+    }
+    for (; len > 0; len--) do_rop_32( ptr++, and, xor );
+}
+
+static inline __m256i AVX2_TARGET rop_codes_avx2( __m256i d, __m256i s, __m256i a1, __m256i a2,
+                                                  __m256i x1, __m256i x2 )
+{
+    d = _mm256_and_si256( d, _mm256_xor_si256( _mm256_and_si256( s, a1 ), a2 ));
+    return _mm256_xor_si256( d, _mm256_xor_si256( _mm256_and_si256( s, x1 ), x2 ));
+}
+
+static void AVX2_TARGET rop_codes_line_avx2( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len )
+{
+    const __m256i a1 = _mm256_set1_epi32( codes->a1 ), a2 = _mm256_set1_epi32( codes->a2 );
+    const __m256i x1 = _mm256_set1_epi32( codes->x1 ), x2 = _mm256_set1_epi32( codes->x2 );
+
+    for (; len >= 32; len -= 32, src += 32, dst += 32)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)src );
+        __m256i d = _mm256_loadu_si256( (const __m256i *)dst );
+        _mm256_storeu_si256( (__m256i *)dst, rop_codes_avx2( d, s, a1, a2, x1, x2 ));
+    }
+    do_rop_codes_line_8( dst, src, codes, len );
+}
+
+static void AVX2_TARGET rop_codes_line_rev_avx2( BYTE *dst, const BYTE *src, struct rop_codes *codes, int len )
+{
+    const __m256i a1 = _mm256_set1_epi32( codes->a1 ), a2 = _mm256_set1_epi32( codes->a2 );
+    const __m256i x1 = _mm256_set1_epi32( codes->x1 ), x2 = _mm256_set1_epi32( codes->x2 );
+
+    while (len >= 32)
+    {
+        __m256i s, d;
+
+        len -= 32;
+        s = _mm256_loadu_si256( (const __m256i *)(src + len) );
+        d = _mm256_loadu_si256( (const __m256i *)(dst + len) );
+        _mm256_storeu_si256( (__m256i *)(dst + len), rop_codes_avx2( d, s, a1, a2, x1, x2 ));
+    }
+    do_rop_codes_line_rev_8( dst, src, codes, len );
+}
+
+static inline __m256i AVX2_TARGET div255_avx2( __m256i v )
+{
+    v = _mm256_add_epi16( v, _mm256_set1_epi16( 127 ));
+    v = _mm256_add_epi16( v, _mm256_add_epi16( _mm256_srli_epi16( v, 8 ), _mm256_set1_epi16( 1 )));
+    return _mm256_srli_epi16( v, 8 );
+}
+
+static inline __m256i AVX2_TARGET pack_channels_avx2( __m256i lo, __m256i hi )
+{
+    const __m256i mask16 = _mm256_set1_epi32( 0xffff );
+    const __m256i mask32 = _mm256_set1_epi64x( 0xffffffff );
+
+    lo = _mm256_or_si256( _mm256_and_si256( lo, mask16 ), _mm256_slli_epi32( _mm256_srli_epi32( lo, 16 ), 8 ));
+    lo = _mm256_or_si256( _mm256_and_si256( lo, mask32 ), _mm256_slli_epi64( _mm256_srli_epi64( lo, 32 ), 16 ));
+    hi = _mm256_or_si256( _mm256_and_si256( hi, mask16 ), _mm256_slli_epi32( _mm256_srli_epi32( hi, 16 ), 8 ));
+    hi = _mm256_or_si256( _mm256_and_si256( hi, mask32 ), _mm256_slli_epi64( _mm256_srli_epi64( hi, 32 ), 16 ));
+    return _mm256_unpacklo_epi64( _mm256_shuffle_epi32( lo, _MM_SHUFFLE( 3, 1, 2, 0 )),
+                                  _mm256_shuffle_epi32( hi, _MM_SHUFFLE( 3, 1, 2, 0 )));
+}
+
+static int AVX2_TARGET blend_line_argb_avx2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    const __m256i zero = _mm256_setzero_si256(), max = _mm256_set1_epi16( 255 ), ca = _mm256_set1_epi16( alpha );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + x) );
+        __m256i d = _mm256_loadu_si256( (const __m256i *)(dst + x) );
+        __m256i s_lo = _mm256_unpacklo_epi8( s, zero ), s_hi = _mm256_unpackhi_epi8( s, zero );
+        __m256i d_lo = _mm256_unpacklo_epi8( d, zero ), d_hi = _mm256_unpackhi_epi8( d, zero );
+        __m256i a_lo, a_hi;
+
+        if (alpha != 255)
+        {
+            s_lo = div255_avx2( _mm256_mullo_epi16( s_lo, ca ));
+            s_hi = div255_avx2( _mm256_mullo_epi16( s_hi, ca ));
+        }
+        a_lo = _mm256_sub_epi16( max, _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( s_lo, 0xff ), 0xff ));
+        a_hi = _mm256_sub_epi16( max, _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( s_hi, 0xff ), 0xff ));
+        d_lo = _mm256_add_epi16( s_lo, div255_avx2( _mm256_mullo_epi16( d_lo, a_lo )));
+        d_hi = _mm256_add_epi16( s_hi, div255_avx2( _mm256_mullo_epi16( d_hi, a_hi )));
+        _mm256_storeu_si256( (__m256i *)(dst + x), pack_channels_avx2( d_lo, d_hi ));
+    }
+    return x;
+}
+
+static int AVX2_TARGET blend_line_constant_alpha_avx2( DWORD *dst, const DWORD *src, int len,
+                                                       DWORD alpha, DWORD src_or )
+{
+    const __m256i zero = _mm256_setzero_si256(), or = _mm256_set1_epi32( src_or );
+    const __m256i ca = _mm256_set1_epi16( alpha ), inv = _mm256_set1_epi16( 255 - alpha );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_or_si256( _mm256_loadu_si256( (const __m256i *)(src + x) ), or );
+        __m256i d = _mm256_loadu_si256( (const __m256i *)(dst + x) );
+        __m256i lo = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpacklo_epi8( s, zero ), ca ),
+                                       _mm256_mullo_epi16( _mm256_unpacklo_epi8( d, zero ), inv ));
+        __m256i hi = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpackhi_epi8( s, zero ), ca ),
+                                       _mm256_mullo_epi16( _mm256_unpackhi_epi8( d, zero ), inv ));
+        _mm256_storeu_si256( (__m256i *)(dst + x),
+                             _mm256_packus_epi16( div255_avx2( lo ), div255_avx2( hi )));
+    }
+    return x;
+}
+
+static const struct simd_funcs sse2_funcs =
+{
+    solid_line_32_sse2,
+    rop_codes_line_sse2,
+    rop_codes_line_rev_sse2,
+    blend_line_argb_sse2,
+    blend_line_constant_alpha_sse2,
+};
+
+static const struct simd_funcs avx2_funcs =
+{
+    solid_line_32_avx2,
+    rop_codes_line_avx2,
+    rop_codes_line_rev_avx2,
+    blend_line_argb_avx2,
+    blend_line_constant_alpha_avx2,
+};
+
+static const struct simd_funcs *simd_funcs;
+
+static void init_simd_funcs(void)
+{
+    unsigned int eax, ebx, ecx, edx, xcr0_lo, xcr0_hi;
+
+    if (!__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) || !(edx & bit_SSE2)) return;
+    simd_funcs = &sse2_funcs;
+
+    /* AVX2 also needs the OS to save the ymm registers */
+    if ((ecx & (bit_OSXSAVE | bit_AVX)) != (bit_OSXSAVE | bit_AVX)) return;
+    __asm__( "xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0) );
+    if ((xcr0_lo & 6) != 6) return;
+    if (__get_cpuid_max( 0, NULL ) < 7) return;
+    __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+    if (ebx & bit_AVX2) simd_funcs = &avx2_funcs;
+}
+
+/* return the SIMD functions supported by the CPU, or NULL */
+static const struct simd_funcs *get_simd_funcs(void)
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+    pthread_once( &init_once, init_simd_funcs );
+    return simd_funcs;
+}
+
+#else  /* __GNUC__ && (__i386__ || __x86_64__) */
+
+static inline const struct simd_funcs *get_simd_funcs(void)
+{
+    return NULL;
+}
+
+#endif  /* __GNUC__ && (__i386__ || __x86_64__) */
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
+    const struct simd_funcs *simd = get_simd_funcs();
     DWORD *ptr, *start;
     int x, y, i;
 
@@ -278,7 +597,10 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         assert( !IsRectEmpty( rc ));
 
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
-        if (and)
+        if (and && simd)
+            for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+                simd->solid_line_32( start, and, xor, rc->right - rc->left );
+        else if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 for(x = rc->left, ptr = start; x < rc->right; x++)
                     do_rop_32(ptr++, and, xor);
@@ -1382,8 +1704,10 @@ static inline void copy_rect_bits_rev_32( DWORD *dst_start, const DWORD *src_sta
 static void copy_rect_32(const dib_info *dst, const RECT *rc,
                          const dib_info *src, const POINT *origin, int rop2, int overlap)
 {
+    const struct simd_funcs *simd;
     DWORD *dst_start, *src_start;
     int y, dst_stride, src_stride;
+    struct rop_codes codes;
     SIZE size;
 
     if (overlap & OVERLAP_BELOW)
@@ -1408,6 +1732,19 @@ static void copy_rect_32(const dib_info *dst, const RECT *rc,
         return;
     }
 
+    if ((simd = get_simd_funcs()))
+    {
+        get_rop_codes( rop2, &codes );
+        for (y = rc->top; y < rc->bottom; y++, dst_start += dst_stride, src_start += src_stride)
+        {
+            if (overlap & OVERLAP_RIGHT)
+                simd->rop_codes_line_rev( (BYTE *)dst_start, (BYTE *)src_start, &codes, (rc->right - rc->left) * 4 );
+            else
+                simd->rop_codes_line( (BYTE *)dst_start, (BYTE *)src_start, &codes, (rc->right - rc->left) * 4 );
+        }
+        return;
+    }
+
     size.cx = rc->right - rc->left;
     size.cy = rc->bottom - rc->top;
 
@@ -1420,6 +1757,7 @@ static void copy_rect_32(const dib_info *dst, const RECT *rc,
 static void copy_rect_24(const dib_info *dst, const RECT *rc,
                          const dib_info *src, const POINT *origin, int rop2, int overlap)
 {
+    const struct simd_funcs *simd;
     BYTE *dst_start, *src_start;
     int y, dst_stride, src_stride;
     struct rop_codes codes;
@@ -1447,12 +1785,19 @@ static void copy_rect_24(const dib_info *dst, const RECT *rc,
     }
 
     get_rop_codes( rop2, &codes );
+    simd = get_simd_funcs();
     for (y = rc->top; y < rc->bottom; y++, dst_start += dst_stride, src_start += src_stride)
     {
         if (overlap & OVERLAP_RIGHT)
-            do_rop_codes_line_rev_8( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+        {
+            if (simd) simd->rop_codes_line_rev( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+            else do_rop_codes_line_rev_8( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+        }
         else
-            do_rop_codes_line_8( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+        {
+            if (simd) simd->rop_codes_line( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+            else do_rop_codes_line_8( dst_start, src_start, &codes, (rc->right - rc->left) * 3 );
+        }
     }
 }
 
@@ -4685,31 +5030,38 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
 static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
                              const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
 {
-    int i, x, y;
+    const struct simd_funcs *simd = get_simd_funcs();
+    int i, x, y, width;
 
     for (i = 0; i < num; i++, rc++)
     {
         DWORD *src_ptr = get_pixel_ptr_32( src, rc->left + offset->x, rc->top + offset->y );
         DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
 
+        width = rc->right - rc->left;
         if (blend.AlphaFormat & AC_SRC_ALPHA)
         {
             if (blend.SourceConstantAlpha == 255)
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
+                    for (x = simd ? simd->blend_line_argb( dst_ptr, src_ptr, width, 255 ) : 0; x < width; x++)
                         dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
             else
                 for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
+                    for (x = simd ? simd->blend_line_argb( dst_ptr, src_ptr, width, blend.SourceConstantAlpha ) : 0;
+                         x < width; x++)
                         dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
         }
         else if (src->compression == BI_RGB)
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
+                for (x = simd ? simd->blend_line_constant_alpha( dst_ptr, src_ptr, width,
+                                                                 blend.SourceConstantAlpha, 0 ) : 0;
+                     x < width; x++)
                     dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
         else
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
+                for (x = simd ? simd->blend_line_constant_alpha( dst_ptr, src_ptr, width,
+                                                                 blend.SourceConstantAlpha, 0xff000000 ) : 0;
+                     x < width; x++)
                     dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
     }
 }
@@ -659,6 +659,60 @@ UINT WINAPI NtUserSendInput( UINT count, INPUT *inputs, int size )
     return i;
 }
 
+/***********************************************************************
+ *           get_shared_queue
+ *
+ * Get the state of the thread message queue from the user shared memory.
+ * The server creates the queue if needed when create is set.
+ */
+BOOL get_shared_queue( struct queue_shm *queue, BOOL create )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+
+    if (!thread_info->queue_shm)
+    {
+        if (!create) return FALSE;
+        SERVER_START_REQ( get_queue_shm )
+        {
+            if (!wine_server_call( req ))
+            {
+                thread_info->queue_shm    = reply->offset;
+                thread_info->queue_shm_id = reply->id;
+            }
+            else thread_info->queue_shm = ~0u;  /* don't ask again */
+        }
+        SERVER_END_REQ;
+    }
+    return read_user_shm( thread_info->queue_shm, thread_info->queue_shm_id, queue, sizeof(*queue) );
+}
+
+/***********************************************************************
+ *           get_shared_input
+ */
+static BOOL get_shared_input( struct input_shm *input, UINT *offset, BOOL create )
+{
+    struct queue_shm queue;
+
+    if (!get_shared_queue( &queue, create )) return FALSE;
+    *offset = queue.input;
+    return read_user_shm( queue.input, queue.input_id, input, sizeof(*input) );
+}
+
+/***********************************************************************
+ *           get_shared_desktop
+ *
+ * The desktop state doesn't need a message queue, so only use the shared
+ * memory if the thread already has one and let callers ask the server otherwise.
+ */
+static BOOL get_shared_desktop( struct desktop_shm *desktop )
+{
+    struct input_shm input;
+    UINT offset;
+
+    if (!get_shared_input( &input, &offset, FALSE )) return FALSE;
+    return read_user_shm( input.desktop, input.desktop_id, desktop, sizeof(*desktop) );
+}
+
 /***********************************************************************
  *	     NtUserSetCursorPos (win32u.@)
  */
@@ -698,22 +752,32 @@ BOOL WINAPI NtUserSetCursorPos( INT x, INT y )
  */
 BOOL get_cursor_pos( POINT *pt )
 {
+    struct desktop_shm desktop;
     BOOL ret;
     DWORD last_change;
     UINT dpi;
 
     if (!pt) return FALSE;
 
-    SERVER_START_REQ( set_cursor )
+    if ((ret = get_shared_desktop( &desktop )))
     {
-        if ((ret = !wine_server_call( req )))
+        pt->x = desktop.cursor_x;
+        pt->y = desktop.cursor_y;
+        last_change = desktop.cursor_last_change;
+    }
+    else
+    {
+        SERVER_START_REQ( set_cursor )
         {
-            pt->x = reply->new_x;
-            pt->y = reply->new_y;
-            last_change = reply->last_change;
+            if ((ret = !wine_server_call( req )))
+            {
+                pt->x = reply->new_x;
+                pt->y = reply->new_y;
+                last_change = reply->last_change;
+            }
         }
+        SERVER_END_REQ;
     }
-    SERVER_END_REQ;
 
     /* query new position from graphics driver if we haven't updated recently */
     if (ret && NtGetTickCount() - last_change > 100) ret = user_driver->pGetCursorPos( pt );
@@ -761,6 +825,7 @@ SHORT WINAPI NtUserGetAsyncKeyState( INT key )
 {
     struct user_key_state_info *key_state_info = get_user_thread_info()->key_state;
     INT counter = global_key_state_counter;
+    struct desktop_shm desktop;
     BYTE prev_key_state;
     SHORT ret;
 
@@ -768,6 +833,10 @@ SHORT WINAPI NtUserGetAsyncKeyState( INT key )
 
     check_for_events( QS_INPUT );
 
+    /* the server needs to clear the "pressed since last call" bit */
+    if (get_shared_desktop( &desktop ) && !(desktop.keystate[key] & 0x40))
+        return (desktop.keystate[key] & 0x80) ? 0x8000 : 0;
+
     if (key_state_info && !(key_state_info->state[key] & 0xc0) &&
         key_state_info->counter == counter && NtGetTickCount() - key_state_info->time < 50)
     {
@@ -817,6 +886,7 @@ SHORT WINAPI NtUserGetAsyncKeyState( INT key )
  */
 DWORD WINAPI NtUserGetQueueStatus( UINT flags )
 {
+    struct queue_shm queue;
     DWORD ret;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
@@ -827,6 +897,10 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* nothing to clear, no need to ask the server */
+    if (get_shared_queue( &queue, FALSE ) && !(queue.changed_bits & flags))
+        return MAKELONG( 0, queue.wake_bits & flags );
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -842,10 +916,13 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
  */
 DWORD get_input_state(void)
 {
+    struct queue_shm queue;
     DWORD ret;
 
     check_for_events( QS_INPUT );
 
+    if (get_shared_queue( &queue, FALSE )) return queue.wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
@@ -919,7 +996,24 @@ HKL WINAPI NtUserGetKeyboardLayout( DWORD thread_id )
  */
 SHORT WINAPI NtUserGetKeyState( INT vkey )
 {
+    struct desktop_shm desktop;
+    struct input_shm input;
     SHORT retval = 0;
+    UINT offset;
+
+    /* the server would first copy the keys that changed on the desktop since
+     * the last synchronization, if the keystate isn't locked by a pending
+     * input message; we can only use the shared state if there are none */
+    if (vkey >= 0 && get_shared_input( &input, &offset, TRUE ) &&
+        (input.keystate_lock ||
+         (read_user_shm( input.desktop, input.desktop_id, &desktop, sizeof(desktop) ) &&
+          !memcmp( input.desktop_keystate, desktop.keystate, sizeof(desktop.keystate) ) &&
+          is_user_shm_unchanged( offset, &input ))))
+    {
+        retval = (signed char)(input.keystate[vkey & 0xff] & 0x81);
+        TRACE("key (0x%x) -> %x\n", vkey, retval);
+        return retval;
+    }
 
     SERVER_START_REQ( get_key_state )
     {
@@ -936,11 +1030,18 @@ SHORT WINAPI NtUserGetKeyState( INT vkey )
  */
 BOOL WINAPI NtUserGetKeyboardState( BYTE *state )
 {
+    struct input_shm input;
+    UINT i, offset;
     BOOL ret;
-    UINT i;
 
     TRACE("(%p)\n", state);
 
+    if (get_shared_input( &input, &offset, TRUE ))
+    {
+        for (i = 0; i < 256; i++) state[i] = input.keystate[i] & 0x81;
+        return TRUE;
+    }
+
     memset( state, 0, 256 );
     SERVER_START_REQ( get_key_state )
     {
@@ -1778,6 +1778,36 @@ static BOOL process_hardware_message( MSG *msg, UINT hw_id, const struct hardwar
     return ret;
 }
 
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check in the user shared memory whether a get_message request for the
+ * thread messages would find nothing and leave the queue state unchanged.
+ */
+static BOOL is_queue_empty( UINT first, UINT last, UINT flags, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    UINT filter = flags >> 16, clear_bits = 0;
+    struct queue_shm queue;
+
+    /* the server uses the time of the last call to detect hung queues */
+    if (NtGetTickCount() - thread_info->last_getmsg_time >= 3000) return FALSE;
+    if (!get_shared_queue( &queue, FALSE )) return FALSE;
+
+    if (!filter) filter = QS_ALLINPUT;
+    if (filter & QS_POSTMESSAGE)
+    {
+        clear_bits |= QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER;
+        if (first == 0 && last == ~0U) clear_bits |= QS_ALLPOSTMESSAGE;
+    }
+    if (filter & QS_INPUT) clear_bits |= QS_INPUT;
+    if (filter & QS_PAINT) clear_bits |= QS_PAINT;
+
+    return !(queue.wake_bits & (filter | QS_SENDMESSAGE)) && !(queue.changed_bits & clear_bits) &&
+           queue.wake_mask == (changed_mask & (QS_SENDMESSAGE | QS_SMRESULT)) &&
+           queue.changed_mask == changed_mask;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -1795,11 +1825,19 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     void *buffer;
     size_t buffer_size = 1024;
 
-    if (!(buffer = malloc( buffer_size ))) return -1;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    /* window filters are validated by the server */
+    if (!hwnd && is_queue_empty( first, last, flags, changed_mask ))
+    {
+        thread_info->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
+        thread_info->changed_mask = changed_mask;
+        return 0;
+    }
+
+    if (!(buffer = malloc( buffer_size ))) return -1;
+
     for (;;)
     {
         NTSTATUS res;
@@ -1808,6 +1846,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
         BOOL needs_unpack = FALSE;
 
         thread_info->client_info.msg_source = prev_source;
+        thread_info->last_getmsg_time = NtGetTickCount();
 
         SERVER_START_REQ( get_message )
         {
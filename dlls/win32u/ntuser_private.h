@@ -134,6 +134,9 @@ struct user_thread_info
     UINT                          kbd_layout_id;          /* Current keyboard layout ID */
     struct rawinput_thread_data  *rawinput;               /* RawInput thread local data / buffer */
     UINT                          spy_indent;             /* Current spy indent */
+    UINT                          queue_shm;              /* Offset of the queue in the user shared memory */
+    UINT                          queue_shm_id;           /* Id of the queue in the user shared memory */
+    DWORD                         last_getmsg_time;       /* Time of the last get_message server call */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
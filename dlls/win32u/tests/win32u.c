@@ -231,7 +231,7 @@ static BOOL WINAPI count_win( HWND hwnd, LPARAM lparam )
 static void test_NtUserBuildHwndList(void)
 {
     ULONG size, desktop_windows_cnt;
-    HWND buf[512], hwnd;
+    HWND buf[512], hwnd, child;
     NTSTATUS status;
 
     size = 0;
@@ -294,6 +294,28 @@ static void test_NtUserBuildHwndList(void)
     ok( status == STATUS_INVALID_HANDLE, "NtUserBuildHwndList failed: %#lx\n", status );
     ok( size == 0xdeadbeef, "size = %lu\n", size );
 
+    child = CreateWindowExA( 0, "static", NULL, WS_CHILD, 0,0,0,0,hwnd,0,0, NULL );
+
+    size = 0;
+    status = NtUserBuildHwndList( 0, hwnd, TRUE, FALSE, 0, ARRAYSIZE(buf), buf, &size );
+    ok( !status, "NtUserBuildHwndList failed: %#lx\n", status );
+    ok( size == 2, "size = %lu\n", size );
+    ok( buf[0] == child, "buf[0] = %p\n", buf[0] );
+    ok( buf[1] == HWND_BOTTOM, "buf[1] = %p\n", buf[1] );
+
+    size = 0;
+    status = NtUserBuildHwndList( 0, hwnd, TRUE, FALSE, 0, 1, buf, &size );
+    ok( status == STATUS_BUFFER_TOO_SMALL, "NtUserBuildHwndList failed: %#lx\n", status );
+    ok( size == 2, "size = %lu\n", size );
+
+    DestroyWindow( child );
+
+    size = 0;
+    status = NtUserBuildHwndList( 0, hwnd, TRUE, FALSE, 0, ARRAYSIZE(buf), buf, &size );
+    ok( !status, "NtUserBuildHwndList failed: %#lx\n", status );
+    ok( size == 1, "size = %lu\n", size );
+    ok( buf[0] == HWND_BOTTOM, "buf[0] = %p\n", buf[0] );
+
     DestroyWindow( hwnd );
 }
 
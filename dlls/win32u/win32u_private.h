@@ -271,6 +271,7 @@ extern HWND get_capture(void) DECLSPEC_HIDDEN;
 extern BOOL get_cursor_pos( POINT *pt ) DECLSPEC_HIDDEN;
 extern HWND get_focus(void) DECLSPEC_HIDDEN;
 extern DWORD get_input_state(void) DECLSPEC_HIDDEN;
+extern BOOL get_shared_queue( struct queue_shm *queue, BOOL create ) DECLSPEC_HIDDEN;
 extern HWND get_progman_window(void) DECLSPEC_HIDDEN;
 extern HWND get_shell_window(void) DECLSPEC_HIDDEN;
 extern HWND get_taskman_window(void) DECLSPEC_HIDDEN;
@@ -420,6 +421,8 @@ extern void wrappers_init( unixlib_handle_t handle ) DECLSPEC_HIDDEN;
 extern void gdi_init(void) DECLSPEC_HIDDEN;
 extern NTSTATUS callbacks_init( void *args ) DECLSPEC_HIDDEN;
 extern void winstation_init(void) DECLSPEC_HIDDEN;
+extern BOOL read_user_shm( UINT offset, UINT id, void *data, SIZE_T size ) DECLSPEC_HIDDEN;
+extern BOOL is_user_shm_unchanged( UINT offset, const void *data ) DECLSPEC_HIDDEN;
 extern void sysparams_init(void) DECLSPEC_HIDDEN;
 extern int muldiv( int a, int b, int c ) DECLSPEC_HIDDEN;
 
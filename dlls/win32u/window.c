@@ -24,6 +24,7 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -163,6 +164,38 @@ static WND *next_thread_window_ptr( HWND *hwnd )
     return NULL;
 }
 
+/***********************************************************************
+ *           get_shared_window
+ *
+ * Read the state of a window from the memory shared with the server.
+ * Returns FALSE if the window isn't mirrored there, in which case the
+ * server has to be queried instead.
+ */
+static BOOL get_shared_window( HWND hwnd, struct window_shm *info )
+{
+    struct user_handle_shm entry;
+    UINT index = USER_HANDLE_TO_INDEX( hwnd );
+
+    if (index >= NB_USER_HANDLES) return FALSE;
+    if (!read_user_shm( USER_SHM_HANDLES_OFFSET + index * sizeof(entry), 0, &entry, sizeof(entry) ))
+        return FALSE;
+    if (!entry.hdr.id) return FALSE;
+    if (HIWORD(hwnd) && HIWORD(hwnd) != 0xffff && entry.hdr.id != wine_server_user_handle( hwnd ))
+        return FALSE;
+    if (!read_user_shm( entry.offset, entry.id, info, sizeof(*info) )) return FALSE;
+    return info->handle == entry.hdr.id;
+}
+
+/* get the per-monitor DPI of a window from the shared memory, same as the server does */
+static UINT get_shared_monitor_dpi( const struct window_shm *info )
+{
+    struct window_shm parent = *info;
+
+    while (parent.parent)
+        if (!get_shared_window( wine_server_ptr_handle( parent.parent ), &parent )) return 0;
+    return parent.dpi ? parent.dpi : USER_DEFAULT_SCREEN_DPI;
+}
+
 /*******************************************************************
  *           get_hwnd_message_parent
  *
@@ -205,6 +238,10 @@ HWND get_full_window_handle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        struct window_shm info;
+
+        if (get_shared_window( hwnd, &info )) return wine_server_ptr_handle( info.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -290,6 +327,7 @@ HWND is_current_process_window( HWND hwnd )
 /* see IsWindow */
 BOOL is_window( HWND hwnd )
 {
+    struct window_shm info;
     WND *win;
     BOOL ret;
 
@@ -303,6 +341,8 @@ BOOL is_window( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -315,6 +355,7 @@ BOOL is_window( HWND hwnd )
 /* see GetWindowThreadProcessId */
 DWORD get_window_thread( HWND hwnd, DWORD *process )
 {
+    struct window_shm info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -334,6 +375,12 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
     }
 
     /* check other processes */
+    if (get_shared_window( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -361,7 +408,17 @@ HWND get_parent( HWND hwnd )
     if (win == WND_DESKTOP) return 0;
     if (win == WND_OTHER_PROCESS)
     {
-        LONG style = get_window_long( hwnd, GWL_STYLE );
+        struct window_shm info;
+        LONG style;
+
+        if (get_shared_window( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) retval = wine_server_ptr_handle( info.owner );
+            else if (info.style & WS_CHILD) retval = wine_server_ptr_handle( info.parent );
+            return retval;
+        }
+
+        style = get_window_long( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -502,6 +559,11 @@ HWND get_window_relative( HWND hwnd, UINT rel )
             release_win_ptr( win );
             return retval;
         }
+        else
+        {
+            struct window_shm info;
+            if (get_shared_window( hwnd, &info )) return wine_server_ptr_handle( info.owner );
+        }
         /* else fall through to server call */
     }
 
@@ -545,6 +607,7 @@ HWND get_window_relative( HWND hwnd, UINT rel )
  */
 static HWND *list_window_parents( HWND hwnd )
 {
+    struct window_shm info;
     WND *win;
     HWND current, *list;
     int i, pos = 0, size = 16, count;
@@ -575,7 +638,25 @@ static HWND *list_window_parents( HWND hwnd )
         }
     }
 
-    /* at least one parent belongs to another process, have to query the server */
+    /* at least one parent belongs to another process, try the shared memory */
+
+    for (pos = 0, current = hwnd; get_shared_window( current, &info ); current = list[pos++])
+    {
+        if (pos == size)
+        {
+            HWND *new_list = realloc( list, (size + 16) * sizeof(HWND) );
+            if (!new_list) goto empty;
+            list = new_list;
+            size += 16;
+        }
+        if (!(list[pos] = wine_server_ptr_handle( info.parent )))
+        {
+            if (!pos) goto empty;
+            return list;
+        }
+    }
+
+    /* some windows are not mirrored, have to query the server */
 
     for (;;)
     {
@@ -606,6 +687,59 @@ empty:
     return NULL;
 }
 
+/* last list of children returned by the server, valid as long as the z-order generation of the parent */
+static pthread_mutex_t children_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct
+{
+    user_handle_t parent;      /* parent window */
+    UINT          id;          /* id of the parent in the shared memory */
+    UINT          zorder_gen;  /* z-order generation of the parent when the list was retrieved */
+    DWORD         tid;         /* thread the children were filtered with */
+    int           count;       /* number of children */
+    HWND         *list;        /* children handles */
+} children_cache;
+
+static BOOL get_cached_children( const struct window_shm *info, DWORD tid, HWND **list )
+{
+    BOOL ret = FALSE;
+
+    pthread_mutex_lock( &children_cache_lock );
+    if (children_cache.parent == info->handle && children_cache.id == info->hdr.id &&
+        children_cache.zorder_gen == info->zorder_gen && children_cache.tid == tid)
+    {
+        *list = NULL;
+        if (!children_cache.count || (*list = malloc( (children_cache.count + 1) * sizeof(HWND) )))
+        {
+            if (*list) memcpy( *list, children_cache.list, (children_cache.count + 1) * sizeof(HWND) );
+            ret = TRUE;
+        }
+    }
+    pthread_mutex_unlock( &children_cache_lock );
+    return ret;
+}
+
+static void set_cached_children( const struct window_shm *info, DWORD tid, const HWND *list, int count )
+{
+    HWND *new_list = NULL;
+
+    if (count && !(new_list = malloc( (count + 1) * sizeof(HWND) ))) return;
+    if (count)
+    {
+        memcpy( new_list, list, count * sizeof(HWND) );
+        new_list[count] = 0;
+    }
+
+    pthread_mutex_lock( &children_cache_lock );
+    free( children_cache.list );
+    children_cache.parent     = info->handle;
+    children_cache.id         = info->hdr.id;
+    children_cache.zorder_gen = info->zorder_gen;
+    children_cache.tid        = tid;
+    children_cache.count      = count;
+    children_cache.list       = new_list;
+    pthread_mutex_unlock( &children_cache_lock );
+}
+
 /*******************************************************************
  *           list_window_children
  *
@@ -614,15 +748,22 @@ empty:
  */
 HWND *list_window_children( HDESK desktop, HWND hwnd, UNICODE_STRING *class, DWORD tid )
 {
+    struct window_shm info;
     HWND *list;
     int i, size = 128;
     ATOM atom = class ? get_int_atom_value( class ) : 0;
+    BOOL cached;
 
     /* empty class is not the same as NULL class */
     if (!atom && class && !class->Length) return NULL;
 
+    /* the children of a window don't change as long as its z-order generation stays the same */
+    cached = !desktop && hwnd && !class && get_shared_window( hwnd, &info );
+    if (cached && get_cached_children( &info, tid, &list )) return list;
+
     for (;;)
     {
+        NTSTATUS status;
         int count = 0;
 
         if (!(list = malloc( size * sizeof(HWND) ))) break;
@@ -635,7 +776,7 @@ HWND *list_window_children( HDESK desktop, HWND hwnd, UNICODE_STRING *class, DWO
             req->atom = atom;
             if (!atom && class) wine_server_add_data( req, class->Buffer, class->Length );
             wine_server_set_reply( req, list, (size-1) * sizeof(user_handle_t) );
-            if (!wine_server_call( req )) count = reply->count;
+            if (!(status = wine_server_call( req ))) count = reply->count;
         }
         SERVER_END_REQ;
         if (count && count < size)
@@ -644,10 +785,16 @@ HWND *list_window_children( HDESK desktop, HWND hwnd, UNICODE_STRING *class, DWO
             for (i = count - 1; i >= 0; i--)
                 list[i] = wine_server_ptr_handle( ((user_handle_t *)list)[i] );
             list[count] = 0;
+            if (cached) set_cached_children( &info, tid, list, count );
             return list;
         }
         free( list );
-        if (!count) break;
+        if (!count)
+        {
+            /* only remember the lack of children, not a failure */
+            if (cached && !status) set_cached_children( &info, tid, NULL, 0 );
+            break;
+        }
         size = count + 1;  /* restart with a large enough buffer */
     }
     return NULL;
@@ -658,6 +805,7 @@ HWND *list_window_children( HDESK desktop, HWND hwnd, UNICODE_STRING *class, DWO
  */
 HWND WINAPI NtUserGetAncestor( HWND hwnd, UINT type )
 {
+    struct window_shm info;
     HWND *list, ret = 0;
     WND *win;
 
@@ -675,6 +823,10 @@ HWND WINAPI NtUserGetAncestor( HWND hwnd, UINT type )
             ret = win->parent;
             release_win_ptr( win );
         }
+        else if (get_shared_window( hwnd, &info ))
+        {
+            ret = wine_server_ptr_handle( info.parent );
+        }
         else /* need to query the server */
         {
             SERVER_START_REQ( get_window_tree )
@@ -787,6 +939,7 @@ BOOL is_window_drawable( HWND hwnd, BOOL icon )
 /* see IsWindowUnicode */
 BOOL is_window_unicode( HWND hwnd )
 {
+    struct window_shm info;
     WND *win;
     BOOL ret = FALSE;
 
@@ -799,6 +952,10 @@ BOOL is_window_unicode( HWND hwnd )
         ret = (win->flags & WIN_ISUNICODE) != 0;
         release_win_ptr( win );
     }
+    else if (get_shared_window( hwnd, &info ))
+    {
+        ret = info.is_unicode;
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -860,6 +1017,7 @@ BOOL is_window_enabled( HWND hwnd )
 DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
 {
     DPI_AWARENESS_CONTEXT ret = 0;
+    struct window_shm info;
     WND *win;
 
     if (!(win = get_win_ptr( hwnd )))
@@ -873,6 +1031,10 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
         ret = ULongToHandle( win->dpi_awareness | 0x10 );
         release_win_ptr( win );
     }
+    else if (get_shared_window( hwnd, &info ))
+    {
+        ret = ULongToHandle( info.awareness | 0x10 );
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -888,6 +1050,7 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
 /* see GetDpiForWindow */
 UINT get_dpi_for_window( HWND hwnd )
 {
+    struct window_shm info;
     WND *win;
     UINT ret = 0;
 
@@ -907,7 +1070,8 @@ UINT get_dpi_for_window( HWND hwnd )
         if (!ret) ret = get_win_monitor_dpi( hwnd );
         release_win_ptr( win );
     }
-    else
+    else if (!get_shared_window( hwnd, &info ) ||
+             !(ret = info.dpi ? info.dpi : get_shared_monitor_dpi( &info )))
     {
         SERVER_START_REQ( get_window_info )
         {
@@ -1013,11 +1177,16 @@ static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ans
 
     if (win == WND_OTHER_PROCESS)
     {
+        struct window_shm info;
+
         if (offset == GWLP_WNDPROC)
         {
             RtlSetLastWin32Error( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && get_shared_window( hwnd, &info ))
+            return offset == GWL_STYLE ? info.style : info.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1531,6 +1700,89 @@ static void mirror_rect( const RECT *window_rect, RECT *rect )
     rect->right = width - tmp;
 }
 
+static RECT rect_from_shm( const rectangle_t *rect )
+{
+    RECT ret = { rect->left, rect->top, rect->right, rect->bottom };
+    return ret;
+}
+
+/***********************************************************************
+ *           get_shared_window_rects
+ *
+ * Get the window and client rectangles of a window from the shared memory,
+ * the same way the get_window_rectangles request would.
+ */
+static BOOL get_shared_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
+                                     RECT *client_rect, UINT dpi )
+{
+    struct window_shm info, parent;
+    RECT window, client;
+    UINT window_dpi;
+
+    if (!get_shared_window( hwnd, &info )) return FALSE;
+    window = rect_from_shm( &info.window_rect );
+    client = rect_from_shm( &info.client_rect );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window, -info.client_rect.left, -info.client_rect.top );
+        OffsetRect( &client, -info.client_rect.left, -info.client_rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = rect_from_shm( &info.client_rect );
+            mirror_rect( &rect, &window );
+        }
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &window, -info.window_rect.left, -info.window_rect.top );
+        OffsetRect( &client, -info.window_rect.left, -info.window_rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = rect_from_shm( &info.window_rect );
+            mirror_rect( &rect, &client );
+        }
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            RECT rect = rect_from_shm( &parent.client_rect );
+            mirror_rect( &rect, &window );
+            mirror_rect( &rect, &client );
+        }
+        break;
+    case COORDS_SCREEN:
+        parent = info;
+        while (parent.parent)
+        {
+            if (!get_shared_window( wine_server_ptr_handle( parent.parent ), &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window, parent.client_rect.left, parent.client_rect.top );
+            OffsetRect( &client, parent.client_rect.left, parent.client_rect.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+
+    /* the server scales with a different rounding, let it do the work if needed */
+    window_dpi = info.dpi;
+    if (!window_dpi || !dpi)
+    {
+        UINT monitor_dpi = get_shared_monitor_dpi( &info );
+        if (!monitor_dpi) return FALSE;
+        if (!window_dpi) window_dpi = monitor_dpi;
+        if (!dpi) dpi = monitor_dpi;
+    }
+    if (window_dpi != dpi) return FALSE;
+
+    if (window_rect) *window_rect = window;
+    if (client_rect) *client_rect = client;
+    return TRUE;
+}
+
 /***********************************************************************
  *           get_window_rects
  *
@@ -1641,6 +1893,8 @@ BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_re
     }
 
 other_process:
+    if (get_shared_window_rects( hwnd, relative, window_rect, client_rect, dpi )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2602,16 +2856,35 @@ BOOL WINAPI NtUserSetWindowPlacement( HWND hwnd, const WINDOWPLACEMENT *wpl )
 /*****************************************************************************
  *           NtUserBuildHwndList (win32u.@)
  */
-NTSTATUS WINAPI NtUserBuildHwndList( HDESK desktop, ULONG unk2, ULONG unk3, ULONG unk4,
+NTSTATUS WINAPI NtUserBuildHwndList( HDESK desktop, HWND hwnd, ULONG unk3, ULONG unk4,
                                      ULONG thread_id, ULONG count, HWND *buffer, ULONG *size )
 {
     user_handle_t *list = (user_handle_t *)buffer;
+    struct window_shm info;
+    HWND *children;
+    BOOL cached;
     int i;
     NTSTATUS status;
 
+    /* the children of a mirrored window may be available without a server call */
+    cached = !desktop && hwnd && get_shared_window( hwnd, &info );
+    if (cached && get_cached_children( &info, thread_id, &children ))
+    {
+        for (i = 0; children && children[i]; i++);
+        *size = i + 1;
+        if (*size <= count)
+        {
+            if (i) memcpy( buffer, children, i * sizeof(HWND) );
+            buffer[i] = HWND_BOTTOM;
+        }
+        free( children );
+        return *size > count ? STATUS_BUFFER_TOO_SMALL : STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( get_window_children )
     {
         req->desktop = wine_server_obj_handle( desktop );
+        req->parent = wine_server_user_handle( hwnd );
         req->tid = thread_id;
         if (count) wine_server_set_reply( req, list, (count - 1) * sizeof(user_handle_t) );
         status = wine_server_call( req );
@@ -2625,6 +2898,7 @@ NTSTATUS WINAPI NtUserBuildHwndList( HDESK desktop, ULONG unk2, ULONG unk3, ULON
     for (i = *size - 2; i >= 0; i--)
         buffer[i] = wine_server_ptr_handle( list[i] );
     buffer[*size - 1] = HWND_BOTTOM;
+    if (cached) set_cached_children( &info, thread_id, buffer, *size - 1 );
     return STATUS_SUCCESS;
 }
 
@@ -25,6 +25,7 @@
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include <stdarg.h>
+#include <pthread.h>
 #include "windef.h"
 #include "winbase.h"
 #include "ntuser.h"
@@ -37,6 +38,8 @@
 WINE_DEFAULT_DEBUG_CHANNEL(winstation);
 WINE_DECLARE_DEBUG_CHANNEL(win);
 
+static const char *user_shm;  /* input state mirrored by the server */
+
 
 #define DESKTOP_ALL_ACCESS 0x01ff
 
@@ -634,3 +637,70 @@ void winstation_init(void)
     NtClose( dir );
     free( buffer );
 }
+
+/***********************************************************************
+ *           map_user_shm
+ */
+static void map_user_shm(void)
+{
+    static const WCHAR nameW[] = {'\\','K','e','r','n','e','l','O','b','j','e','c','t','s',
+                                  '\\','_','_','w','i','n','e','_','u','s','e','r','_','s','h','m',0};
+    UNICODE_STRING name = RTL_CONSTANT_STRING( nameW );
+    OBJECT_ATTRIBUTES attr;
+    HANDLE section;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+
+    InitializeObjectAttributes( &attr, &name, 0, NULL, NULL );
+    if (NtOpenSection( &section, SECTION_MAP_READ, &attr )) return;
+    if (!NtMapViewOfSection( section, GetCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                             ViewShare, 0, PAGE_READONLY ))
+        user_shm = ptr;
+    NtClose( section );
+    TRACE( "user shared memory %s\n", user_shm ? "mapped" : "unavailable" );
+}
+
+/***********************************************************************
+ *           read_user_shm
+ *
+ * Copy an object from the memory shared with the server, and check that it
+ * is still the object with the given id, or any object if id is 0. The
+ * server bumps the sequence number before and after every change, so retry
+ * until we got a copy that was not being modified.
+ */
+BOOL read_user_shm( UINT offset, UINT id, void *data, SIZE_T size )
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+    const struct user_shm_header *hdr;
+    LONG seq;
+
+    pthread_once( &init_once, map_user_shm );
+    if (!user_shm || !offset || offset > USER_SHM_SIZE - size) return FALSE;
+
+    hdr = (const struct user_shm_header *)(user_shm + offset);
+    for (;;)
+    {
+        if ((seq = ReadAcquire( (const LONG *)&hdr->seq )) & 1)
+        {
+            YieldProcessor();
+            continue;
+        }
+        memcpy( data, hdr, size );
+        MemoryBarrier();
+        if (ReadNoFence( (const LONG *)&hdr->seq ) == seq) break;
+    }
+    return !id || ((const struct user_shm_header *)data)->id == id;
+}
+
+/***********************************************************************
+ *           is_user_shm_unchanged
+ *
+ * Check that an object was not modified since it was copied with read_user_shm.
+ */
+BOOL is_user_shm_unchanged( UINT offset, const void *data )
+{
+    const struct user_shm_header *hdr = (const struct user_shm_header *)(user_shm + offset);
+
+    MemoryBarrier();
+    return ReadNoFence( (const LONG *)&hdr->seq ) == ((const struct user_shm_header *)data)->seq;
+}
@@ -1185,7 +1185,7 @@ NTSTATUS WINAPI wow64_NtUserBeginPaint( UINT *args )
 NTSTATUS WINAPI wow64_NtUserBuildHwndList( UINT *args )
 {
     HDESK desktop = get_handle( &args );
-    ULONG unk2 = get_ulong( &args );
+    HWND hwnd = get_handle( &args );
     ULONG unk3 = get_ulong( &args );
     ULONG unk4 = get_ulong( &args );
     ULONG thread_id = get_ulong( &args );
@@ -1199,7 +1199,7 @@ NTSTATUS WINAPI wow64_NtUserBuildHwndList( UINT *args )
 
     if (!(buffer = Wow64AllocateTemp( count * sizeof(*buffer) ))) return STATUS_NO_MEMORY;
 
-    if ((status = NtUserBuildHwndList( desktop, unk2, unk3, unk4, thread_id, count, buffer, size )))
+    if ((status = NtUserBuildHwndList( desktop, hwnd, unk3, unk4, thread_id, count, buffer, size )))
         return status;
 
     for (i = 0; i < *size; i++)
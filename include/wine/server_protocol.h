@@ -850,6 +850,167 @@ typedef struct
 } cursor_pos_t;
 
 
+struct fast_sync_slot
+{
+    int            state;
+    unsigned int   serial;
+    unsigned int   type;
+    unsigned int   max;
+    int            waiters;
+    int            __pad[3];
+};
+
+#define FAST_SYNC_AUTO_EVENT   1
+#define FAST_SYNC_MANUAL_EVENT 2
+#define FAST_SYNC_SEMAPHORE    3
+#define FAST_SYNC_SOCKET       4
+
+#define FAST_SYNC_SOCKET_RECV       0x01
+#define FAST_SYNC_SOCKET_SEND       0x02
+#define FAST_SYNC_SOCKET_POLL       0x04
+#define FAST_SYNC_SOCKET_STREAM     0x08
+#define FAST_SYNC_SOCKET_LISTENING  0x10
+#define FAST_SYNC_SOCKET_CONNECTED  0x20
+#define FAST_SYNC_SOCKET_COMPLETION 0x40
+#define FAST_SYNC_MAX_SLOTS    16384
+
+
+struct request_shm
+{
+    int            state;
+    data_size_t    size;
+    int            __pad[14];
+
+};
+#define REQUEST_SHM_IDLE    0
+#define REQUEST_SHM_PENDING 1
+#define REQUEST_SHM_WAITING 2
+#define REQUEST_SHM_REPLY   3
+#define REQUEST_SHM_CLOSED  4
+#define REQUEST_SHM_SIZE    0x10000
+
+
+struct handle_shm_entry
+{
+    unsigned int   generation;
+};
+#define HANDLE_SHM_MAX_ENTRIES 65536
+
+
+struct user_shm_header
+{
+    unsigned int   seq;
+    unsigned int   id;
+};
+
+
+struct desktop_shm
+{
+    struct user_shm_header hdr;
+    int            cursor_x;
+    int            cursor_y;
+    unsigned int   cursor_last_change;
+    unsigned int   __pad;
+    unsigned char  keystate[256];
+};
+
+
+struct input_shm
+{
+    struct user_shm_header hdr;
+    unsigned int   desktop;
+    unsigned int   desktop_id;
+    int            keystate_lock;
+    unsigned int   __pad;
+    unsigned char  keystate[256];
+    unsigned char  desktop_keystate[256];
+};
+
+
+struct queue_shm
+{
+    struct user_shm_header hdr;
+    unsigned int   wake_bits;
+    unsigned int   changed_bits;
+    unsigned int   wake_mask;
+    unsigned int   changed_mask;
+    unsigned int   input;
+    unsigned int   input_id;
+};
+
+
+struct window_shm
+{
+    struct user_shm_header hdr;
+    user_handle_t  handle;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    process_id_t   pid;
+    thread_id_t    tid;
+    unsigned int   style;
+    unsigned int   ex_style;
+    int            is_unicode;
+    unsigned int   dpi;
+    int            awareness;
+    unsigned int   zorder_gen;
+    unsigned int   __pad;
+    rectangle_t    window_rect;
+    rectangle_t    client_rect;
+};
+
+
+struct user_handle_shm
+{
+    struct user_shm_header hdr;
+    unsigned int   offset;
+    unsigned int   id;
+};
+#define USER_SHM_HANDLES_OFFSET 0x40
+#define USER_SHM_MAX_HANDLES    ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+#define USER_SHM_SIZE 0x800000
+
+
+struct import_cache_module
+{
+    unsigned char  file_id[16];
+    unsigned int   timestamp;
+    unsigned int   image_size;
+    unsigned int   checksum;
+    unsigned int   exports;
+};
+
+
+struct import_cache_entry
+{
+    unsigned int   next;
+    unsigned int   descr;
+    unsigned int   modules;
+    unsigned int   count;
+
+};
+
+
+#define IMPORT_CACHE_BUCKETS     1024
+#define IMPORT_CACHE_MAX_MODULES 16
+#define IMPORT_CACHE_SIZE        0x400000
+struct import_cache_shm
+{
+    unsigned int   size;
+    unsigned int   __pad[15];
+    unsigned int   buckets[IMPORT_CACHE_BUCKETS];
+};
+
+
+struct completion_entry
+{
+    apc_param_t    ckey;
+    apc_param_t    cvalue;
+    apc_param_t    information;
+    unsigned int   status;
+    unsigned int   __pad;
+};
+
+
 
 
 
@@ -992,6 +1153,20 @@ struct init_thread_reply
 
 
 
+struct get_request_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_request_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
 struct terminate_process_request
 {
     struct request_header __header;
@@ -1250,6 +1425,20 @@ struct close_handle_reply
 
 
 
+struct get_handle_table_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_handle_table_shm_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    char __pad_12[4];
+};
+
+
+
 struct set_handle_info_request
 {
     struct request_header __header;
@@ -1569,6 +1758,45 @@ struct query_semaphore_reply
 };
 
 
+struct get_fast_sync_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fast_sync_shm_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    char __pad_12[4];
+};
+
+
+struct get_fast_sync_slot_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fast_sync_slot_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    unsigned int serial;
+    unsigned int access;
+    char __pad_20[4];
+};
+
+
+struct fast_sync_wake_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct fast_sync_wake_reply
+{
+    struct reply_header __header;
+};
+
+
 struct open_semaphore_request
 {
     struct request_header __header;
@@ -2031,6 +2259,21 @@ struct is_same_mapping_reply
 
 
 
+struct add_import_cache_request
+{
+    struct request_header __header;
+    unsigned int hash;
+    unsigned int descr;
+    unsigned int modules;
+    /* VARARG(data,bytes); */
+};
+struct add_import_cache_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct get_mapping_filename_request
 {
     struct request_header __header;
@@ -2692,6 +2935,20 @@ struct get_queue_status_reply
 
 
 
+struct get_queue_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_queue_shm_reply
+{
+    struct reply_header __header;
+    unsigned int offset;
+    unsigned int id;
+};
+
+
+
 struct get_process_idle_event_request
 {
     struct request_header __header;
@@ -5110,6 +5367,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(entries,completion_entries); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5124,6 +5394,56 @@ struct query_completion_reply
 
 
 
+struct create_wait_completion_packet_request
+{
+    struct request_header __header;
+    unsigned int access;
+    /* VARARG(objattr,object_attributes); */
+};
+struct create_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
+struct associate_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    obj_handle_t  completion;
+    obj_handle_t  target;
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    char __pad_52[4];
+};
+struct associate_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    int           signaled;
+    char __pad_12[4];
+};
+
+
+
+struct cancel_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    int           remove_signaled;
+    char __pad_20[4];
+};
+struct cancel_wait_completion_packet_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct set_completion_info_request
 {
     struct request_header __header;
@@ -5513,6 +5833,7 @@ enum request
     REQ_init_process_done,
     REQ_init_first_thread,
     REQ_init_thread,
+    REQ_get_request_shm,
     REQ_terminate_process,
     REQ_terminate_thread,
     REQ_get_process_info,
@@ -5528,6 +5849,7 @@ enum request
     REQ_queue_apc,
     REQ_get_apc_result,
     REQ_close_handle,
+    REQ_get_handle_table_shm,
     REQ_set_handle_info,
     REQ_dup_handle,
     REQ_compare_objects,
@@ -5548,6 +5870,9 @@ enum request
     REQ_create_semaphore,
     REQ_release_semaphore,
     REQ_query_semaphore,
+    REQ_get_fast_sync_shm,
+    REQ_get_fast_sync_slot,
+    REQ_fast_sync_wake,
     REQ_open_semaphore,
     REQ_create_file,
     REQ_open_file_object,
@@ -5575,6 +5900,7 @@ enum request
     REQ_get_mapping_committed_range,
     REQ_add_mapping_committed_range,
     REQ_is_same_mapping,
+    REQ_add_import_cache,
     REQ_get_mapping_filename,
     REQ_list_processes,
     REQ_create_debug_obj,
@@ -5616,6 +5942,7 @@ enum request
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
+    REQ_get_queue_shm,
     REQ_get_process_idle_event,
     REQ_send_message,
     REQ_post_quit_message,
@@ -5758,7 +6085,11 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
+    REQ_create_wait_completion_packet,
+    REQ_associate_wait_completion_packet,
+    REQ_cancel_wait_completion_packet,
     REQ_set_completion_info,
     REQ_add_fd_completion,
     REQ_set_fd_completion_mode,
@@ -5798,6 +6129,7 @@ union generic_request
     struct init_process_done_request init_process_done_request;
     struct init_first_thread_request init_first_thread_request;
     struct init_thread_request init_thread_request;
+    struct get_request_shm_request get_request_shm_request;
     struct terminate_process_request terminate_process_request;
     struct terminate_thread_request terminate_thread_request;
     struct get_process_info_request get_process_info_request;
@@ -5813,6 +6145,7 @@ union generic_request
     struct queue_apc_request queue_apc_request;
     struct get_apc_result_request get_apc_result_request;
     struct close_handle_request close_handle_request;
+    struct get_handle_table_shm_request get_handle_table_shm_request;
     struct set_handle_info_request set_handle_info_request;
     struct dup_handle_request dup_handle_request;
     struct compare_objects_request compare_objects_request;
@@ -5833,6 +6166,9 @@ union generic_request
     struct create_semaphore_request create_semaphore_request;
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
+    struct get_fast_sync_shm_request get_fast_sync_shm_request;
+    struct get_fast_sync_slot_request get_fast_sync_slot_request;
+    struct fast_sync_wake_request fast_sync_wake_request;
     struct open_semaphore_request open_semaphore_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
@@ -5860,6 +6196,7 @@ union generic_request
     struct get_mapping_committed_range_request get_mapping_committed_range_request;
     struct add_mapping_committed_range_request add_mapping_committed_range_request;
     struct is_same_mapping_request is_same_mapping_request;
+    struct add_import_cache_request add_import_cache_request;
     struct get_mapping_filename_request get_mapping_filename_request;
     struct list_processes_request list_processes_request;
     struct create_debug_obj_request create_debug_obj_request;
@@ -5901,6 +6238,7 @@ union generic_request
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
+    struct get_queue_shm_request get_queue_shm_request;
     struct get_process_idle_event_request get_process_idle_event_request;
     struct send_message_request send_message_request;
     struct post_quit_message_request post_quit_message_request;
@@ -6043,7 +6381,11 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
+    struct create_wait_completion_packet_request create_wait_completion_packet_request;
+    struct associate_wait_completion_packet_request associate_wait_completion_packet_request;
+    struct cancel_wait_completion_packet_request cancel_wait_completion_packet_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
     struct set_fd_completion_mode_request set_fd_completion_mode_request;
@@ -6081,6 +6423,7 @@ union generic_reply
     struct init_process_done_reply init_process_done_reply;
     struct init_first_thread_reply init_first_thread_reply;
     struct init_thread_reply init_thread_reply;
+    struct get_request_shm_reply get_request_shm_reply;
     struct terminate_process_reply terminate_process_reply;
     struct terminate_thread_reply terminate_thread_reply;
     struct get_process_info_reply get_process_info_reply;
@@ -6096,6 +6439,7 @@ union generic_reply
     struct queue_apc_reply queue_apc_reply;
     struct get_apc_result_reply get_apc_result_reply;
     struct close_handle_reply close_handle_reply;
+    struct get_handle_table_shm_reply get_handle_table_shm_reply;
     struct set_handle_info_reply set_handle_info_reply;
     struct dup_handle_reply dup_handle_reply;
     struct compare_objects_reply compare_objects_reply;
@@ -6116,6 +6460,9 @@ union generic_reply
     struct create_semaphore_reply create_semaphore_reply;
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
+    struct get_fast_sync_shm_reply get_fast_sync_shm_reply;
+    struct get_fast_sync_slot_reply get_fast_sync_slot_reply;
+    struct fast_sync_wake_reply fast_sync_wake_reply;
     struct open_semaphore_reply open_semaphore_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
@@ -6143,6 +6490,7 @@ union generic_reply
     struct get_mapping_committed_range_reply get_mapping_committed_range_reply;
     struct add_mapping_committed_range_reply add_mapping_committed_range_reply;
     struct is_same_mapping_reply is_same_mapping_reply;
+    struct add_import_cache_reply add_import_cache_reply;
     struct get_mapping_filename_reply get_mapping_filename_reply;
     struct list_processes_reply list_processes_reply;
     struct create_debug_obj_reply create_debug_obj_reply;
@@ -6184,6 +6532,7 @@ union generic_reply
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
+    struct get_queue_shm_reply get_queue_shm_reply;
     struct get_process_idle_event_reply get_process_idle_event_reply;
     struct send_message_reply send_message_reply;
     struct post_quit_message_reply post_quit_message_reply;
@@ -6326,7 +6675,11 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
+    struct create_wait_completion_packet_reply create_wait_completion_packet_reply;
+    struct associate_wait_completion_packet_reply associate_wait_completion_packet_reply;
+    struct cancel_wait_completion_packet_reply cancel_wait_completion_packet_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
     struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
@@ -6356,7 +6709,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 760
+#define SERVER_PROTOCOL_VERSION 773
 
 /* ### protocol_version end ### */
 
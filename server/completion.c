@@ -39,6 +39,7 @@
 #include "object.h"
 #include "file.h"
 #include "handle.h"
+#include "thread.h"
 #include "request.h"
 
 
@@ -98,8 +99,71 @@ struct comp_msg
     apc_param_t   cvalue;
     apc_param_t   information;
     unsigned int  status;
+    struct wait_completion_packet *packet;  /* wait completion packet that queued it */
 };
 
+static const WCHAR wait_completion_packet_name[] = {'W','a','i','t','C','o','m','p','l','e','t','i','o','n','P','a','c','k','e','t'};
+
+struct type_descr wait_completion_packet_type =
+{
+    { wait_completion_packet_name, sizeof(wait_completion_packet_name) },   /* name */
+    WAIT_COMPLETION_PACKET_ALL_ACCESS,                                      /* valid_access */
+    {                                                                       /* mapping */
+        STANDARD_RIGHTS_READ,
+        STANDARD_RIGHTS_WRITE | WAIT_COMPLETION_PACKET_MODIFY_STATE,
+        STANDARD_RIGHTS_EXECUTE,
+        WAIT_COMPLETION_PACKET_ALL_ACCESS
+    },
+};
+
+/* a wait on an object that queues a completion packet to a port once it is satisfied */
+struct wait_completion_packet
+{
+    struct object       obj;
+    struct thread_wait *wait;           /* pending wait on the target object */
+    struct thread      *thread;         /* thread the wait is satisfied for */
+    struct completion  *completion;     /* port the packet is queued to */
+    struct comp_msg    *msg;            /* packet queued to the port and not yet removed */
+    apc_param_t         ckey;           /* completion key */
+    apc_param_t         cvalue;         /* completion value */
+    apc_param_t         information;    /* IO_STATUS_BLOCK Information */
+    unsigned int        status;         /* completion result */
+};
+
+static void wait_completion_packet_dump( struct object *obj, int verbose );
+static void wait_completion_packet_destroy( struct object *obj );
+
+static const struct object_ops wait_completion_packet_ops =
+{
+    sizeof(struct wait_completion_packet), /* size */
+    &wait_completion_packet_type,   /* type */
+    wait_completion_packet_dump,    /* dump */
+    no_add_queue,                   /* add_queue */
+    NULL,                           /* remove_queue */
+    NULL,                           /* signaled */
+    NULL,                           /* satisfied */
+    no_signal,                      /* signal */
+    no_get_fd,                      /* get_fd */
+    default_map_access,             /* map_access */
+    default_get_sd,                 /* get_sd */
+    default_set_sd,                 /* set_sd */
+    default_get_full_name,          /* get_full_name */
+    no_lookup_name,                 /* lookup_name */
+    directory_link_name,            /* link_name */
+    default_unlink_name,            /* unlink_name */
+    no_open_file,                   /* open_file */
+    no_kernel_obj_list,             /* get_kernel_obj_list */
+    no_close_handle,                /* close_handle */
+    wait_completion_packet_destroy  /* destroy */
+};
+
+static void remove_comp_msg( struct completion *completion, struct comp_msg *msg )
+{
+    list_remove( &msg->queue_entry );
+    completion->depth--;
+    if (msg->packet) msg->packet->msg = NULL;
+}
+
 static void completion_destroy( struct object *obj)
 {
     struct completion *completion = (struct completion *) obj;
@@ -107,6 +171,7 @@ static void completion_destroy( struct object *obj)
 
     LIST_FOR_EACH_ENTRY_SAFE( tmp, next, &completion->queue, struct comp_msg, queue_entry )
     {
+        remove_comp_msg( completion, tmp );
         free( tmp );
     }
 }
@@ -149,22 +214,79 @@ struct completion *get_completion_obj( struct process *process, obj_handle_t han
     return (struct completion *) get_handle_obj( process, handle, access, &completion_ops );
 }
 
-void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
-                     unsigned int status, apc_param_t information )
+static struct comp_msg *queue_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                                          unsigned int status, apc_param_t information )
 {
     struct comp_msg *msg = mem_alloc( sizeof( *msg ) );
 
     if (!msg)
-        return;
+        return NULL;
 
     msg->ckey = ckey;
     msg->cvalue = cvalue;
     msg->status = status;
     msg->information = information;
+    msg->packet = NULL;
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
-    wake_up( &completion->obj, 1 );
+    return msg;
+}
+
+void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                     unsigned int status, apc_param_t information )
+{
+    if (queue_completion( completion, ckey, cvalue, status, information ))
+        wake_up( &completion->obj, 1 );
+}
+
+static void wait_completion_packet_dump( struct object *obj, int verbose )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    assert( obj->ops == &wait_completion_packet_ops );
+    fprintf( stderr, "WaitCompletionPacket waiting=%d queued=%d\n", !!packet->wait, !!packet->msg );
+}
+
+/* drop the association of a packet with its port and thread */
+static void reset_wait_completion_packet( struct wait_completion_packet *packet )
+{
+    if (packet->wait) unregister_wait( packet->wait );
+    packet->wait = NULL;
+    if (packet->msg) packet->msg->packet = NULL;
+    packet->msg = NULL;
+    if (packet->completion) release_object( packet->completion );
+    packet->completion = NULL;
+    if (packet->thread) release_object( packet->thread );
+    packet->thread = NULL;
+}
+
+static void wait_completion_packet_destroy( struct object *obj )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    assert( obj->ops == &wait_completion_packet_ops );
+    reset_wait_completion_packet( packet );
+}
+
+/* the target object of a packet has been signaled, queue the packet to the port */
+static void wait_completion_packet_satisfied( void *private, unsigned int status )
+{
+    struct wait_completion_packet *packet = private;
+
+    packet->wait = NULL;
+    if ((packet->msg = queue_completion( packet->completion, packet->ckey, packet->cvalue,
+                                         packet->status, packet->information )))
+    {
+        packet->msg->packet = packet;
+        wake_up( &packet->completion->obj, 1 );
+    }
+}
+
+static struct wait_completion_packet *get_wait_completion_packet_obj( struct process *process, obj_handle_t handle,
+                                                                      unsigned int access )
+{
+    return (struct wait_completion_packet *)get_handle_obj( process, handle, access, &wait_completion_packet_ops );
 }
 
 /* create a completion */
@@ -223,9 +345,8 @@ DECL_HANDLER(remove_completion)
         set_error( STATUS_PENDING );
     else
     {
-        list_remove( entry );
-        completion->depth--;
         msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+        remove_comp_msg( completion, msg );
         reply->ckey = msg->ckey;
         reply->cvalue = msg->cvalue;
         reply->status = msg->status;
@@ -236,6 +357,37 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+/* get multiple completions from completion port queue */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_entry *entries;
+    struct comp_msg *msg;
+    data_size_t i, count;
+
+    if (!completion) return;
+
+    count = min( completion->depth, get_reply_max_size() / sizeof(*entries) );
+    if (!count)
+        set_error( STATUS_PENDING );
+    else if ((entries = set_reply_data_size( count * sizeof(*entries) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            msg = LIST_ENTRY( list_head( &completion->queue ), struct comp_msg, queue_entry );
+            remove_comp_msg( completion, msg );
+            entries[i].ckey        = msg->ckey;
+            entries[i].cvalue      = msg->cvalue;
+            entries[i].information = msg->information;
+            entries[i].status      = msg->status;
+            entries[i].__pad       = 0;
+            free( msg );
+        }
+    }
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -247,3 +399,100 @@ DECL_HANDLER(query_completion)
 
     release_object( completion );
 }
+
+/* create a wait completion packet */
+DECL_HANDLER(create_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct unicode_str name;
+    struct object *root;
+    const struct security_descriptor *sd;
+    const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, &root );
+
+    if (!objattr) return;
+
+    if ((packet = create_named_object( root, &wait_completion_packet_ops, &name, objattr->attributes, sd )))
+    {
+        if (get_error() != STATUS_OBJECT_NAME_EXISTS)
+        {
+            packet->wait        = NULL;
+            packet->thread      = NULL;
+            packet->completion  = NULL;
+            packet->msg         = NULL;
+        }
+        reply->handle = alloc_handle( current->process, packet, req->access, objattr->attributes );
+        release_object( packet );
+    }
+
+    if (root) release_object( root );
+}
+
+/* wait for an object and queue a packet to a completion port once it is signaled */
+DECL_HANDLER(associate_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct completion *completion;
+    struct object *obj;
+
+    if (!(packet = get_wait_completion_packet_obj( current->process, req->packet,
+                                                     WAIT_COMPLETION_PACKET_MODIFY_STATE ))) return;
+
+    if (packet->wait || packet->msg)
+    {
+        set_error( STATUS_INVALID_PARAMETER_1 );
+        release_object( packet );
+        return;
+    }
+    if (!(completion = get_completion_obj( current->process, req->completion, IO_COMPLETION_MODIFY_STATE )))
+    {
+        release_object( packet );
+        return;
+    }
+    if (!(obj = get_handle_obj( current->process, req->target, SYNCHRONIZE, NULL )))
+    {
+        release_object( completion );
+        release_object( packet );
+        return;
+    }
+
+    reset_wait_completion_packet( packet );
+    packet->completion  = completion;
+    packet->thread      = (struct thread *)grab_object( current );
+    packet->ckey        = req->ckey;
+    packet->cvalue      = req->cvalue;
+    packet->information = req->information;
+    packet->status      = req->status;
+
+    if (!register_wait( current, obj, wait_completion_packet_satisfied, packet, &packet->wait ))
+        reset_wait_completion_packet( packet );
+    else
+        reply->signaled = !packet->wait;
+
+    release_object( obj );
+    release_object( packet );
+}
+
+/* cancel the wait of a wait completion packet */
+DECL_HANDLER(cancel_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct comp_msg *msg;
+
+    if (!(packet = get_wait_completion_packet_obj( current->process, req->packet,
+                                                     WAIT_COMPLETION_PACKET_MODIFY_STATE ))) return;
+
+    if (packet->wait)
+        reset_wait_completion_packet( packet );
+    else if ((msg = packet->msg) && req->remove_signaled)
+    {
+        remove_comp_msg( packet->completion, msg );
+        free( msg );
+        reset_wait_completion_packet( packet );
+    }
+    else if (packet->msg)
+        set_error( STATUS_PENDING );
+    else
+        set_error( STATUS_CANCELLED );
+
+    release_object( packet );
+}
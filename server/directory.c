@@ -158,6 +158,7 @@ static struct type_descr *types[] =
     &desktop_type,
     &device_type,
     &completion_type,
+    &wait_completion_packet_type,
     &file_type,
     &mapping_type,
     &key_type,
@@ -183,7 +184,11 @@ static struct object_type *create_object_type( struct object *root, unsigned int
 
 static void directory_dump( struct object *obj, int verbose )
 {
-    fputs( "Directory\n", stderr );
+    struct directory *dir = (struct directory *)obj;
+
+    fputs( "Directory", stderr );
+    if (verbose && dir->entries) dump_namespace( dir->entries );
+    fputc( '\n', stderr );
 }
 
 static struct object *directory_lookup_name( struct object *obj, struct unicode_str *name,
@@ -245,7 +250,7 @@ static void directory_destroy( struct object *obj )
 {
     struct directory *dir = (struct directory *)obj;
     assert( obj->ops == &directory_ops );
-    free( dir->entries );
+    free_namespace( dir->entries );
 }
 
 static struct directory *create_directory( struct object *root, const struct unicode_str *name,
@@ -439,8 +444,12 @@ void init_directories( struct fd *intl_fd )
     /* mappings */
     static const WCHAR intlW[] = {'N','l','s','S','e','c','t','i','o','n','L','A','N','G','_','I','N','T','L'};
     static const WCHAR user_dataW[] = {'_','_','w','i','n','e','_','u','s','e','r','_','s','h','a','r','e','d','_','d','a','t','a'};
+    static const WCHAR user_shmW[] = {'_','_','w','i','n','e','_','u','s','e','r','_','s','h','m'};
+    static const WCHAR import_cacheW[] = {'_','_','w','i','n','e','_','i','m','p','o','r','t','_','c','a','c','h','e'};
     static const struct unicode_str intl_str = {intlW, sizeof(intlW)};
     static const struct unicode_str user_data_str = {user_dataW, sizeof(user_dataW)};
+    static const struct unicode_str user_shm_str = {user_shmW, sizeof(user_shmW)};
+    static const struct unicode_str import_cache_str = {import_cacheW, sizeof(import_cacheW)};
 
     struct directory *dir_driver, *dir_device, *dir_global, *dir_kernel, *dir_nls;
     struct object *named_pipe_device, *mailslot_device, *null_device;
@@ -489,6 +498,8 @@ void init_directories( struct fd *intl_fd )
     /* mappings */
     release_object( create_fd_mapping( &dir_nls->obj, &intl_str, intl_fd, OBJ_PERMANENT, NULL ));
     release_object( create_user_data_mapping( &dir_kernel->obj, &user_data_str, OBJ_PERMANENT, NULL ));
+    init_user_shm( &dir_kernel->obj, &user_shm_str );
+    init_import_cache( &dir_kernel->obj, &import_cache_str );
     release_object( intl_fd );
 
     release_object( named_pipe_device );
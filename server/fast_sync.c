@@ -0,0 +1,301 @@
+/*
+ * Server-side support for the fast synchronization path
+ *
+ * Events, semaphores and sockets can keep their state in memory shared
+ * with the process that created them, so that this process can signal
+ * and query them without a server round trip. Every process gets its own
+ * section, and other processes using the same objects go through the
+ * server, so a process can only ever modify the state of its own objects.
+ * Blocking waits and all consuming operations are still done in the
+ * server; clients only ever raise the state of an object when no thread
+ * is waiting on it in the server, and ask the server to wake up the
+ * waiters that showed up in the meantime.
+ *
+ * The state and the serial number of a slot are updated together with
+ * 64-bit atomic operations, so that a client can't modify a slot that has
+ * been reused for another object since it looked up the handle.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+/* slots of a process, mapped read-write in the process */
+struct fast_sync_shm
+{
+    unsigned int           refcount;     /* references from the process and the objects */
+    struct fast_sync_slot *slots;        /* slots in the shared memory */
+    unsigned int          *free_slots;   /* stack of free slot indices */
+    unsigned int           free_count;   /* number of entries in the free stack */
+    unsigned int           used_slots;   /* number of slots ever allocated */
+};
+
+/* fast path state of an object */
+struct fast_sync
+{
+    struct fast_sync_shm  *shm;          /* shared memory of the process that created the object */
+    struct fast_sync_slot *slot;         /* slot of the object */
+};
+
+union fast_sync_word
+{
+    LONG64 value;
+    struct
+    {
+        int          state;
+        unsigned int serial;
+    } s;
+};
+
+C_ASSERT( FIELD_OFFSET( struct fast_sync_slot, serial ) == FIELD_OFFSET( struct fast_sync_slot, state ) + sizeof(int) );
+
+/* check if the fast synchronization path is enabled */
+static int fast_sync_enabled(void)
+{
+    const char *env = getenv( "WINEFASTSYNC" );
+    return env && atoi( env );
+}
+
+static void release_fast_sync_shm( struct fast_sync_shm *shm )
+{
+    if (--shm->refcount) return;
+    munmap( shm->slots, FAST_SYNC_MAX_SLOTS * sizeof(*shm->slots) );
+    free( shm->free_slots );
+    free( shm );
+}
+
+/* release the shared memory of a terminated process, its objects keep their own reference */
+void free_process_fast_sync( struct process *process )
+{
+    if (!process->fast_sync) return;
+    release_fast_sync_shm( process->fast_sync );
+    process->fast_sync = NULL;
+}
+
+/* allocate a slot for a new object in the shared memory of the current process;
+ * return NULL if the fast path is not available */
+struct fast_sync *alloc_fast_sync( unsigned int type, int state, unsigned int max )
+{
+    struct fast_sync_shm *shm;
+    struct fast_sync_slot *slot;
+    struct fast_sync *fast_sync;
+    union fast_sync_word word;
+
+    if (!current || !(shm = current->process->fast_sync)) return NULL;
+    if (shm->free_count) slot = &shm->slots[shm->free_slots[--shm->free_count]];
+    else if (shm->used_slots < FAST_SYNC_MAX_SLOTS) slot = &shm->slots[shm->used_slots++];
+    else return NULL;
+
+    if (!(fast_sync = mem_alloc( sizeof(*fast_sync) )))
+    {
+        shm->free_slots[shm->free_count++] = slot - shm->slots;
+        return NULL;
+    }
+    fast_sync->shm  = shm;
+    fast_sync->slot = slot;
+    shm->refcount++;
+
+    slot->type    = type;
+    slot->max     = max;
+    slot->waiters = 0;
+    word.s.state  = state;
+    word.s.serial = slot->serial + 1;
+    __atomic_store_n( (LONG64 *)&slot->state, word.value, __ATOMIC_SEQ_CST );
+    return fast_sync;
+}
+
+/* free the slot of a destroyed object */
+void free_fast_sync( struct fast_sync *fast_sync )
+{
+    struct fast_sync_shm *shm = fast_sync->shm;
+    struct fast_sync_slot *slot = fast_sync->slot;
+
+    __atomic_store_n( &slot->serial, slot->serial + 1, __ATOMIC_SEQ_CST );
+    slot->type = 0;
+    shm->free_slots[shm->free_count++] = slot - shm->slots;
+    release_fast_sync_shm( shm );
+    free( fast_sync );
+}
+
+/* account for a thread waiting in the server; must be done before checking the state */
+void fast_sync_add_waiter( struct fast_sync *fast_sync )
+{
+    __atomic_fetch_add( &fast_sync->slot->waiters, 1, __ATOMIC_SEQ_CST );
+}
+
+void fast_sync_remove_waiter( struct fast_sync *fast_sync )
+{
+    __atomic_fetch_sub( &fast_sync->slot->waiters, 1, __ATOMIC_SEQ_CST );
+}
+
+int fast_sync_get_state( struct fast_sync *fast_sync )
+{
+    return __atomic_load_n( &fast_sync->slot->state, __ATOMIC_SEQ_CST );
+}
+
+/* update the state with a compare-and-swap on the whole word, like the clients do */
+static int fast_sync_cmpxchg( struct fast_sync *fast_sync, union fast_sync_word *old, int state )
+{
+    union fast_sync_word word = *old;
+
+    word.s.state = state;
+    return __atomic_compare_exchange_n( (LONG64 *)&fast_sync->slot->state, &old->value, word.value, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+}
+
+int fast_sync_set_state( struct fast_sync *fast_sync, int state )
+{
+    union fast_sync_word old;
+
+    old.value = __atomic_load_n( (LONG64 *)&fast_sync->slot->state, __ATOMIC_SEQ_CST );
+    while (!fast_sync_cmpxchg( fast_sync, &old, state ));
+    return old.s.state;
+}
+
+/* release a semaphore count, failing if it exceeds the maximum; return the previous count */
+int fast_sync_release( struct fast_sync *fast_sync, unsigned int count, unsigned int max,
+                       unsigned int *prev )
+{
+    union fast_sync_word old;
+
+    old.value = __atomic_load_n( (LONG64 *)&fast_sync->slot->state, __ATOMIC_SEQ_CST );
+    do
+    {
+        *prev = old.s.state;
+        if (*prev + count < *prev || *prev + count > max) return 0;
+    } while (!fast_sync_cmpxchg( fast_sync, &old, *prev + count ));
+    return 1;
+}
+
+/* consume a semaphore count; only the server ever decrements it */
+void fast_sync_acquire( struct fast_sync *fast_sync )
+{
+    union fast_sync_word old;
+
+    old.value = __atomic_load_n( (LONG64 *)&fast_sync->slot->state, __ATOMIC_SEQ_CST );
+    /* the owner process may have broken the count behind our back */
+    while (old.s.state > 0 && !fast_sync_cmpxchg( fast_sync, &old, old.s.state - 1 ));
+}
+
+static struct fast_sync *get_obj_fast_sync( struct object *obj )
+{
+    struct fast_sync *fast_sync;
+
+    if (!(fast_sync = get_event_fast_sync( obj ))) fast_sync = get_semaphore_fast_sync( obj );
+    if (!fast_sync) fast_sync = get_sock_fast_sync( obj );
+    if (!fast_sync) set_error( STATUS_NOT_IMPLEMENTED );
+    return fast_sync;
+}
+
+/* get the shared memory holding the fast synchronization slots of the current process */
+DECL_HANDLER(get_fast_sync_shm)
+{
+    struct process *process = current->process;
+    size_t size = FAST_SYNC_MAX_SLOTS * sizeof(struct fast_sync_slot);
+    struct fast_sync_shm *shm;
+    void *ptr;
+    int fd;
+
+    if (!fast_sync_enabled())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (process->fast_sync)
+    {
+        set_error( STATUS_ACCESS_DENIED );
+        return;
+    }
+    if (!(shm = mem_alloc( sizeof(*shm) ))) return;
+    if (!(shm->free_slots = mem_alloc( FAST_SYNC_MAX_SLOTS * sizeof(*shm->free_slots) )))
+    {
+        free( shm );
+        return;
+    }
+    if ((fd = create_temp_file( size )) == -1)
+    {
+        file_set_error();
+        goto failed;
+    }
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        goto failed;
+    }
+    shm->refcount   = 1;
+    shm->slots      = ptr;
+    shm->free_count = 0;
+    shm->used_slots = 0;
+    process->fast_sync = shm;
+    send_client_fd( process, fd, 0 );
+    close( fd );
+    reply->count = FAST_SYNC_MAX_SLOTS;
+    return;
+
+failed:
+    free( shm->free_slots );
+    free( shm );
+}
+
+/* get the fast synchronization shared memory slot of an event, semaphore or socket */
+DECL_HANDLER(get_fast_sync_slot)
+{
+    struct fast_sync *fast_sync;
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((fast_sync = get_obj_fast_sync( obj )))
+    {
+        /* objects created by other processes have to go through the server */
+        if (fast_sync->shm == current->process->fast_sync)
+        {
+            reply->index  = fast_sync->slot - fast_sync->shm->slots;
+            reply->serial = fast_sync->slot->serial;
+            reply->access = get_handle_access( current->process, req->handle );
+        }
+        else set_error( STATUS_NOT_IMPLEMENTED );
+    }
+    release_object( obj );
+}
+
+/* wake up the server waiters of an object after a fast path state change */
+DECL_HANDLER(fast_sync_wake)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+    if (get_obj_fast_sync( obj )) wake_up( obj, 0 );
+    release_object( obj );
+}
@@ -365,14 +365,35 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired list while running callbacks */
+    int                   index;      /* index in the timeout heap, -1 once expired */
     abstime_t             when;       /* timeout expiry */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list abs_timeout_list = LIST_INIT(abs_timeout_list); /* sorted absolute timeouts list */
-static struct list rel_timeout_list = LIST_INIT(rel_timeout_list); /* sorted relative timeouts list */
+/* binary min-heap of timeouts, ordered by expiry */
+struct timeout_heap
+{
+    struct timeout_user **users;      /* heap array */
+    unsigned int          count;      /* number of timeouts in the heap */
+    unsigned int          size;       /* allocated size of the array */
+};
+
+static struct timeout_heap abs_timeouts;  /* absolute timeouts heap */
+static struct timeout_heap rel_timeouts;  /* relative timeouts heap */
+
+/* timeouts statistics, for debugging purposes */
+static struct
+{
+    unsigned int active;              /* currently queued timeouts */
+    unsigned int peak;                /* maximum number of queued timeouts */
+    unsigned int added;               /* total number of added timeouts */
+    unsigned int expired;             /* total number of expired timeouts */
+    timeout_t    total_latency;       /* sum of expiration delays */
+    timeout_t    max_latency;         /* maximum expiration delay */
+} timeout_stats;
+
 timeout_t current_time;
 timeout_t monotonic_time;
 
@@ -449,46 +470,141 @@ void set_current_time(void)
     if (user_shared_data) set_user_shared_data_time();
 }
 
+/* relative timeouts are stored as negative values, so compare on the absolute value */
+static inline timeout_t timeout_key( const struct timeout_user *user )
+{
+    return user->when > 0 ? user->when : -user->when;
+}
+
+static inline struct timeout_heap *get_timeout_heap( const struct timeout_user *user )
+{
+    return user->when > 0 ? &abs_timeouts : &rel_timeouts;
+}
+
+static inline void timeout_heap_set( struct timeout_heap *heap, unsigned int index, struct timeout_user *user )
+{
+    heap->users[index] = user;
+    user->index = index;
+}
+
+static void timeout_heap_sift_up( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+    timeout_t key = timeout_key( user );
+
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (timeout_key( heap->users[parent] ) <= key) break;
+        timeout_heap_set( heap, index, heap->users[parent] );
+        index = parent;
+    }
+    timeout_heap_set( heap, index, user );
+}
+
+static void timeout_heap_sift_down( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+    timeout_t key = timeout_key( user );
+
+    for (;;)
+    {
+        unsigned int child = 2 * index + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count &&
+            timeout_key( heap->users[child + 1] ) < timeout_key( heap->users[child] )) child++;
+        if (key <= timeout_key( heap->users[child] )) break;
+        timeout_heap_set( heap, index, heap->users[child] );
+        index = child;
+    }
+    timeout_heap_set( heap, index, user );
+}
+
+static int timeout_heap_insert( struct timeout_heap *heap, struct timeout_user *user )
+{
+    if (heap->count == heap->size)
+    {
+        unsigned int new_size = max( heap->size * 2, 64 );
+        struct timeout_user **new_users;
+
+        if (!(new_users = realloc( heap->users, new_size * sizeof(*new_users) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        heap->users = new_users;
+        heap->size = new_size;
+    }
+    timeout_heap_set( heap, heap->count++, user );
+    timeout_heap_sift_up( heap, user->index );
+    return 1;
+}
+
+static void timeout_heap_remove( struct timeout_heap *heap, struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = heap->users[--heap->count];
+
+    user->index = -1;
+    if (last == user) return;
+    timeout_heap_set( heap, index, last );
+    if (index && timeout_key( heap->users[(index - 1) / 2] ) > timeout_key( last ))
+        timeout_heap_sift_up( heap, index );
+    else
+        timeout_heap_sift_down( heap, index );
+}
+
+static inline struct timeout_user *timeout_heap_head( const struct timeout_heap *heap )
+{
+    return heap->count ? heap->users[0] : NULL;
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = timeout_to_abstime( when );
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
-
-    if (user->when > 0)
-    {
-        LIST_FOR_EACH( ptr, &abs_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when >= user->when) break;
-        }
-    }
-    else
+    if (!timeout_heap_insert( get_timeout_heap( user ), user ))
     {
-        LIST_FOR_EACH( ptr, &rel_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when <= user->when) break;
-        }
+        free( user );
+        return NULL;
     }
-    list_add_before( ptr, &user->entry );
+    timeout_stats.added++;
+    if (++timeout_stats.active > timeout_stats.peak) timeout_stats.peak = timeout_stats.active;
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index != -1)
+    {
+        timeout_heap_remove( get_timeout_heap( user ), user );
+        timeout_stats.active--;
+    }
+    else list_remove( &user->entry );  /* expired but callback not called yet */
     free( user );
 }
 
+/* dump the timeouts statistics */
+void dump_timeout_stats(void)
+{
+    timeout_t avg = timeout_stats.expired ? timeout_stats.total_latency / timeout_stats.expired : 0;
+
+    fprintf( stderr, "timeouts: active=%u (abs=%u rel=%u) peak=%u added=%u expired=%u "
+             "latency avg=%u.%04ums max=%u.%04ums\n",
+             timeout_stats.active, abs_timeouts.count, rel_timeouts.count, timeout_stats.peak,
+             timeout_stats.added, timeout_stats.expired,
+             (unsigned int)(avg / 10000), (unsigned int)(avg % 10000),
+             (unsigned int)(timeout_stats.max_latency / 10000),
+             (unsigned int)(timeout_stats.max_latency % 10000) );
+}
+
 /* return a text description of a timeout for debugging purposes */
 const char *get_timeout_str( timeout_t timeout )
 {
@@ -635,6 +751,7 @@ static inline void main_loop_epoll(void)
             int user = events[i].data.u32;
             if (pollfd[user].revents) fd_poll_event( poll_users[user], pollfd[user].revents );
         }
+        process_batched_requests();
     }
 }
 
@@ -747,6 +864,7 @@ static inline void main_loop_epoll(void)
             if (pollfd[user].revents) fd_poll_event( poll_users[user], pollfd[user].revents );
             pollfd[user].revents = 0;
         }
+        process_batched_requests();
     }
 }
 
@@ -847,6 +965,7 @@ static inline void main_loop_epoll(void)
                 port_associate( port_fd, PORT_SOURCE_FD, pollfd[user].fd, pollfd[user].events, (void *)user );
             }
         }
+        process_batched_requests();
     }
 }
 
@@ -920,58 +1039,55 @@ static int get_next_timeout(void)
 {
     int ret = user_shared_data ? user_shared_data_timeout : -1;
 
-    if (!list_empty( &abs_timeout_list ) || !list_empty( &rel_timeout_list ))
+    if (abs_timeouts.count || rel_timeouts.count)
     {
+        struct timeout_user *timeout;
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heaps */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &abs_timeout_list )) != NULL)
+        while ((timeout = timeout_heap_head( &abs_timeouts )) && timeout->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_t latency = current_time - timeout->when;
+            timeout_heap_remove( &abs_timeouts, timeout );
+            list_add_tail( &expired_list, &timeout->entry );
+            timeout_stats.total_latency += latency;
+            if (latency > timeout_stats.max_latency) timeout_stats.max_latency = latency;
+            timeout_stats.expired++;
+            timeout_stats.active--;
         }
-        while ((ptr = list_head( &rel_timeout_list )) != NULL)
+        while ((timeout = timeout_heap_head( &rel_timeouts )) && -timeout->when <= monotonic_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (-timeout->when <= monotonic_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_t latency = monotonic_time + timeout->when;
+            timeout_heap_remove( &rel_timeouts, timeout );
+            list_add_tail( &expired_list, &timeout->entry );
+            timeout_stats.total_latency += latency;
+            if (latency > timeout_stats.max_latency) timeout_stats.max_latency = latency;
+            timeout_stats.expired++;
+            timeout_stats.active--;
         }
 
         /* now call the callback for all the removed timers */
 
         while ((ptr = list_head( &expired_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             list_remove( &timeout->entry );
             timeout->callback( timeout->private );
             free( timeout );
         }
 
-        if ((ptr = list_head( &abs_timeout_list )) != NULL)
+        if ((timeout = timeout_heap_head( &abs_timeouts )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             timeout_t diff = (timeout->when - current_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
             if (ret == -1 || diff < ret) ret = diff;
         }
 
-        if ((ptr = list_head( &rel_timeout_list )) != NULL)
+        if ((timeout = timeout_heap_head( &rel_timeouts )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             timeout_t diff = (-timeout->when - monotonic_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
@@ -1012,6 +1128,7 @@ void main_loop(void)
                 }
             }
         }
+        process_batched_requests();
     }
 }
 
@@ -2910,6 +3027,7 @@ DECL_HANDLER(set_completion_info)
         {
             fd->completion = get_completion_obj( current->process, req->chandle, IO_COMPLETION_MODIFY_STATE );
             fd->comp_key = req->ckey;
+            sock_completion_changed( fd->user );
         }
         else set_error( STATUS_INVALID_PARAMETER );
         release_object( fd );
@@ -2942,6 +3060,7 @@ DECL_HANDLER(set_fd_completion_mode)
             fd->comp_flags |= req->flags & ( FILE_SKIP_COMPLETION_PORT_ON_SUCCESS
                                            | FILE_SKIP_SET_EVENT_ON_HANDLE
                                            | FILE_SKIP_SET_USER_EVENT_ON_FAST_IO );
+            sock_completion_changed( fd->user );
         }
         else
             set_error( STATUS_INVALID_PARAMETER );
@@ -26,13 +26,16 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "process.h"
 #include "thread.h"
@@ -53,6 +56,7 @@ struct handle_table
     int                  last;        /* last used entry */
     int                  free;        /* first entry that may be free */
     struct handle_entry *entries;     /* handle entries */
+    struct handle_shm_entry *shm;     /* entries mirrored in memory shared with the client */
 };
 
 static struct handle_table *global_table;
@@ -97,6 +101,32 @@ static inline obj_handle_t handle_global_to_local( obj_handle_t handle )
     return handle ^ HANDLE_OBFUSCATOR;
 }
 
+/* check if the handle table is mirrored in memory shared with the client */
+static int handle_shm_enabled(void)
+{
+    const char *env = getenv( "WINEHANDLESHM" );
+    return env && atoi( env );
+}
+
+/* update the copy of a handle entry shared with the client */
+static void update_handle_shm( struct handle_table *table, int index )
+{
+    struct handle_entry *entry = table->entries + index;
+    struct handle_shm_entry *shm;
+    unsigned int generation;
+
+    if (!table->shm || index >= HANDLE_SHM_MAX_ENTRIES) return;
+    shm = table->shm + index;
+    generation = shm->generation;
+    if (entry->ptr)
+    {
+        /* an entry modified in place gets a new generation too, since its access may have changed */
+        if (generation & 1) generation++;
+        __atomic_store_n( &shm->generation, generation + 1, __ATOMIC_RELEASE );
+    }
+    else if (generation & 1) __atomic_store_n( &shm->generation, generation + 1, __ATOMIC_RELEASE );
+}
+
 /* grab an object and increment its handle count */
 static struct object *grab_object_for_handle( struct object *obj )
 {
@@ -186,6 +216,7 @@ static void handle_table_destroy( struct object *obj )
         }
     }
     free( table->entries );
+    if (table->shm) munmap( table->shm, HANDLE_SHM_MAX_ENTRIES * sizeof(*table->shm) );
 }
 
 /* close all the process handles and free the handle table */
@@ -209,6 +240,7 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     table->count   = count;
     table->last    = -1;
     table->free    = 0;
+    table->shm     = NULL;
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -248,6 +280,7 @@ static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned
     table->free = i + 1;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
+    update_handle_shm( table, i );
     return index_to_handle(i);
 }
 
@@ -430,6 +463,7 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
+    update_handle_shm( table, entry - table->entries );
     if (entry < table->entries + table->free) table->free = entry - table->entries;
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
@@ -590,6 +624,7 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
         {
             if (attr & OBJ_INHERIT) access |= RESERVED_INHERIT;
             entry->access = access;
+            update_handle_shm( src->handles, entry - src->handles->entries );
             res = src_handle;
         }
         else
@@ -646,6 +681,47 @@ DECL_HANDLER(close_handle)
     set_error( err );
 }
 
+/* get the shared memory mirroring the handle table of the current process */
+DECL_HANDLER(get_handle_table_shm)
+{
+    struct handle_table *table = current->process->handles;
+    size_t size = HANDLE_SHM_MAX_ENTRIES * sizeof(*table->shm);
+    void *ptr;
+    int i, fd;
+
+    if (!handle_shm_enabled())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (!table)
+    {
+        set_error( STATUS_PROCESS_IS_TERMINATING );
+        return;
+    }
+    if (table->shm)
+    {
+        set_error( STATUS_ACCESS_DENIED );
+        return;
+    }
+    if ((fd = create_temp_file( size )) == -1)
+    {
+        file_set_error();
+        return;
+    }
+    if ((ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        return;
+    }
+    table->shm = ptr;
+    for (i = 0; i <= table->last; i++) update_handle_shm( table, i );
+    send_client_fd( current->process, fd, 0 );
+    close( fd );
+    reply->count = HANDLE_SHM_MAX_ENTRIES;
+}
+
 /* set a handle information */
 DECL_HANDLER(set_handle_info)
 {
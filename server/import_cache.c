@@ -0,0 +1,114 @@
+/*
+ * Server-side import cache
+ *
+ * The loader stores the result of resolving the imports of a module in a
+ * section shared read-only with all the client processes, so that the next
+ * process importing from the same dlls can fill its import address tables
+ * without searching the export tables. Entries are never removed; they are
+ * published by linking them at the head of their hash chain once they are
+ * complete, and the clients validate the identities of all the modules
+ * involved before using them.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "request.h"
+
+static struct import_cache_shm *import_cache;  /* base of the shared section */
+
+/* create the shared section holding the cache */
+void init_import_cache( struct object *root, const struct unicode_str *name )
+{
+    struct object *mapping;
+    void *ptr;
+
+    if (!(mapping = create_shared_mapping( root, name, OBJ_PERMANENT, IMPORT_CACHE_SIZE, NULL, &ptr )))
+        return;
+    import_cache = ptr;
+    import_cache->size = sizeof(*import_cache);
+    release_object( mapping );
+}
+
+/* find an existing entry for the same importer and descriptor */
+static int import_cache_entry_exists( unsigned int hash, unsigned int descr,
+                                      const struct import_cache_module *importer )
+{
+    unsigned int offset = import_cache->buckets[hash % IMPORT_CACHE_BUCKETS];
+    const struct import_cache_entry *entry;
+
+    for ( ; offset; offset = entry->next)
+    {
+        entry = (const struct import_cache_entry *)((const char *)import_cache + offset);
+        if (entry->descr == descr && !memcmp( entry + 1, importer, sizeof(*importer) )) return 1;
+    }
+    return 0;
+}
+
+/* add the resolved imports of an import descriptor to the cache */
+DECL_HANDLER(add_import_cache)
+{
+    const struct import_cache_module *modules = get_req_data();
+    const unsigned int *thunks = (const unsigned int *)(modules + req->modules);
+    data_size_t size = get_req_data_size();
+    struct import_cache_entry *entry;
+    unsigned int i, count, offset;
+
+    if (!import_cache) return;
+    if (req->modules < 2 || req->modules > IMPORT_CACHE_MAX_MODULES ||
+        size < req->modules * sizeof(*modules) || (size - req->modules * sizeof(*modules)) % sizeof(*thunks))
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    count = (size - req->modules * sizeof(*modules)) / sizeof(*thunks);
+    for (i = 0; i < count; i++)
+    {
+        if ((thunks[i] >> 16) && (thunks[i] >> 16) < req->modules) continue;
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+
+    /* another process may have added it in the meantime */
+    if (import_cache_entry_exists( req->hash, req->descr, modules )) return;
+
+    offset = (import_cache->size + 7) & ~7;
+    if (offset + sizeof(*entry) + size > IMPORT_CACHE_SIZE)
+    {
+        set_error( STATUS_NO_MEMORY );
+        return;
+    }
+    entry = (struct import_cache_entry *)((char *)import_cache + offset);
+    entry->descr   = req->descr;
+    entry->modules = req->modules;
+    entry->count   = count;
+    entry->next    = import_cache->buckets[req->hash % IMPORT_CACHE_BUCKETS];
+    memcpy( entry + 1, modules, size );
+    import_cache->size = offset + sizeof(*entry) + size;
+    __atomic_store_n( &import_cache->buckets[req->hash % IMPORT_CACHE_BUCKETS], offset, __ATOMIC_RELEASE );
+}
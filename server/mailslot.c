@@ -380,7 +380,11 @@ static void mailslot_queue_async( struct fd *fd, struct async *async, int type,
 
 static void mailslot_device_dump( struct object *obj, int verbose )
 {
-    fputs( "Mailslot device\n", stderr );
+    struct mailslot_device *device = (struct mailslot_device *)obj;
+
+    fputs( "Mailslot device", stderr );
+    if (verbose && device->mailslots) dump_namespace( device->mailslots );
+    fputc( '\n', stderr );
 }
 
 static struct object *mailslot_device_lookup_name( struct object *obj, struct unicode_str *name,
@@ -419,7 +423,7 @@ static void mailslot_device_destroy( struct object *obj )
 {
     struct mailslot_device *device = (struct mailslot_device*)obj;
     assert( obj->ops == &mailslot_device_ops );
-    free( device->mailslots );
+    free_namespace( device->mailslots );
 }
 
 struct object *create_mailslot_device( struct object *root, const struct unicode_str *name,
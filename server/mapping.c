@@ -121,6 +121,29 @@ static const struct object_ops shared_map_ops =
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
 
+/* cached header information of a PE image file */
+struct image_cache
+{
+    struct list          entry;      /* entry in hash bucket */
+    struct list          lru;        /* entry in least recently used list */
+    dev_t                dev;        /* device of the image file */
+    ino_t                ino;        /* inode of the image file */
+    file_pos_t           size;       /* size of the image file */
+    time_t               mtime;      /* modification time of the image file */
+    time_t               ctime;      /* status change time of the image file */
+    long                 mtime_nsec; /* nanoseconds part of the modification time */
+    pe_image_info_t      image;      /* parsed image info */
+    unsigned int         nb_sec;     /* number of section headers */
+    IMAGE_SECTION_HEADER sec[1];     /* section headers */
+};
+
+#define IMAGE_CACHE_HASH_SIZE 64
+#define IMAGE_CACHE_MAX_ENTRIES 512
+
+static struct list image_cache_hash[IMAGE_CACHE_HASH_SIZE];
+static struct list image_cache_lru = LIST_INIT( image_cache_lru );
+static unsigned int image_cache_count;
+
 /* memory view mapped in client address space */
 struct memory_view
 {
@@ -297,7 +320,7 @@ static int check_current_dir_for_exec(void)
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     static int temp_dir_fd = -1;
     char tmpfn[16];
@@ -444,6 +467,83 @@ static struct shared_map *get_shared_file( struct fd *fd )
     return NULL;
 }
 
+static inline unsigned int image_cache_hash_index( const struct stat *st )
+{
+    return ((unsigned int)st->st_ino ^ (unsigned int)st->st_dev) % IMAGE_CACHE_HASH_SIZE;
+}
+
+static inline long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* find the cached headers of an image file, if they are still valid */
+static struct image_cache *find_image_cache( const struct stat *st )
+{
+    struct list *bucket = &image_cache_hash[image_cache_hash_index( st )];
+    struct image_cache *cache;
+
+    if (!bucket->next) return NULL;  /* not initialized yet */
+
+    LIST_FOR_EACH_ENTRY( cache, bucket, struct image_cache, entry )
+    {
+        if (cache->dev != st->st_dev || cache->ino != st->st_ino) continue;
+        if (cache->size != st->st_size || cache->mtime != st->st_mtime ||
+            cache->ctime != st->st_ctime || cache->mtime_nsec != get_mtime_nsec( st ))
+            return NULL;  /* file has changed, the entry will be replaced */
+        list_remove( &cache->lru );
+        list_add_head( &image_cache_lru, &cache->lru );
+        return cache;
+    }
+    return NULL;
+}
+
+static void free_image_cache( struct image_cache *cache )
+{
+    list_remove( &cache->entry );
+    list_remove( &cache->lru );
+    image_cache_count--;
+    free( cache );
+}
+
+/* store the parsed headers of an image file, evicting the least recently used entry if needed */
+static void add_image_cache( const struct stat *st, const pe_image_info_t *image,
+                             const IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
+{
+    struct list *bucket = &image_cache_hash[image_cache_hash_index( st )];
+    struct image_cache *cache, *next;
+    unsigned int i;
+
+    if (!bucket->next)
+        for (i = 0; i < IMAGE_CACHE_HASH_SIZE; i++) list_init( &image_cache_hash[i] );
+
+    LIST_FOR_EACH_ENTRY_SAFE( cache, next, bucket, struct image_cache, entry )
+        if (cache->dev == st->st_dev && cache->ino == st->st_ino) free_image_cache( cache );
+
+    if (image_cache_count >= IMAGE_CACHE_MAX_ENTRIES)
+        free_image_cache( LIST_ENTRY( list_tail( &image_cache_lru ), struct image_cache, lru ));
+
+    if (!(cache = malloc( offsetof( struct image_cache, sec[nb_sec] ) ))) return;
+    cache->dev        = st->st_dev;
+    cache->ino        = st->st_ino;
+    cache->size       = st->st_size;
+    cache->mtime      = st->st_mtime;
+    cache->ctime      = st->st_ctime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    cache->image      = *image;
+    cache->nb_sec     = nb_sec;
+    memcpy( cache->sec, sec, nb_sec * sizeof(*sec) );
+    list_add_head( bucket, &cache->entry );
+    list_add_head( &image_cache_lru, &cache->lru );
+    image_cache_count++;
+}
+
 /* return the size of the memory mapping and file range of a given section */
 static inline void get_section_sizes( const IMAGE_SECTION_HEADER *sec, size_t *map_size,
                                       off_t *file_start, size_t *file_size )
@@ -660,7 +760,7 @@ static int load_clr_header( IMAGE_COR20_HEADER *hdr, size_t va, size_t size, int
 }
 
 /* retrieve the mapping parameters for an executable (PE) image */
-static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_size, int unix_fd )
+static unsigned int get_image_params( struct mapping *mapping, const struct stat *st, int unix_fd )
 {
     static const char builtin_signature[] = "Wine builtin DLL";
     static const char fakedll_signature[] = "Wine placeholder DLL";
@@ -682,11 +782,23 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
             IMAGE_OPTIONAL_HEADER64 hdr64;
         } opt;
     } nt;
+    struct image_cache *cache;
+    file_pos_t file_size = st->st_size;
     off_t pos;
     int size, opt_size;
     size_t mz_size, clr_va, clr_size;
     unsigned int i;
 
+    if ((cache = find_image_cache( st )))
+    {
+        if (!mapping->size) mapping->size = cache->image.map_size;
+        else if (mapping->size > cache->image.map_size) return STATUS_SECTION_TOO_BIG;
+        mapping->image = cache->image;
+        if (!build_shared_mapping( mapping, unix_fd, cache->sec, cache->nb_sec ))
+            return STATUS_INVALID_FILE_FOR_SECTION;
+        return STATUS_SUCCESS;
+    }
+
     /* load the headers */
 
     if (!file_size) return STATUS_INVALID_FILE_FOR_SECTION;
@@ -819,6 +931,8 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
         }
     }
 
+    add_image_cache( st, &mapping->image, sec, nt.FileHeader.NumberOfSections );
+
     if (!build_shared_mapping( mapping, unix_fd, sec, nt.FileHeader.NumberOfSections ))
         return STATUS_INVALID_FILE_FOR_SECTION;
 
@@ -916,7 +1030,7 @@ static struct mapping *create_mapping( struct object *root, const struct unicode
         }
         if (flags & SEC_IMAGE)
         {
-            unsigned int err = get_image_params( mapping, st.st_size, unix_fd );
+            unsigned int err = get_image_params( mapping, &st, unix_fd );
             if (!err) return mapping;
             set_error( err );
             goto error;
@@ -1114,6 +1228,25 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     return &mapping->obj;
 }
 
+/* create an anonymous mapping that is also mapped read-write into the server */
+struct object *create_shared_mapping( struct object *root, const struct unicode_str *name,
+                                      unsigned int attr, mem_size_t size,
+                                      const struct security_descriptor *sd, void **ptr )
+{
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( root, name, attr, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, sd ))) return NULL;
+    *ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (*ptr == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    return &mapping->obj;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
@@ -488,7 +488,11 @@ static void pipe_server_destroy( struct object *obj )
 
 static void named_pipe_device_dump( struct object *obj, int verbose )
 {
-    fputs( "Named pipe device\n", stderr );
+    struct named_pipe_device *device = (struct named_pipe_device *)obj;
+
+    fputs( "Named pipe device", stderr );
+    if (verbose && device->pipes) dump_namespace( device->pipes );
+    fputc( '\n', stderr );
 }
 
 static struct object *named_pipe_device_lookup_name( struct object *obj, struct unicode_str *name,
@@ -528,7 +532,7 @@ static void named_pipe_device_destroy( struct object *obj )
 {
     struct named_pipe_device *device = (struct named_pipe_device*)obj;
     assert( obj->ops == &named_pipe_device_ops );
-    free( device->pipes );
+    free_namespace( device->pipes );
 }
 
 struct object *create_named_pipe_device( struct object *root, const struct unicode_str *name,
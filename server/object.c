@@ -43,10 +43,22 @@
 #include "security.h"
 
 
+/* the hash table grows when the average chain length reaches this */
+#define NAMESPACE_MAX_LOAD     2
+/* maximum number of buckets of a namespace hash table */
+#define NAMESPACE_MAX_SIZE     (1 << 20)
+/* number of old buckets moved to the new table on each namespace update */
+#define NAMESPACE_REHASH_STEP  8
+
 struct namespace
 {
     unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        count;           /* number of names in the namespace */
+    struct list        *names;           /* array of hash entry lists */
+    struct list        *old_names;       /* previous array being rehashed, NULL if none */
+    unsigned int        old_size;        /* size of the previous array */
+    unsigned int        rehash_pos;      /* next bucket of the previous array to move */
+    struct list         initial[1];      /* initial array of hash entry lists */
 };
 
 
@@ -75,6 +87,7 @@ void dump_objects(void)
         dump_object_name( ptr );
         ptr->ops->dump( ptr, 1 );
     }
+    if (debug_level) dump_timeout_stats();
 }
 
 void close_objects(void)
@@ -134,11 +147,65 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
+/* move a few buckets of the previous hash table to the new one */
+static void rehash_namespace( struct namespace *namespace )
+{
+    unsigned int end = min( namespace->rehash_pos + NAMESPACE_REHASH_STEP, namespace->old_size );
+    struct object_name *ptr;
+    struct list *old;
+
+    for ( ; namespace->rehash_pos < end; namespace->rehash_pos++)
+    {
+        old = &namespace->old_names[namespace->rehash_pos];
+        while (!list_empty( old ))
+        {
+            ptr = LIST_ENTRY( list_head( old ), struct object_name, entry );
+            list_remove( &ptr->entry );
+            list_add_head( &namespace->names[hash_strW( ptr->name, ptr->len, namespace->hash_size )],
+                           &ptr->entry );
+        }
+    }
+    if (namespace->rehash_pos < namespace->old_size) return;
+    if (namespace->old_names != namespace->initial) free( namespace->old_names );
+    namespace->old_names = NULL;
+    namespace->old_size = 0;
+}
+
+/* start moving the names to a larger hash table; the move is spread over the next updates */
+static void grow_namespace( struct namespace *namespace )
+{
+    unsigned int i, new_size = namespace->hash_size * 2 + 1;
+    struct list *names;
+
+    if (new_size > NAMESPACE_MAX_SIZE) return;
+    if (!(names = malloc( new_size * sizeof(*names) ))) return;
+    for (i = 0; i < new_size; i++) list_init( &names[i] );
+
+    namespace->old_names  = namespace->names;
+    namespace->old_size   = namespace->hash_size;
+    namespace->rehash_pos = 0;
+    namespace->names      = names;
+    namespace->hash_size  = new_size;
+}
+
 void namespace_add( struct namespace *namespace, struct object_name *ptr )
 {
-    unsigned int hash = hash_strW( ptr->name, ptr->len, namespace->hash_size );
+    unsigned int hash;
 
+    if (namespace->old_names) rehash_namespace( namespace );
+    else if (namespace->count >= namespace->hash_size * NAMESPACE_MAX_LOAD) grow_namespace( namespace );
+
+    hash = hash_strW( ptr->name, ptr->len, namespace->hash_size );
     list_add_head( &namespace->names[hash], &ptr->entry );
+    ptr->namespace = namespace;
+    namespace->count++;
+}
+
+static void namespace_remove( struct namespace *namespace, struct object_name *ptr )
+{
+    list_remove( &ptr->entry );
+    namespace->count--;
+    if (namespace->old_names) rehash_namespace( namespace );
 }
 
 /* allocate a name for an object */
@@ -150,6 +217,7 @@ static struct object_name *alloc_name( const struct unicode_str *name )
     {
         ptr->len = name->len;
         ptr->parent = NULL;
+        ptr->namespace = NULL;
         memcpy( ptr->name, name->str, name->len );
     }
     return ptr;
@@ -432,7 +500,8 @@ struct object *grab_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount < INT_MAX );
-    obj->refcount++;
+    if (concurrent_dispatch) __atomic_fetch_add( &obj->refcount, 1, __ATOMIC_RELAXED );
+    else obj->refcount++;
     return obj;
 }
 
@@ -441,6 +510,13 @@ void release_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount );
+    if (concurrent_dispatch)
+    {
+        /* concurrent request handlers never release the last reference */
+        unsigned int prev = __atomic_fetch_sub( &obj->refcount, 1, __ATOMIC_ACQ_REL );
+        assert( prev > 1 );
+        return;
+    }
     if (!--obj->refcount)
     {
         assert( !obj->handle_count );
@@ -453,43 +529,69 @@ void release_object( void *ptr )
     }
 }
 
-/* find an object by its name; the refcount is incremented */
-struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
-                            unsigned int attributes )
+/* find a name in a hash chain */
+static struct object_name *find_name_in_list( const struct list *list, const struct unicode_str *name,
+                                              unsigned int attributes )
 {
-    const struct list *list;
-    struct list *p;
-
-    if (!name || !name->len) return NULL;
+    struct object_name *ptr;
 
-    list = &namespace->names[ hash_strW( name->str, name->len, namespace->hash_size ) ];
-    LIST_FOR_EACH( p, list )
+    LIST_FOR_EACH_ENTRY( ptr, list, struct object_name, entry )
     {
-        const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
         if (ptr->len != name->len) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
-            if (!memicmp_strW( ptr->name, name->str, name->len ))
-                return grab_object( ptr->obj );
+            if (!memicmp_strW( ptr->name, name->str, name->len )) return ptr;
         }
         else
         {
-            if (!memcmp( ptr->name, name->str, name->len ))
-                return grab_object( ptr->obj );
+            if (!memcmp( ptr->name, name->str, name->len )) return ptr;
         }
     }
     return NULL;
 }
 
+/* find an object by its name; the refcount is incremented */
+struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
+                            unsigned int attributes )
+{
+    struct object_name *ptr;
+    unsigned int hash;
+
+    if (!name || !name->len) return NULL;
+
+    hash = hash_strW( name->str, name->len, namespace->hash_size );
+    if ((ptr = find_name_in_list( &namespace->names[hash], name, attributes )))
+        return grab_object( ptr->obj );
+
+    /* the name may not have been moved to the new table yet */
+    if (namespace->old_names)
+    {
+        hash = hash_strW( name->str, name->len, namespace->old_size );
+        if (hash >= namespace->rehash_pos &&
+            (ptr = find_name_in_list( &namespace->old_names[hash], name, attributes )))
+            return grab_object( ptr->obj );
+    }
+    return NULL;
+}
+
 /* find an object by its index; the refcount is incremented */
-struct object *find_object_index( const struct namespace *namespace, unsigned int index )
+struct object *find_object_index( struct namespace *namespace, unsigned int index )
 {
+    const struct object_name *ptr;
     unsigned int i;
 
+    if (index >= namespace->count)
+    {
+        set_error( STATUS_NO_MORE_ENTRIES );
+        return NULL;
+    }
+
+    /* finish any pending rehash, moving names while they are enumerated would change their order */
+    while (namespace->old_names) rehash_namespace( namespace );
+
     /* FIXME: not efficient at all */
     for (i = 0; i < namespace->hash_size; i++)
     {
-        const struct object_name *ptr;
         LIST_FOR_EACH_ENTRY( ptr, &namespace->names[i], const struct object_name, entry )
         {
             if (!index--) return grab_object( ptr->obj );
@@ -505,15 +607,52 @@ struct namespace *create_namespace( unsigned int hash_size )
     struct namespace *namespace;
     unsigned int i;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
+    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->initial[0]) );
     if (namespace)
     {
         namespace->hash_size      = hash_size;
+        namespace->count          = 0;
+        namespace->names          = namespace->initial;
+        namespace->old_names      = NULL;
+        namespace->old_size       = 0;
+        namespace->rehash_pos     = 0;
         for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
     }
     return namespace;
 }
 
+/* free a namespace; it must not contain any names */
+void free_namespace( struct namespace *namespace )
+{
+    if (!namespace) return;
+    assert( !namespace->count );
+    if (namespace->old_names && namespace->old_names != namespace->initial) free( namespace->old_names );
+    if (namespace->names != namespace->initial) free( namespace->names );
+    free( namespace );
+}
+
+/* dump the hash chain statistics of a namespace */
+void dump_namespace( const struct namespace *namespace )
+{
+    unsigned int i, len, used = 0, longest = 0;
+
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        len = list_count( &namespace->names[i] );
+        if (len) used++;
+        longest = max( longest, len );
+    }
+    fprintf( stderr, " names=%u buckets=%u used=%u", namespace->count, namespace->hash_size, used );
+    if (used) fprintf( stderr, " avg_chain=%.2f", (double)namespace->count / used );
+    fprintf( stderr, " max_chain=%u", longest );
+    if (namespace->old_names)
+    {
+        for (i = namespace->rehash_pos, len = 0; i < namespace->old_size; i++)
+            len += list_count( &namespace->old_names[i] );
+        fprintf( stderr, " rehashing=%u/%u (%u left)", namespace->rehash_pos, namespace->old_size, len );
+    }
+}
+
 /* functions for unimplemented/default object operations */
 
 int no_add_queue( struct object *obj, struct wait_queue_entry *entry )
@@ -700,7 +839,7 @@ int no_link_name( struct object *obj, struct object_name *name, struct object *p
 
 void default_unlink_name( struct object *obj, struct object_name *name )
 {
-    list_remove( &name->entry );
+    namespace_remove( name->namespace, name );
 }
 
 struct object *no_open_file( struct object *obj, unsigned int access, unsigned int sharing,
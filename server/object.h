@@ -128,6 +128,7 @@ struct object_name
     struct list         entry;           /* entry in the hash list */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    struct namespace   *namespace;       /* namespace containing the name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
@@ -156,6 +157,8 @@ extern void *open_named_object( struct object *parent, const struct object_ops *
                                 const struct unicode_str *name, unsigned int attributes );
 extern void unlink_named_object( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
+extern void dump_namespace( const struct namespace *namespace );
 extern void free_kernel_objects( struct object *obj );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
@@ -163,7 +166,7 @@ extern struct object *grab_object( void *obj );
 extern void release_object( void *obj );
 extern struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
                                    unsigned int attributes );
-extern struct object *find_object_index( const struct namespace *namespace, unsigned int index );
+extern struct object *find_object_index( struct namespace *namespace, unsigned int index );
 extern int no_add_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void no_satisfied( struct object *obj, struct wait_queue_entry *entry );
 extern int no_signal( struct object *obj, unsigned int access );
@@ -214,6 +217,43 @@ extern struct event *get_event_obj( struct process *process, obj_handle_t handle
 extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern struct fast_sync *get_event_fast_sync( struct object *obj );
+
+/* semaphore functions */
+
+extern struct fast_sync *get_semaphore_fast_sync( struct object *obj );
+
+/* socket functions */
+
+extern struct fast_sync *get_sock_fast_sync( struct object *obj );
+extern void sock_completion_changed( struct object *obj );
+
+/* fast synchronization functions */
+
+extern void free_process_fast_sync( struct process *process );
+extern struct fast_sync *alloc_fast_sync( unsigned int type, int state, unsigned int max );
+extern void free_fast_sync( struct fast_sync *fast_sync );
+extern void fast_sync_add_waiter( struct fast_sync *fast_sync );
+extern void fast_sync_remove_waiter( struct fast_sync *fast_sync );
+extern int fast_sync_get_state( struct fast_sync *fast_sync );
+extern int fast_sync_set_state( struct fast_sync *fast_sync, int state );
+extern int fast_sync_release( struct fast_sync *fast_sync, unsigned int count, unsigned int max,
+                              unsigned int *prev );
+extern void fast_sync_acquire( struct fast_sync *fast_sync );
+
+/* import cache functions */
+
+extern void init_import_cache( struct object *root, const struct unicode_str *name );
+
+/* user shared memory functions */
+
+extern void init_user_shm( struct object *root, const struct unicode_str *name );
+extern void *alloc_user_shm( data_size_t size );
+extern void free_user_shm( void *ptr, data_size_t size );
+extern unsigned int get_user_shm_offset( const void *ptr );
+extern void set_user_handle_shm( user_handle_t handle, const void *ptr );
+extern void user_shm_write_begin( struct user_shm_header *hdr );
+extern void user_shm_write_end( struct user_shm_header *hdr );
 
 /* mutex functions */
 
@@ -296,6 +336,9 @@ extern int foreground;
 extern timeout_t master_socket_timeout;
 extern const char *server_argv0;
 
+  /* request dispatch */
+extern int concurrent_dispatch;
+
   /* server start time used for GetTickCount() */
 extern timeout_t server_start_time;
 
@@ -318,6 +361,7 @@ extern struct type_descr winstation_type;
 extern struct type_descr desktop_type;
 extern struct type_descr device_type;
 extern struct type_descr completion_type;
+extern struct type_descr wait_completion_packet_type;
 extern struct type_descr file_type;
 extern struct type_descr mapping_type;
 extern struct type_descr key_type;
@@ -326,4 +370,7 @@ extern struct type_descr key_type;
 #define KEYEDEVENT_WAKE       0x0002
 #define KEYEDEVENT_ALL_ACCESS (STANDARD_RIGHTS_REQUIRED | 0x0003)
 
+#define WAIT_COMPLETION_PACKET_MODIFY_STATE 0x0001
+#define WAIT_COMPLETION_PACKET_ALL_ACCESS   (STANDARD_RIGHTS_REQUIRED | 0x0001)
+
 #endif  /* __WINE_SERVER_OBJECT_H */
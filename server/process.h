@@ -85,6 +85,7 @@ struct process
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
     struct list          kernel_object;   /* list of kernel object pointers */
     pe_image_info_t      image_info;      /* main exe image info */
+    struct fast_sync_shm *fast_sync;      /* fast synchronization slots shared with the process */
 };
 
 /* process functions */
@@ -114,6 +114,7 @@ struct thread_input
     unsigned char          keystate[256]; /* state of each key */
     unsigned char          desktop_keystate[256]; /* desktop keystate when keystate was synced */
     int                    keystate_lock; /* keystate is locked */
+    struct input_shm      *shm;           /* state in the user shared memory */
 };
 
 struct msg_queue
@@ -141,6 +142,7 @@ struct msg_queue
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
     int                    keystate_lock;   /* owns an input keystate lock */
+    struct queue_shm      *shm;             /* state in the user shared memory */
 };
 
 struct hotkey
@@ -249,6 +251,51 @@ static void set_caret_window( struct thread_input *input, user_handle_t win )
     input->caret_state       = 0;
 }
 
+/* update the desktop input state in the user shared memory */
+static void update_desktop_shm( struct desktop *desktop )
+{
+    struct desktop_shm *shm = desktop->shm;
+
+    if (!shm) return;
+    user_shm_write_begin( &shm->hdr );
+    shm->cursor_x           = desktop->cursor.x;
+    shm->cursor_y           = desktop->cursor.y;
+    shm->cursor_last_change = desktop->cursor.last_change;
+    memcpy( shm->keystate, desktop->keystate, sizeof(shm->keystate) );
+    user_shm_write_end( &shm->hdr );
+}
+
+/* update the thread input state in the user shared memory */
+static void update_input_shm( struct thread_input *input )
+{
+    struct input_shm *shm = input->shm;
+
+    if (!shm) return;
+    user_shm_write_begin( &shm->hdr );
+    shm->desktop       = get_user_shm_offset( input->desktop->shm );
+    shm->desktop_id    = input->desktop->shm ? input->desktop->shm->hdr.id : 0;
+    shm->keystate_lock = input->keystate_lock;
+    memcpy( shm->keystate, input->keystate, sizeof(shm->keystate) );
+    memcpy( shm->desktop_keystate, input->desktop_keystate, sizeof(shm->desktop_keystate) );
+    user_shm_write_end( &shm->hdr );
+}
+
+/* update the message queue state in the user shared memory */
+static void update_queue_shm( struct msg_queue *queue )
+{
+    struct queue_shm *shm = queue->shm;
+
+    if (!shm) return;
+    user_shm_write_begin( &shm->hdr );
+    shm->wake_bits    = queue->wake_bits;
+    shm->changed_bits = queue->changed_bits;
+    shm->wake_mask    = queue->wake_mask;
+    shm->changed_mask = queue->changed_mask;
+    shm->input        = get_user_shm_offset( queue->input->shm );
+    shm->input_id     = queue->input->shm ? queue->input->shm->hdr.id : 0;
+    user_shm_write_end( &shm->hdr );
+}
+
 /* create a thread input object */
 static struct thread_input *create_thread_input( struct thread *thread )
 {
@@ -267,6 +314,7 @@ static struct thread_input *create_thread_input( struct thread *thread )
         set_caret_window( input, 0 );
         memset( input->keystate, 0, sizeof(input->keystate) );
         input->keystate_lock = 0;
+        input->shm          = NULL;
 
         if (!(input->desktop = get_thread_desktop( thread, 0 /* FIXME: access rights */ )))
         {
@@ -274,6 +322,8 @@ static struct thread_input *create_thread_input( struct thread *thread )
             return NULL;
         }
         memcpy( input->desktop_keystate, input->desktop->keystate, sizeof(input->desktop_keystate) );
+        input->shm = alloc_user_shm( sizeof(*input->shm) );
+        update_input_shm( input );
     }
     return input;
 }
@@ -309,11 +359,13 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
         queue->keystate_lock   = 0;
+        queue->shm             = alloc_user_shm( sizeof(*queue->shm) );
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
         list_init( &queue->expired_timers );
         for (i = 0; i < NB_MSG_KINDS; i++) list_init( &queue->msg_list[i] );
+        update_queue_shm( queue );
 
         thread->queue = queue;
     }
@@ -333,19 +385,22 @@ void free_msg_queue( struct thread *thread )
 /* synchronize thread input keystate with the desktop */
 static void sync_input_keystate( struct thread_input *input )
 {
-    int i;
+    int i, changed = 0;
     if (!input->desktop || input->keystate_lock) return;
     for (i = 0; i < sizeof(input->keystate); ++i)
     {
         if (input->desktop_keystate[i] == input->desktop->keystate[i]) continue;
         input->keystate[i] = input->desktop_keystate[i] = input->desktop->keystate[i];
+        changed = 1;
     }
+    if (changed) update_input_shm( input );
 }
 
 /* locks thread input keystate to prevent synchronization */
 static void lock_input_keystate( struct thread_input *input )
 {
     input->keystate_lock++;
+    update_input_shm( input );
 }
 
 /* unlock the thread input keystate and synchronize it again */
@@ -353,6 +408,7 @@ static void unlock_input_keystate( struct thread_input *input )
 {
     input->keystate_lock--;
     if (!input->keystate_lock) sync_input_keystate( input );
+    update_input_shm( input );
 }
 
 /* change the thread input data of a given thread */
@@ -374,6 +430,7 @@ static int assign_thread_input( struct thread *thread, struct thread_input *new_
     queue->input = (struct thread_input *)grab_object( new_input );
     if (queue->keystate_lock) lock_input_keystate( queue->input );
     new_input->cursor_count += queue->cursor_count;
+    update_queue_shm( queue );
     return 1;
 }
 
@@ -413,6 +470,7 @@ static int update_desktop_cursor_pos( struct desktop *desktop, int x, int y )
     desktop->cursor.x = x;
     desktop->cursor.y = y;
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shm( desktop );
 
     return updated;
 }
@@ -516,6 +574,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
     }
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_shm( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -529,6 +588,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
         if (queue->keystate_lock) unlock_input_keystate( queue->input );
         queue->keystate_lock = 0;
     }
+    update_queue_shm( queue );
 }
 
 /* check whether msg is a keyboard message */
@@ -1038,6 +1098,7 @@ static void msg_queue_satisfied( struct object *obj, struct wait_queue_entry *en
     struct msg_queue *queue = (struct msg_queue *)obj;
     queue->wake_mask = 0;
     queue->changed_mask = 0;
+    update_queue_shm( queue );
 }
 
 static void msg_queue_destroy( struct object *obj )
@@ -1077,6 +1138,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_user_shm( queue->shm, sizeof(*queue->shm) );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1106,6 +1168,7 @@ static void thread_input_destroy( struct object *obj )
         if (input->desktop->foreground_input == input) set_foreground_input( input->desktop, NULL );
         release_object( input->desktop );
     }
+    free_user_shm( input->shm, sizeof(*input->shm) );
 }
 
 /* fix the thread input data when a window is destroyed */
@@ -1173,7 +1236,11 @@ int attach_thread_input( struct thread *thread_from, struct thread *thread_to )
     }
 
     ret = assign_thread_input( thread_from, input );
-    if (ret) memset( input->keystate, 0, sizeof(input->keystate) );
+    if (ret)
+    {
+        memset( input->keystate, 0, sizeof(input->keystate) );
+        update_input_shm( input );
+    }
     release_object( input );
     return ret;
 }
@@ -1405,6 +1472,14 @@ static void update_input_key_state( struct desktop *desktop, unsigned char *keys
         }
         break;
     }
+    if (keystate == desktop->keystate) update_desktop_shm( desktop );
+}
+
+/* update the thread input key state for a keyboard message */
+static void update_thread_input_key_state( struct thread_input *input, unsigned int msg, lparam_t wparam )
+{
+    update_input_key_state( input->desktop, input->keystate, msg, wparam );
+    update_input_shm( input );
 }
 
 /* update the desktop key state according to a mouse message flags */
@@ -1456,7 +1531,7 @@ static void release_hardware_message( struct msg_queue *queue, unsigned int hw_i
     }
     if (clr_bit) clear_queue_bits( queue, clr_bit );
 
-    update_input_key_state( input->desktop, input->keystate, msg->msg, msg->wparam );
+    update_thread_input_key_state( input, msg->msg, msg->wparam );
     list_remove( &msg->entry );
     free_message( msg );
 }
@@ -1603,7 +1678,7 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
     win = find_hardware_message_window( desktop, input, msg, &msg_code, &thread );
     if (!win || !thread)
     {
-        if (input) update_input_key_state( input->desktop, input->keystate, msg->msg, msg->wparam );
+        if (input) update_thread_input_key_state( input, msg->msg, msg->wparam );
         free_message( msg );
         return;
     }
@@ -1785,6 +1860,7 @@ static int queue_mouse_message( struct desktop *desktop, user_handle_t win, cons
     };
 
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shm( desktop );
     flags = input->mouse.flags;
     time  = input->mouse.time;
     if (!time) time = desktop->cursor.last_change;
@@ -1947,6 +2023,7 @@ static int queue_keyboard_message( struct desktop *desktop, user_handle_t win, c
         desktop->keystate[VK_MENU] &= ~0x02;
         break;
     }
+    update_desktop_shm( desktop );
 
     if ((foreground = get_foreground_thread( desktop, win )))
     {
@@ -2133,7 +2210,7 @@ static int get_hardware_message( struct thread *thread, unsigned int hw_id, user
         if (!win || !win_thread)
         {
             /* no window at all, remove it */
-            update_input_key_state( input->desktop, input->keystate, msg->msg, msg->wparam );
+            update_thread_input_key_state( input, msg->msg, msg->wparam );
             list_remove( &msg->entry );
             free_message( msg );
             continue;
@@ -2149,7 +2226,7 @@ static int get_hardware_message( struct thread *thread, unsigned int hw_id, user
             else
             {
                 /* for another thread input, drop it */
-                update_input_key_state( input->desktop, input->keystate, msg->msg, msg->wparam );
+                update_thread_input_key_state( input, msg->msg, msg->wparam );
                 list_remove( &msg->entry );
                 free_message( msg );
             }
@@ -2446,6 +2523,7 @@ DECL_HANDLER(set_queue_mask)
             if (req->skip_wait) queue->wake_mask = queue->changed_mask = 0;
             else wake_up( &queue->obj, 0 );
         }
+        update_queue_shm( queue );
     }
 }
 
@@ -2459,11 +2537,28 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_shm( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
 
 
+/* get the location of the current message queue in the user shared memory */
+DECL_HANDLER(get_queue_shm)
+{
+    struct msg_queue *queue = get_current_queue();
+
+    if (!queue) return;
+    if (!queue->shm)
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->offset = get_user_shm_offset( queue->shm );
+    reply->id     = queue->shm->hdr.id;
+}
+
+
 /* send a message to a thread queue */
 DECL_HANDLER(send_message)
 {
@@ -2641,6 +2736,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_shm( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -2695,6 +2791,7 @@ DECL_HANDLER(get_message)
     if (get_win == -1 && current->process->idle_event) set_event( current->process->idle_event );
     queue->wake_mask = req->wake_mask;
     queue->changed_mask = req->changed_mask;
+    update_queue_shm( queue );
     set_error( STATUS_PENDING );  /* FIXME */
 }
 
@@ -3070,6 +3167,7 @@ DECL_HANDLER(get_key_state)
         {
             reply->state = desktop->keystate[req->key & 0xff];
             desktop->keystate[req->key & 0xff] &= ~0x40;
+            update_desktop_shm( desktop );
         }
         set_reply_data( desktop->keystate, size );
         release_object( desktop );
@@ -3097,9 +3195,11 @@ DECL_HANDLER(set_key_state)
 
     memcpy( queue->input->keystate, get_req_data(), size );
     memcpy( queue->input->desktop_keystate, queue->input->desktop->keystate, 256 );
+    update_input_shm( queue->input );
     if (req->async && (desktop = get_thread_desktop( current, 0 )))
     {
         memcpy( desktop->keystate, get_req_data(), size );
+        update_desktop_shm( desktop );
         release_object( desktop );
     }
 }
@@ -29,10 +29,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -74,6 +77,20 @@ struct type_descr key_type =
     },
 };
 
+/* the subkeys and values of a key are kept in trees sorted by name, which
+ * are treaps with pseudo-random priorities; the size of the subtrees allows
+ * to enumerate them by index */
+struct name_tree_entry
+{
+    struct name_tree_entry *parent; /* parent entry, NULL for the root */
+    struct name_tree_entry *left;  /* subtree of the lower names */
+    struct name_tree_entry *right; /* subtree of the higher names */
+    const WCHAR      *name;    /* name of the subkey or value */
+    data_size_t       len;     /* length of the name */
+    unsigned int      prio;    /* priority of the entry */
+    unsigned int      count;   /* number of entries in the subtree */
+};
+
 /* a registry key */
 struct key
 {
@@ -81,14 +98,16 @@ struct key
     WCHAR            *class;       /* key class */
     data_size_t       classlen;    /* length of class name */
     int               last_subkey; /* last in use subkey */
-    int               nb_subkeys;  /* count of allocated subkeys */
-    struct key      **subkeys;     /* subkeys array */
+    struct name_tree_entry *subkeys; /* tree of the subkeys */
+    struct name_tree_entry entry;  /* entry in the subkeys tree of the parent */
     struct key       *wow6432node; /* Wow6432Node subkey */
     int               last_value;  /* last in use value */
-    int               nb_values;   /* count of allocated values in array */
-    struct key_value *values;      /* values array */
+    struct name_tree_entry *values; /* tree of the values */
+    struct name_index *subkey_index; /* hash index of the subkeys */
+    struct name_index *value_index;  /* hash index of the values */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
+    unsigned int      hive_pos;    /* position in the saved hive, relative to the parent key */
     struct list       notify_list; /* list of notifications */
 };
 
@@ -105,6 +124,7 @@ struct key
 /* a key value */
 struct key_value
 {
+    struct name_tree_entry entry; /* entry in the values tree of the key */
     WCHAR            *name;    /* value name */
     unsigned short    namelen; /* length of value name */
     unsigned int      type;    /* value type */
@@ -112,8 +132,60 @@ struct key_value
     void             *data;    /* pointer to value data */
 };
 
-#define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
-#define MIN_VALUES   8   /* min. number of allocated values per key */
+/* hash index of the subkeys or values of a key, for keys that have many of them */
+struct name_index_slot
+{
+    unsigned int      hash;    /* case-insensitive hash of the name */
+    void             *ptr;     /* subkey or value, NULL if the slot is free */
+};
+
+struct name_index
+{
+    unsigned int      size;    /* number of slots, a power of 2 */
+    unsigned int      count;   /* number of used slots */
+    struct name_index_slot slots[1];
+};
+
+/* binary hive file format: a header followed by the record of the branch key */
+struct hive_header
+{
+    char              magic[8];   /* hive_magic */
+    unsigned int      version;    /* HIVE_VERSION */
+    unsigned int      arch;       /* prefix type */
+    unsigned int      size;       /* total size of the file */
+    unsigned int      reserved;
+};
+
+/* a key record, followed by the name, the class, the value records and the subkey records */
+/* all records are aligned on 4 bytes, and names and data are padded accordingly */
+struct hive_key
+{
+    unsigned int      size;       /* total size of the record, including values and subkeys */
+    unsigned int      flags;      /* HIVE_KEY_* flags */
+    unsigned int      modif[2];   /* modification time, low and high parts */
+    unsigned int      namelen;    /* length of the name in bytes */
+    unsigned int      classlen;   /* length of the class in bytes */
+    unsigned int      nb_values;  /* number of value records */
+    unsigned int      nb_subkeys; /* number of subkey records */
+};
+
+/* a value record, followed by the name and the data */
+struct hive_value
+{
+    unsigned int      size;       /* total size of the record */
+    unsigned int      type;       /* value type */
+    unsigned int      namelen;    /* length of the name in bytes */
+    unsigned int      len;        /* length of the data in bytes */
+};
+
+static const char hive_magic[8] = {'W','I','N','E','H','I','V','E'};
+
+#define HIVE_VERSION     1
+#define HIVE_KEY_SYMLINK 0x0001
+#define HIVE_NO_POS      (~0u)  /* key is not part of the saved hive */
+#define HIVE_MAX_DEPTH   512    /* max. nesting level of keys in a hive */
+
+#define MIN_INDEXED  64  /* min. number of subkeys or values to create a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -125,19 +197,28 @@ static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89)
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
+static int use_hive;  /* save the registry branches to binary hive files */
 
 static const WCHAR wow6432node[] = {'W','o','w','6','4','3','2','N','o','d','e'};
 static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n','k','V','a','l','u','e'};
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( const struct key *key, const struct unicode_str *name );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *hive_path;    /* path of the binary hive file */
+    const char  *image;        /* hive image of the branch as last loaded or saved */
+    unsigned int image_size;   /* size of the image */
+    int          image_mapped; /* image is a mapping of the hive file */
+    int          hive;         /* branch is being saved to the hive file */
+    FILE        *file;         /* file the branch is being saved to */
+    char        *tmp;          /* temporary file to rename once saved */
+    int          status;       /* result of writing the file in the save thread */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
@@ -285,61 +366,303 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static inline unsigned int hash_name( const WCHAR *name, data_size_t len )
 {
-    int i, min, max, res;
-    data_size_t len;
+    return hash_strW( name, len, ~0u );  /* reduced to the index size by the caller */
+}
+
+static inline unsigned int name_tree_count( const struct name_tree_entry *entry )
+{
+    return entry ? entry->count : 0;
+}
+
+static inline void name_tree_update( struct name_tree_entry *entry )
+{
+    entry->count = 1 + name_tree_count( entry->left ) + name_tree_count( entry->right );
+    if (entry->left) entry->left->parent = entry;
+    if (entry->right) entry->right->parent = entry;
+}
 
-    min = 0;
-    max = key->last_subkey;
-    while (min <= max)
+/* get a new priority; it must not depend on the name, as names are often
+ * created in order and would make the tree degenerate */
+static unsigned int name_tree_prio(void)
+{
+    static unsigned int counter;
+    unsigned int prio = ++counter;
+
+    prio ^= prio >> 16;
+    prio *= 0x7feb352d;
+    prio ^= prio >> 15;
+    prio *= 0x846ca68b;
+    prio ^= prio >> 16;
+    return prio;
+}
+
+static inline int name_tree_compare( const struct name_tree_entry *entry, const WCHAR *name, data_size_t len )
+{
+    int res = memicmp_strW( entry->name, name, min( entry->len, len ));
+    if (!res) res = entry->len - len;
+    return res;
+}
+
+/* find the entry of a given name */
+static struct name_tree_entry *name_tree_find( struct name_tree_entry *entry, const struct unicode_str *name )
+{
+    int res;
+
+    while (entry && (res = name_tree_compare( entry, name->str, name->len )))
+        entry = res > 0 ? entry->left : entry->right;
+    return entry;
+}
+
+/* get the first entry in the name order */
+static struct name_tree_entry *name_tree_head( struct name_tree_entry *entry )
+{
+    if (entry) while (entry->left) entry = entry->left;
+    return entry;
+}
+
+/* get the entry following a given one in the name order */
+static struct name_tree_entry *name_tree_next( struct name_tree_entry *entry )
+{
+    if (entry->right) return name_tree_head( entry->right );
+    while (entry->parent && entry == entry->parent->right) entry = entry->parent;
+    return entry->parent;
+}
+
+#define NAME_TREE_ENTRY_VALUE(entry, type, field) \
+    ((type *)((char *)(entry) - offsetof(type, field)))
+
+#define NAME_TREE_FOR_EACH_ENTRY(elem, tree, type, field) \
+    for ((elem) = NAME_TREE_ENTRY_VALUE(name_tree_head(tree), type, field); \
+         (elem) != NAME_TREE_ENTRY_VALUE(0, type, field); \
+         (elem) = NAME_TREE_ENTRY_VALUE(name_tree_next(&(elem)->field), type, field))
+
+/* find the entry at a given position in the name order */
+static struct name_tree_entry *name_tree_get( struct name_tree_entry *entry, unsigned int index )
+{
+    while (entry)
     {
-        i = (min + max) / 2;
-        len = min( key->subkeys[i]->obj.name->len, name->len );
-        res = memicmp_strW( key->subkeys[i]->obj.name->name, name->str, len );
-        if (!res) res = key->subkeys[i]->obj.name->len - name->len;
-        if (!res)
+        unsigned int count = name_tree_count( entry->left );
+
+        if (index == count) break;
+        if (index < count) entry = entry->left;
+        else
         {
-            *index = i;
-            return key->subkeys[i];
+            index -= count + 1;
+            entry = entry->right;
         }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
     }
-    *index = min;  /* this is where we should insert it */
-    return NULL;
+    return entry;
 }
 
-/* try to grow the array of subkeys; return 1 if OK, 0 on error */
-static int grow_subkeys( struct key *key )
+/* split a tree into the entries lower and higher than the name of a given entry */
+static void name_tree_split( struct name_tree_entry *root, const struct name_tree_entry *entry,
+                             struct name_tree_entry **lower, struct name_tree_entry **higher )
 {
-    struct key **new_subkeys;
-    int nb_subkeys;
-
-    if (key->nb_subkeys)
+    if (!root)
     {
-        nb_subkeys = key->nb_subkeys + (key->nb_subkeys / 2);  /* grow by 50% */
-        if (!(new_subkeys = realloc( key->subkeys, nb_subkeys * sizeof(*new_subkeys) )))
-        {
-            set_error( STATUS_NO_MEMORY );
-            return 0;
-        }
+        *lower = *higher = NULL;
+        return;
+    }
+    if (name_tree_compare( root, entry->name, entry->len ) < 0)
+    {
+        *lower = root;
+        name_tree_split( root->right, entry, &root->right, higher );
     }
     else
     {
-        nb_subkeys = MIN_SUBKEYS;
-        if (!(new_subkeys = mem_alloc( nb_subkeys * sizeof(*new_subkeys) ))) return 0;
+        *higher = root;
+        name_tree_split( root->left, entry, lower, &root->left );
     }
-    key->subkeys    = new_subkeys;
-    key->nb_subkeys = nb_subkeys;
-    return 1;
+    name_tree_update( root );
+}
+
+/* merge two trees, all the entries of the first one being lower than the second one */
+static struct name_tree_entry *name_tree_merge( struct name_tree_entry *lower, struct name_tree_entry *higher )
+{
+    if (!lower) return higher;
+    if (!higher) return lower;
+    if (lower->prio > higher->prio)
+    {
+        lower->right = name_tree_merge( lower->right, higher );
+        name_tree_update( lower );
+        return lower;
+    }
+    higher->left = name_tree_merge( lower, higher->left );
+    name_tree_update( higher );
+    return higher;
+}
+
+/* insert an entry; its name must not be in the tree already */
+static void name_tree_insert( struct name_tree_entry **root, struct name_tree_entry *entry,
+                              const WCHAR *name, data_size_t len )
+{
+    struct name_tree_entry *parent = NULL;
+
+    entry->name = name;
+    entry->len  = len;
+    entry->prio = name_tree_prio();
+
+    while (*root && (*root)->prio >= entry->prio)
+    {
+        parent = *root;
+        parent->count++;
+        root = name_tree_compare( parent, name, len ) > 0 ? &parent->left : &parent->right;
+    }
+    name_tree_split( *root, entry, &entry->left, &entry->right );
+    name_tree_update( entry );
+    entry->parent = parent;
+    *root = entry;
+}
+
+/* remove an entry from a tree */
+static void name_tree_remove( struct name_tree_entry **root, struct name_tree_entry *entry )
+{
+    struct name_tree_entry *parent = entry->parent;
+    struct name_tree_entry *child = name_tree_merge( entry->left, entry->right );
+
+    if (child) child->parent = parent;
+    if (!parent) *root = child;
+    else if (parent->left == entry) parent->left = child;
+    else parent->right = child;
+    for ( ; parent; parent = parent->parent) parent->count--;
+}
+
+/* get the subkey at a given index */
+static inline struct key *subkey_at( const struct key *key, int index )
+{
+    return NAME_TREE_ENTRY_VALUE( name_tree_get( key->subkeys, index ), struct key, entry );
+}
+
+/* get the value at a given index */
+static inline struct key_value *value_at( const struct key *key, int index )
+{
+    return NAME_TREE_ENTRY_VALUE( name_tree_get( key->values, index ), struct key_value, entry );
+}
+
+static struct name_index *alloc_name_index( unsigned int count )
+{
+    struct name_index *index;
+    unsigned int size = MIN_INDEXED * 2;
+
+    while (size < count * 2) size *= 2;
+    if (!(index = calloc( 1, offsetof( struct name_index, slots[size] )))) return NULL;
+    index->size = size;
+    return index;
+}
+
+static void name_index_add( struct name_index *index, unsigned int hash, void *ptr )
+{
+    unsigned int i;
+
+    for (i = hash & (index->size - 1); index->slots[i].ptr; i = (i + 1) & (index->size - 1)) /* nothing */;
+    index->slots[i].hash = hash;
+    index->slots[i].ptr  = ptr;
+    index->count++;
+}
+
+/* add an entry to an index, growing it if needed; the index is dropped if we run out of memory */
+static void name_index_insert( struct name_index **index, unsigned int hash, void *ptr )
+{
+    struct name_index *new_index;
+    unsigned int i;
+
+    if (!*index) return;
+    if (((*index)->count + 1) * 2 > (*index)->size)
+    {
+        new_index = alloc_name_index( (*index)->size );
+        for (i = 0; new_index && i < (*index)->size; i++)
+            if ((*index)->slots[i].ptr) name_index_add( new_index, (*index)->slots[i].hash, (*index)->slots[i].ptr );
+        free( *index );
+        if (!(*index = new_index)) return;
+    }
+    name_index_add( *index, hash, ptr );
+}
+
+static void name_index_remove( struct name_index *index, unsigned int hash, void *ptr )
+{
+    unsigned int i, j, k, mask;
+
+    if (!index) return;
+    mask = index->size - 1;
+    for (i = hash & mask; index->slots[i].ptr != ptr; i = (i + 1) & mask) assert( index->slots[i].ptr );
+
+    /* move back the following entries of the probe sequence */
+    for (j = (i + 1) & mask; index->slots[j].ptr; j = (j + 1) & mask)
+    {
+        k = index->slots[j].hash & mask;
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+    index->slots[i].ptr = NULL;
+    index->count--;
+}
+
+/* add a subkey to the index of its parent, creating the index if the parent has enough subkeys */
+static void index_subkey( struct key *key, struct key *subkey, const struct object_name *name )
+{
+    struct key *ptr;
+
+    if (!key->subkey_index)
+    {
+        if (key->last_subkey + 1 < MIN_INDEXED) return;
+        if (!(key->subkey_index = alloc_name_index( key->last_subkey + 1 ))) return;
+        /* the new subkey name is not set yet, use the one of the tree entries */
+        NAME_TREE_FOR_EACH_ENTRY( ptr, key->subkeys, struct key, entry )
+            name_index_add( key->subkey_index, hash_name( ptr->entry.name, ptr->entry.len ), ptr );
+        return;
+    }
+    name_index_insert( &key->subkey_index, hash_name( name->name, name->len ), subkey );
+}
+
+/* add a value to the index of its key, creating the index if the key has enough values */
+static void index_value( struct key *key, struct key_value *value )
+{
+    struct key_value *ptr;
+
+    if (!key->value_index)
+    {
+        if (key->last_value + 1 < MIN_INDEXED) return;
+        if (!(key->value_index = alloc_name_index( key->last_value + 1 ))) return;
+        NAME_TREE_FOR_EACH_ENTRY( ptr, key->values, struct key_value, entry )
+            name_index_add( key->value_index, hash_name( ptr->name, ptr->namelen ), ptr );
+        return;
+    }
+    name_index_insert( &key->value_index, hash_name( value->name, value->namelen ), value );
+}
+
+/* find the named child of a given key */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name )
+{
+    struct name_tree_entry *entry;
+
+    if (key->subkey_index)
+    {
+        const struct name_index *subkey_index = key->subkey_index;
+        unsigned int slot, hash = hash_name( name->str, name->len );
+        struct key *subkey;
+
+        for (slot = hash & (subkey_index->size - 1); (subkey = subkey_index->slots[slot].ptr);
+             slot = (slot + 1) & (subkey_index->size - 1))
+        {
+            if (subkey_index->slots[slot].hash != hash) continue;
+            if (subkey->obj.name->len == name->len &&
+                !memicmp_strW( subkey->obj.name->name, name->str, name->len )) return subkey;
+        }
+        return NULL;
+    }
+
+    if (!(entry = name_tree_find( key->subkeys, name ))) return NULL;
+    return NAME_TREE_ENTRY_VALUE( entry, struct key, entry );
 }
 
 /* save a registry and all its subkeys to a text file */
 static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
 {
-    int i;
+    struct key_value *value;
+    struct key *subkey;
 
     if (key->flags & KEY_VOLATILE) return;
     /* save key if it has either some values or no subkeys, or needs special options */
@@ -357,9 +680,9 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
             fprintf( f, "\"\n" );
         }
         if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+        NAME_TREE_FOR_EACH_ENTRY( value, key->values, struct key_value, entry ) dump_value( value, f );
     }
-    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
+    NAME_TREE_FOR_EACH_ENTRY( subkey, key->subkeys, struct key, entry ) save_subkeys( subkey, base, f );
 }
 
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
@@ -479,7 +802,6 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
     struct key *found, *key = (struct key *)obj;
     struct unicode_str tmp;
     data_size_t next;
-    int index;
 
     assert( obj->ops == &key_ops );
 
@@ -498,7 +820,7 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
 
         if (!name->len && (attr & OBJ_OPENLINK)) return NULL;
 
-        if (!(value = find_value( key, &symlink_str, &index )) ||
+        if (!(value = find_value( key, &symlink_str )) ||
             value->len < sizeof(WCHAR) || *(WCHAR *)value->data != '\\')
         {
             set_error( STATUS_OBJECT_NAME_NOT_FOUND );
@@ -543,13 +865,13 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
     for (next = tmp.len; next < name->len; next += sizeof(WCHAR))
         if (name->str[next / sizeof(WCHAR)] != '\\') break;
 
-    if (!(found = find_subkey( key, &tmp, &index )))
+    if (!(found = find_subkey( key, &tmp )))
     {
         if ((key->flags & KEY_WOWSHARE) && (attr & OBJ_KEY_WOW64))
         {
             /* try in the 64-bit parent */
             key = get_parent( key );
-            if (!(found = find_subkey( key, &tmp, &index ))) return grab_object( key );
+            if (!(found = find_subkey( key, &tmp ))) return grab_object( key );
         }
     }
 
@@ -581,8 +903,6 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
 {
     struct key *key = (struct key *)obj;
     struct key *parent_key = (struct key *)parent;
-    struct unicode_str tmp;
-    int i, index;
 
     if (parent->ops != &key_ops)
     {
@@ -592,18 +912,10 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
         return 0;
     }
 
-    if (parent_key->last_subkey + 1 == parent_key->nb_subkeys)
-    {
-        /* need to grow the array */
-        if (!grow_subkeys( parent_key )) return 0;
-    }
-    tmp.str = name->name;
-    tmp.len = name->len;
-    find_subkey( parent_key, &tmp, &index );
-
-    for (i = ++parent_key->last_subkey; i > index; i--)
-        parent_key->subkeys[i] = parent_key->subkeys[i - 1];
-    parent_key->subkeys[index] = (struct key *)grab_object( key );
+    grab_object( key );
+    name_tree_insert( &parent_key->subkeys, &key->entry, name->name, name->len );
+    parent_key->last_subkey++;
+    index_subkey( parent_key, key, name );
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -615,7 +927,6 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
 {
     struct key *key = (struct key *)obj;
     struct key *parent = (struct key *)name->parent;
-    int i, nb_subkeys;
 
     if (!parent) return;
 
@@ -625,25 +936,12 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         return;
     }
 
-    for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
-    assert( i <= parent->last_subkey );
-    for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    name_tree_remove( &parent->subkeys, &key->entry );
     parent->last_subkey--;
+    name_index_remove( parent->subkey_index, hash_name( name->name, name->len ), key );
     name->parent = NULL;
     if (parent->wow6432node == key) parent->wow6432node = NULL;
     release_object( key );
-
-    /* try to shrink the array */
-    nb_subkeys = parent->nb_subkeys;
-    if (nb_subkeys > MIN_SUBKEYS && parent->last_subkey < nb_subkeys / 2)
-    {
-        struct key **new_subkeys;
-        nb_subkeys -= nb_subkeys / 3;  /* shrink by 33% */
-        if (nb_subkeys < MIN_SUBKEYS) nb_subkeys = MIN_SUBKEYS;
-        if (!(new_subkeys = realloc( parent->subkeys, nb_subkeys * sizeof(*new_subkeys) ))) return;
-        parent->subkeys = new_subkeys;
-        parent->nb_subkeys = nb_subkeys;
-    }
 }
 
 /* close the notification associated with a handle */
@@ -655,26 +953,44 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     return 1;  /* ok to close */
 }
 
+/* free a tree of values */
+static void free_values( struct name_tree_entry *entry )
+{
+    struct key_value *value;
+
+    if (!entry) return;
+    free_values( entry->left );
+    free_values( entry->right );
+    value = NAME_TREE_ENTRY_VALUE( entry, struct key_value, entry );
+    free( value->name );
+    free( value->data );
+    free( value );
+}
+
+/* release a tree of subkeys, without unlinking them */
+static void release_subkeys( struct name_tree_entry *entry )
+{
+    struct key *subkey;
+
+    if (!entry) return;
+    release_subkeys( entry->left );
+    release_subkeys( entry->right );
+    subkey = NAME_TREE_ENTRY_VALUE( entry, struct key, entry );
+    subkey->obj.name->parent = NULL;
+    release_object( subkey );
+}
+
 static void key_destroy( struct object *obj )
 {
-    int i;
     struct list *ptr;
     struct key *key = (struct key *)obj;
     assert( obj->ops == &key_ops );
 
     free( key->class );
-    for (i = 0; i <= key->last_value; i++)
-    {
-        free( key->values[i].name );
-        free( key->values[i].data );
-    }
-    free( key->values );
-    for (i = 0; i <= key->last_subkey; i++)
-    {
-        key->subkeys[i]->obj.name->parent = NULL;
-        release_object( key->subkeys[i] );
-    }
-    free( key->subkeys );
+    free_values( key->values );
+    free( key->value_index );
+    release_subkeys( key->subkeys );
+    free( key->subkey_index );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -701,13 +1017,14 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->classlen    = 0;
             key->flags       = 0;
             key->last_subkey = -1;
-            key->nb_subkeys  = 0;
             key->subkeys     = NULL;
             key->wow6432node = NULL;
-            key->nb_values   = 0;
             key->last_value  = -1;
             key->values      = NULL;
+            key->subkey_index = NULL;
+            key->value_index = NULL;
             key->modif       = modif;
+            key->hive_pos    = HIVE_NO_POS;
             list_init( &key->notify_list );
 
             if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
@@ -739,12 +1056,12 @@ static void make_dirty( struct key *key )
 /* mark a key and all its subkeys as clean (not modified) */
 static void make_clean( struct key *key )
 {
-    int i;
+    struct key *subkey;
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
     key->flags &= ~KEY_DIRTY;
-    for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
+    NAME_TREE_FOR_EACH_ENTRY( subkey, key->subkeys, struct key, entry ) make_clean( subkey );
 }
 
 /* go through all the notifications and send them if necessary */
@@ -788,7 +1105,6 @@ static struct key *get_wow6432node( struct key *key )
 {
     struct key *parent, *ret;
     struct unicode_str name;
-    int index;
 
     if (!key)
         return NULL;
@@ -805,7 +1121,7 @@ static struct key *get_wow6432node( struct key *key )
 
     name.str = key->obj.name->name;
     name.len = key->obj.name->len;
-    return find_subkey( ret, &name, &index );
+    return find_subkey( ret, &name );
 }
 
 /* open a subkey */
@@ -903,7 +1219,8 @@ static struct key *create_key_recursive( struct key *root, const struct unicode_
 /* query information about a key or a subkey */
 static void enum_key( struct key *key, int index, int info_class, struct enum_key_reply *reply )
 {
-    int i;
+    struct key *subkey;
+    struct key_value *value;
     data_size_t len, namelen, classlen;
     data_size_t max_subkey = 0, max_class = 0;
     data_size_t max_value = 0, max_data = 0;
@@ -923,7 +1240,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
-        key = key->subkeys[index];
+        key = subkey_at( key, index );
     }
 
     namelen = key->obj.name->len;
@@ -945,15 +1262,15 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         break;
     case KeyFullInformation:
     case KeyCachedInformation:
-        for (i = 0; i <= key->last_subkey; i++)
+        NAME_TREE_FOR_EACH_ENTRY( subkey, key->subkeys, struct key, entry )
         {
-            if (key->subkeys[i]->obj.name->len > max_subkey) max_subkey = key->subkeys[i]->obj.name->len;
-            if (key->subkeys[i]->classlen > max_class) max_class = key->subkeys[i]->classlen;
+            if (subkey->obj.name->len > max_subkey) max_subkey = subkey->obj.name->len;
+            if (subkey->classlen > max_class) max_class = subkey->classlen;
         }
-        for (i = 0; i <= key->last_value; i++)
+        NAME_TREE_FOR_EACH_ENTRY( value, key->values, struct key_value, entry )
         {
-            if (key->values[i].namelen > max_value) max_value = key->values[i].namelen;
-            if (key->values[i].len > max_data) max_data = key->values[i].len;
+            if (value->namelen > max_value) max_value = value->namelen;
+            if (value->len > max_data) max_data = value->len;
         }
         reply->max_subkey = max_subkey;
         reply->max_class  = max_class;
@@ -1003,7 +1320,6 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     struct object_name *new_name_ptr;
     struct key *subkey, *parent = get_parent( key );
     data_size_t len;
-    int i, index, cur_index;
 
     /* changing to a path is not allowed */
     len = get_path_element( new_name->str, new_name->len );
@@ -1014,7 +1330,7 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     }
 
     /* check for existing subkey with the same name */
-    if (!parent || (subkey = find_subkey( parent, new_name, &index )))
+    if (!parent || (subkey = find_subkey( parent, new_name )))
     {
         set_error( STATUS_CANNOT_DELETE );
         return;
@@ -1034,22 +1350,12 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     new_name_ptr->parent = &parent->obj;
     memcpy( new_name_ptr->name, new_name->str, new_name->len );
 
-    for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
-        if (parent->subkeys[cur_index] == key) break;
-
-    if (cur_index < index && (index - cur_index) > 1)
-    {
-        --index;
-        for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
-    }
-    else if (cur_index > index)
-    {
-        for (i = cur_index; i > index; --i) parent->subkeys[i] = parent->subkeys[i-1];
-    }
-    parent->subkeys[index] = key;
-
+    name_tree_remove( &parent->subkeys, &key->entry );
+    name_index_remove( parent->subkey_index, hash_name( key->obj.name->name, key->obj.name->len ), key );
     free( key->obj.name );
     key->obj.name = new_name_ptr;
+    name_tree_insert( &parent->subkeys, &key->entry, new_name_ptr->name, new_name_ptr->len );
+    name_index_insert( &parent->subkey_index, hash_name( new_name->str, new_name->len ), key );
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
@@ -1076,7 +1382,7 @@ static int delete_key( struct key *key, int recurse )
     if (recurse)
     {
         while (key->last_subkey >= 0)
-            if (!delete_key( key->subkeys[key->last_subkey], 1 )) return 0;
+            if (!delete_key( NAME_TREE_ENTRY_VALUE( key->subkeys, struct key, entry ), 1 )) return 0;
     }
     else if (key->last_subkey >= 0)  /* we can only delete a key that has no subkeys */
     {
@@ -1091,80 +1397,55 @@ static int delete_key( struct key *key, int recurse )
     return 1;
 }
 
-/* try to grow the array of values; return 1 if OK, 0 on error */
-static int grow_values( struct key *key )
+/* find the named value of a given key */
+static struct key_value *find_value( const struct key *key, const struct unicode_str *name )
 {
-    struct key_value *new_val;
-    int nb_values;
+    struct name_tree_entry *entry;
 
-    if (key->nb_values)
-    {
-        nb_values = key->nb_values + (key->nb_values / 2);  /* grow by 50% */
-        if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) )))
-        {
-            set_error( STATUS_NO_MEMORY );
-            return 0;
-        }
-    }
-    else
+    if (key->value_index)
     {
-        nb_values = MIN_VALUES;
-        if (!(new_val = mem_alloc( nb_values * sizeof(*new_val) ))) return 0;
-    }
-    key->values = new_val;
-    key->nb_values = nb_values;
-    return 1;
-}
-
-/* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
-{
-    int i, min, max, res;
-    data_size_t len;
+        const struct name_index *value_index = key->value_index;
+        unsigned int slot, hash = hash_name( name->str, name->len );
+        struct key_value *value;
 
-    min = 0;
-    max = key->last_value;
-    while (min <= max)
-    {
-        i = (min + max) / 2;
-        len = min( key->values[i].namelen, name->len );
-        res = memicmp_strW( key->values[i].name, name->str, len );
-        if (!res) res = key->values[i].namelen - name->len;
-        if (!res)
+        for (slot = hash & (value_index->size - 1); (value = value_index->slots[slot].ptr);
+             slot = (slot + 1) & (value_index->size - 1))
         {
-            *index = i;
-            return &key->values[i];
+            if (value_index->slots[slot].hash != hash) continue;
+            if (value->namelen == name->len && !memicmp_strW( value->name, name->str, name->len ))
+                return value;
         }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
+        return NULL;
     }
-    *index = min;  /* this is where we should insert it */
-    return NULL;
+
+    if (!(entry = name_tree_find( key->values, name ))) return NULL;
+    return NAME_TREE_ENTRY_VALUE( entry, struct key_value, entry );
 }
 
-/* insert a new value; the index must have been returned by find_value */
-static struct key_value *insert_value( struct key *key, const struct unicode_str *name, int index )
+/* insert a new value; it must not exist already */
+static struct key_value *insert_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
-    if (key->last_value + 1 == key->nb_values)
+    if (!(value = mem_alloc( sizeof(*value) ))) return NULL;
+    if (name->len && !(new_name = memdup( name->str, name->len )))
     {
-        if (!grow_values( key )) return NULL;
+        free( value );
+        return NULL;
     }
-    if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
-    value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    name_tree_insert( &key->values, &value->entry, new_name, name->len );
+    key->last_value++;
+    index_value( key, value );
     return value;
 }
 
@@ -1174,7 +1455,6 @@ static void set_value( struct key *key, const struct unicode_str *name,
 {
     struct key_value *value;
     void *ptr = NULL;
-    int index;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1182,7 +1462,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
         return;
     }
 
-    if ((value = find_value( key, name, &index )))
+    if ((value = find_value( key, name )))
     {
         /* check if the new value is identical to the existing one */
         if (value->type == type && value->len == len &&
@@ -1207,7 +1487,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
 
     if (!value)
     {
-        if (!(value = insert_value( key, name, index )))
+        if (!(value = insert_value( key, name )))
         {
             free( ptr );
             return;
@@ -1226,7 +1506,6 @@ static void set_value( struct key *key, const struct unicode_str *name,
 static void get_value( struct key *key, const struct unicode_str *name, int *type, data_size_t *len )
 {
     struct key_value *value;
-    int index;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1234,7 +1513,7 @@ static void get_value( struct key *key, const struct unicode_str *name, int *typ
         return;
     }
 
-    if ((value = find_value( key, name, &index )))
+    if ((value = find_value( key, name )))
     {
         *type = value->type;
         *len  = value->len;
@@ -1265,7 +1544,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
-        value = &key->values[i];
+        value = value_at( key, i );
         reply->type = value->type;
         namelen = value->namelen;
 
@@ -1309,7 +1588,6 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1317,29 +1595,19 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
 
-    if (!(value = find_value( key, name, &index )))
+    if (!(value = find_value( key, name )))
     {
         set_error( STATUS_OBJECT_NAME_NOT_FOUND );
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    name_index_remove( key->value_index, hash_name( value->name, value->namelen ), value );
+    name_tree_remove( &key->values, &value->entry );
+    key->last_value--;
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
-    key->last_value--;
+    free( value );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
-
-    /* try to shrink the array */
-    nb_values = key->nb_values;
-    if (nb_values > MIN_VALUES && key->last_value < nb_values / 2)
-    {
-        struct key_value *new_val;
-        nb_values -= nb_values / 3;  /* shrink by 33% */
-        if (nb_values < MIN_VALUES) nb_values = MIN_VALUES;
-        if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) ))) return;
-        key->values = new_val;
-        key->nb_values = nb_values;
-    }
 }
 
 /* get the registry key corresponding to an hkey handle */
@@ -1588,7 +1856,6 @@ static struct key_value *parse_value_name( struct key *key, const char *buffer,
 {
     struct key_value *value;
     struct unicode_str name;
-    int index;
 
     if (!get_file_tmp_space( info, strlen(buffer) * sizeof(WCHAR) )) return NULL;
     name.str = info->tmp;
@@ -1609,7 +1876,7 @@ static struct key_value *parse_value_name( struct key *key, const char *buffer,
     if (buffer[*len] != '=') goto error;
     (*len)++;
     while (isspace(buffer[*len])) (*len)++;
-    if (!(value = find_value( key, &name, &index ))) value = insert_value( key, &name, index );
+    if (!(value = find_value( key, &name ))) value = insert_value( key, &name );
     return value;
 
  error:
@@ -1755,6 +2022,8 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             if (prefix_len == -1) prefix_len = get_prefix_len( key, p + 1, &info );
             if (!(subkey = load_key( key, p + 1, prefix_len, &info, &modif )))
                 file_read_error( "Error creating key", &info );
+            else
+                make_dirty( subkey );
             break;
         case '@':   /* default value */
         case '\"':  /* value */
@@ -1805,28 +2074,224 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+static inline unsigned int hive_align( unsigned int len )
+{
+    return (len + 3) & ~3;
+}
+
+/* build the name of the hive file corresponding to a text registry file */
+static char *get_hive_path( const char *path )
+{
+    size_t len = strlen( path );
+    char *ret;
+
+    if (len > 4 && !strcmp( path + len - 4, ".reg" )) len -= 4;
+    if ((ret = malloc( len + sizeof(".hiv") )))
+    {
+        memcpy( ret, path, len );
+        strcpy( ret + len, ".hiv" );
+    }
+    return ret;
+}
+
+/* check that a key record and everything it contains fits in the given size */
+static int check_hive_key( const char *ptr, unsigned int size, unsigned int depth )
+{
+    const struct hive_key *key = (const struct hive_key *)ptr;
+    const WCHAR *name = (const WCHAR *)(key + 1);
+    unsigned int i, pos = sizeof(*key);
+
+    if (depth > HIVE_MAX_DEPTH) return 0;
+    if (size < sizeof(*key) || key->size < sizeof(*key) || key->size > size || key->size % 4) return 0;
+    if (key->namelen % sizeof(WCHAR) || key->namelen > MAX_NAME_LEN * sizeof(WCHAR)) return 0;
+    if (!key->namelen != !depth) return 0;  /* only the branch key has no name */
+    if (hive_align( key->namelen ) > key->size - pos) return 0;
+    for (i = 0; i < key->namelen / sizeof(WCHAR); i++) if (name[i] == '\\') return 0;
+    pos += hive_align( key->namelen );
+    if (key->classlen % sizeof(WCHAR) || key->classlen > key->size - pos) return 0;
+    pos += hive_align( key->classlen );
+    if (pos > key->size) return 0;
+
+    for (i = 0; i < key->nb_values; i++)
+    {
+        const struct hive_value *value = (const struct hive_value *)(ptr + pos);
+
+        if (key->size - pos < sizeof(*value)) return 0;
+        if (value->size < sizeof(*value) || value->size > key->size - pos || value->size % 4) return 0;
+        if (value->namelen % sizeof(WCHAR) || value->namelen > MAX_VALUE_LEN * sizeof(WCHAR)) return 0;
+        if (hive_align( value->namelen ) > value->size - sizeof(*value)) return 0;
+        if (value->len > value->size - sizeof(*value) - hive_align( value->namelen )) return 0;
+        pos += value->size;
+    }
+    for (i = 0; i < key->nb_subkeys; i++)
+    {
+        if (!check_hive_key( ptr + pos, key->size - pos, depth + 1 )) return 0;
+        pos += ((const struct hive_key *)(ptr + pos))->size;
+    }
+    return 1;
+}
+
+/* fill a key and create its subkeys from a hive record that has been checked already */
+static int load_hive_key( struct key *key, const char *ptr )
+{
+    const struct hive_key *rec = (const struct hive_key *)ptr;
+    unsigned int i, pos = sizeof(*rec) + hive_align( rec->namelen );
+    struct unicode_str name;
+
+    key->modif = ((timeout_t)rec->modif[1] << 32) | rec->modif[0];
+    if (rec->flags & HIVE_KEY_SYMLINK) key->flags |= KEY_SYMLINK;
+    if (rec->classlen)
+    {
+        free( key->class );
+        key->classlen = 0;
+        if (!(key->class = memdup( ptr + pos, rec->classlen ))) return 0;
+        key->classlen = rec->classlen;
+    }
+    pos += hive_align( rec->classlen );
+
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        const struct hive_value *val = (const struct hive_value *)(ptr + pos);
+        const char *data = (const char *)(val + 1) + hive_align( val->namelen );
+        struct key_value *value;
+        void *newptr = NULL;
+
+        name.str = (const WCHAR *)(val + 1);
+        name.len = val->namelen;
+        if (!(value = find_value( key, &name )) && !(value = insert_value( key, &name ))) return 0;
+        if (val->len && !(newptr = memdup( data, val->len ))) return 0;
+        free( value->data );
+        value->data = newptr;
+        value->len  = val->len;
+        value->type = val->type;
+        pos += val->size;
+    }
+
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        const struct hive_key *sub = (const struct hive_key *)(ptr + pos);
+        struct key *subkey;
+        int ret;
+
+        name.str = (const WCHAR *)(sub + 1);
+        name.len = sub->namelen;
+        if (!(subkey = create_key_object( &key->obj, &name, OBJ_OPENIF, 0, 0, NULL ))) return 0;
+        ret = load_hive_key( subkey, ptr + pos );
+        subkey->hive_pos = pos;
+        release_object( subkey );
+        if (!ret) return 0;
+        pos += sub->size;
+    }
+    return 1;
+}
+
+/* check if the hive file of a branch exists and is not older than the text file */
+static int is_hive_current( const struct save_branch_info *info )
+{
+    struct stat hive_st, st;
+
+    if (!info->hive_path || stat( info->hive_path, &hive_st ) == -1) return 0;
+    if (stat( info->path, &st ) == -1) return 1;
+    return hive_st.st_mtime >= st.st_mtime;
+}
+
+/* load a registry branch from its hive file */
+/* the file stays mapped so that unmodified subtrees can be copied from it when saving */
+static int load_hive( struct save_branch_info *info )
+{
+    const struct hive_header *header;
+    struct stat st;
+    void *ptr;
+    int fd;
+
+    if ((fd = open( info->hive_path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > UINT_MAX)
+    {
+        close( fd );
+        goto invalid;
+    }
+    ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return 0;
+
+    header = ptr;
+    if (memcmp( header->magic, hive_magic, sizeof(hive_magic) ) || header->version != HIVE_VERSION ||
+        header->size != st.st_size || header->arch > PREFIX_64BIT ||
+        !check_hive_key( (const char *)(header + 1), header->size - sizeof(*header), 0 ))
+    {
+        munmap( ptr, st.st_size );
+        goto invalid;
+    }
+    if (header->arch != PREFIX_UNKNOWN)
+    {
+        if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->arch;
+        else if (header->arch != prefix_type)
+        {
+            fprintf( stderr, "%s: Mismatched architecture\n", info->hive_path );
+            munmap( ptr, st.st_size );
+            return 0;
+        }
+    }
+    if (!load_hive_key( info->key, (const char *)(header + 1) ))
+    {
+        fprintf( stderr, "%s: could not load registry hive\n", info->hive_path );
+        munmap( ptr, st.st_size );
+        return 0;
+    }
+    info->image = ptr;
+    info->image_size = st.st_size;
+    info->image_mapped = 1;
+    return 1;
+
+invalid:
+    fprintf( stderr, "%s is not a valid registry hive\n", info->hive_path );
+    return 0;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    int loaded = 0;
     FILE *f;
 
-    if ((f = fopen( filename, "r" )))
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    info = &save_branch_info[save_branch_count];
+    info->key          = key;
+    info->path         = filename;
+    info->hive_path    = get_hive_path( filename );
+    info->image        = NULL;
+    info->image_size   = 0;
+    info->image_mapped = 0;
+    info->hive         = 0;
+    info->file         = NULL;
+    info->tmp          = NULL;
+
+    if (is_hive_current( info ) && load_hive( info ))
+    {
+        /* the branch only needs to be saved again if it has to be converted to text */
+        if (use_hive) make_clean( key );
+        else make_dirty( key );
+        loaded = 1;
+    }
+    else if ((f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
             fprintf( stderr, "%s is not a valid registry file\n", filename );
+            free( info->hive_path );
             return 1;
         }
+        loaded = 1;
     }
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
-
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    save_branch_count++;
+    grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return loaded;
 }
 
 static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
@@ -1902,6 +2367,8 @@ void init_registry(void)
     unsigned int i;
     char *p;
 
+    if ((p = getenv( "WINEREGISTRYHIVE" ))) use_hive = atoi( p );
+
     /* switch to the config dir */
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
@@ -1999,8 +2466,8 @@ void init_registry(void)
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
 
-/* save a registry branch to a file */
-static void save_all_subkeys( struct key *key, FILE *f )
+/* save the header of a registry text file */
+static void save_header( const struct key *key, FILE *f )
 {
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
@@ -2017,6 +2484,12 @@ static void save_all_subkeys( struct key *key, FILE *f )
     default:
         break;
     }
+}
+
+/* save a registry branch to a file */
+static void save_all_subkeys( struct key *key, FILE *f )
+{
+    save_header( key, f );
     save_subkeys( key, key, f );
 }
 
@@ -2045,23 +2518,206 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* buffer used to build a hive image */
+struct hive_buffer
 {
-    struct stat st;
-    char *p, *tmp = NULL;
-    int fd, count = 0, ret = 0;
-    FILE *f;
+    char         *data;    /* contents of the hive */
+    unsigned int  size;    /* size used so far */
+    unsigned int  alloc;   /* allocated size */
+    const char   *old;     /* previous image of the branch, if any */
+};
 
-    if (!(key->flags & KEY_DIRTY))
+/* append data to a hive buffer, padded to the record alignment */
+static int hive_append( struct hive_buffer *buf, const void *data, unsigned int len )
+{
+    unsigned int size = hive_align( len );
+
+    if (size < len || buf->size + size < size) return 0;
+    if (buf->size + size > buf->alloc)
     {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
+        unsigned int alloc = max( buf->alloc + buf->alloc / 2, 65536 );
+        char *new_data;
+
+        if (alloc < buf->size + size) alloc = buf->size + size;
+        if (!(new_data = realloc( buf->data, alloc ))) return 0;
+        buf->data  = new_data;
+        buf->alloc = alloc;
+    }
+    if (len) memcpy( buf->data + buf->size, data, len );
+    memset( buf->data + buf->size + len, 0, size - len );
+    buf->size += size;
+    return 1;
+}
+
+/* append a key and its subkeys to a hive buffer */
+/* old_pos is the position of the key in the previous image, or HIVE_NO_POS */
+static int save_hive_key( struct hive_buffer *buf, struct key *key, const struct key *base,
+                          unsigned int old_pos )
+{
+    struct hive_key rec, *ptr;
+    unsigned int nb_subkeys = 0, pos = buf->size;
+    struct key_value *value;
+    struct key *subkey;
+
+    if (buf->old && old_pos != HIVE_NO_POS && !(key->flags & KEY_DIRTY))
+    {
+        /* the whole subtree is unchanged since the previous image, copy it as is */
+        const struct hive_key *old = (const struct hive_key *)(buf->old + old_pos);
+        return hive_append( buf, old, old->size );
+    }
+
+    rec.size       = 0;
+    rec.flags      = (key->flags & KEY_SYMLINK) ? HIVE_KEY_SYMLINK : 0;
+    rec.modif[0]   = (unsigned int)key->modif;
+    rec.modif[1]   = (unsigned int)(key->modif >> 32);
+    rec.namelen    = (key != base) ? key->obj.name->len : 0;
+    rec.classlen   = key->classlen;
+    rec.nb_values  = key->last_value + 1;
+    rec.nb_subkeys = 0;
+    if (!hive_append( buf, &rec, sizeof(rec) )) return 0;
+    if (!hive_append( buf, rec.namelen ? key->obj.name->name : NULL, rec.namelen )) return 0;
+    if (!hive_append( buf, key->class, key->classlen )) return 0;
+
+    NAME_TREE_FOR_EACH_ENTRY( value, key->values, struct key_value, entry )
+    {
+        struct hive_value val;
+
+        val.size    = sizeof(val) + hive_align( value->namelen ) + hive_align( value->len );
+        val.type    = value->type;
+        val.namelen = value->namelen;
+        val.len     = value->len;
+        if (!hive_append( buf, &val, sizeof(val) )) return 0;
+        if (!hive_append( buf, value->name, value->namelen )) return 0;
+        if (!hive_append( buf, value->data, value->len )) return 0;
+    }
+
+    NAME_TREE_FOR_EACH_ENTRY( subkey, key->subkeys, struct key, entry )
+    {
+        unsigned int sub_pos = buf->size, sub_old_pos = HIVE_NO_POS;
+
+        if (subkey->flags & KEY_VOLATILE) continue;
+        if (old_pos != HIVE_NO_POS && subkey->hive_pos != HIVE_NO_POS)
+            sub_old_pos = old_pos + subkey->hive_pos;
+        if (!save_hive_key( buf, subkey, base, sub_old_pos )) return 0;
+        subkey->hive_pos = sub_pos - pos;
+        nb_subkeys++;
+    }
+
+    ptr = (struct hive_key *)(buf->data + pos);
+    ptr->size = buf->size - pos;
+    ptr->nb_subkeys = nb_subkeys;
+    return 1;
+}
+
+/* free the image of the last save of a branch */
+static void free_branch_image( struct save_branch_info *info )
+{
+    if (info->image_mapped) munmap( (void *)info->image, info->image_size );
+    else free( (void *)info->image );
+    info->image = NULL;
+    info->image_size = 0;
+    info->image_mapped = 0;
+}
+
+/* build a new image of a branch, copying the unmodified subtrees from the previous one */
+static int build_branch_image( struct save_branch_info *info )
+{
+    struct hive_buffer buf = { NULL, 0, 0, info->image };
+    struct hive_header header;
+    int ret;
+
+    memcpy( header.magic, hive_magic, sizeof(hive_magic) );
+    header.version  = HIVE_VERSION;
+    header.arch     = prefix_type;
+    header.size     = 0;
+    header.reserved = 0;
+    ret = (hive_append( &buf, &header, sizeof(header) ) &&
+           save_hive_key( &buf, info->key, info->key, info->image ? sizeof(header) : HIVE_NO_POS ));
+
+    /* the saved positions of the keys now refer to the new image, so the old one is useless */
+    free_branch_image( info );
+    if (!ret)
+    {
+        free( buf.data );
+        return 0;
+    }
+    ((struct hive_header *)buf.data)->size = buf.size;
+    info->image = buf.data;
+    info->image_size = buf.size;
+    return 1;
+}
+
+/* save a key record of an image and its subkeys to a text file, in the same way as save_subkeys */
+static void save_image_subkeys( const char *ptr, const struct hive_key **path, unsigned int depth, FILE *f )
+{
+    const struct hive_key *rec = (const struct hive_key *)ptr;
+    unsigned int i, pos = sizeof(*rec) + hive_align( rec->namelen );
+    timeout_t modif = ((timeout_t)rec->modif[1] << 32) | rec->modif[0];
+
+    path[depth] = rec;
+    if (rec->nb_values || !rec->nb_subkeys || rec->classlen || (rec->flags & HIVE_KEY_SYMLINK))
+    {
+        fprintf( f, "\n[" );
+        for (i = 1; i <= depth; i++)
+        {
+            if (i > 1) fprintf( f, "\\\\" );
+            dump_strW( (const WCHAR *)(path[i] + 1), path[i]->namelen, f, "[]" );
+        }
+        fprintf( f, "] %u\n", (unsigned int)((modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+        fprintf( f, "#time=%x%08x\n", rec->modif[1], rec->modif[0] );
+        if (rec->classlen)
+        {
+            fprintf( f, "#class=\"" );
+            dump_strW( (const WCHAR *)(ptr + pos), rec->classlen, f, "\"\"" );
+            fprintf( f, "\"\n" );
+        }
+        if (rec->flags & HIVE_KEY_SYMLINK) fputs( "#link\n", f );
+    }
+    pos += hive_align( rec->classlen );
+
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        const struct hive_value *val = (const struct hive_value *)(ptr + pos);
+        struct key_value value;
+
+        value.name    = (WCHAR *)(val + 1);
+        value.namelen = val->namelen;
+        value.type    = val->type;
+        value.len     = val->len;
+        value.data    = (char *)(val + 1) + hive_align( val->namelen );
+        dump_value( &value, f );
+        pos += val->size;
+    }
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        save_image_subkeys( ptr + pos, path, depth + 1, f );
+        pos += ((const struct hive_key *)(ptr + pos))->size;
     }
+}
+
+/* write the image of a branch to its file; this may be done in the save thread */
+static int write_branch_file( struct save_branch_info *info )
+{
+    static const struct hive_key *path[HIVE_MAX_DEPTH + 1];
+
+    if (info->hive) fwrite( info->image, info->image_size, 1, info->file );
+    else save_image_subkeys( info->image + sizeof(struct hive_header), path, 0, info->file );
+    return !fclose( info->file );
+}
+
+/* open the file to save a registry branch to, and write the text header if needed */
+static int open_branch_file( struct save_branch_info *info )
+{
+    const char *path = info->hive ? info->hive_path : info->path;
+    struct stat st;
+    char *p;
+    int fd, count = 0;
+
+    info->tmp = NULL;
 
     /* test the file type */
 
-    if ((fd = open( path, O_WRONLY )) != -1)
+    if (!info->hive && (fd = open( path, O_WRONLY )) != -1)
     {
         /* if file is not a regular file or has multiple links or is accessed
          * via symbolic links, write directly into it; otherwise use a temp file */
@@ -2075,59 +2731,209 @@ static int save_branch( struct key *key, const char *path )
 
     /* create a temp file in the same directory */
 
-    if (!(tmp = malloc( strlen(path) + 20 ))) goto done;
-    strcpy( tmp, path );
-    if ((p = strrchr( tmp, '/' ))) p++;
-    else p = tmp;
+    if (!(info->tmp = malloc( strlen(path) + 20 ))) return 0;
+    strcpy( info->tmp, path );
+    if ((p = strrchr( info->tmp, '/' ))) p++;
+    else p = info->tmp;
     for (;;)
     {
         sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
-        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
-        if (errno != EEXIST) goto done;
-        close( fd );
+        if ((fd = open( info->tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST) goto failed;
     }
 
     /* now save to it */
 
  save:
-    if (!(f = fdopen( fd, "w" )))
+    if (!(info->file = fdopen( fd, "w" )))
     {
-        if (tmp) unlink( tmp );
+        if (info->tmp) unlink( info->tmp );
         close( fd );
-        goto done;
+        goto failed;
+    }
+    if (!info->hive) save_header( info->key, info->file );
+    return 1;
+
+ failed:
+    free( info->tmp );
+    info->tmp = NULL;
+    return 0;
+}
+
+/* start saving a registry branch; return 1 if the file needs to be written, 0 if the branch is
+ * clean, -1 on error */
+static int prepare_branch_save( struct save_branch_info *info )
+{
+    struct key *key = info->key;
+
+    if (!(key->flags & KEY_DIRTY))
+    {
+        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
+        return 0;
     }
 
+    info->hive = use_hive && info->hive_path;
+    if (!build_branch_image( info )) return -1;
+    if (!open_branch_file( info )) return -1;
+
     if (debug_level > 1)
     {
-        fprintf( stderr, "%s: ", path );
+        fprintf( stderr, "%s: ", info->hive ? info->hive_path : info->path );
         dump_operation( key, NULL, "saving" );
     }
 
-    save_all_subkeys( key, f );
-    ret = !fclose(f);
+    /* modifications made from now on will be saved next time */
+    make_clean( key );
+    return 1;
+}
 
-    if (tmp)
+/* finish saving a registry branch once its file has been written */
+static int complete_branch_save( struct save_branch_info *info, int ret )
+{
+    const char *path = info->hive ? info->hive_path : info->path;
+
+    if (info->tmp)
     {
         /* if successfully written, rename to final name */
-        if (ret) ret = !rename( tmp, path );
-        if (!ret) unlink( tmp );
+        if (ret) ret = !rename( info->tmp, path );
+        if (!ret) unlink( info->tmp );
+        free( info->tmp );
+        info->tmp = NULL;
     }
+    info->file = NULL;
+
+    /* the text file supersedes the hive */
+    if (ret && !info->hive && info->hive_path) unlink( info->hive_path );
 
-done:
-    free( tmp );
-    if (ret) make_clean( key );
+    /* the image is still valid, so the next save only needs to write it again */
+    if (!ret) make_dirty( info->key );
     return ret;
 }
 
+/* save a registry branch to a file */
+static int save_branch( struct save_branch_info *info )
+{
+    int ret = prepare_branch_save( info );
+
+    if (ret <= 0) return !ret;
+    return complete_branch_save( info, write_branch_file( info ));
+}
+
+/* state of the save thread */
+static enum { SAVE_NONE, SAVE_IDLE, SAVE_QUEUED, SAVE_WRITTEN } save_state;
+static pthread_mutex_t save_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t save_cond = PTHREAD_COND_INITIALIZER;
+static struct timeout_user *save_check_user;  /* timer checking for the end of the save */
+
+/* thread writing the saved branches to disk, so that the main loop doesn't have to wait for it */
+static void *save_thread( void *arg )
+{
+    int i;
+
+    pthread_mutex_lock( &save_mutex );
+    for (;;)
+    {
+        while (save_state != SAVE_QUEUED) pthread_cond_wait( &save_cond, &save_mutex );
+        pthread_mutex_unlock( &save_mutex );
+
+        for (i = 0; i < save_branch_count; i++)
+        {
+            struct save_branch_info *info = &save_branch_info[i];
+            if (info->file) info->status = write_branch_file( info );
+        }
+
+        pthread_mutex_lock( &save_mutex );
+        save_state = SAVE_WRITTEN;
+        pthread_cond_broadcast( &save_cond );
+    }
+    return NULL;
+}
+
+/* start the save thread if needed */
+static int start_save_thread(void)
+{
+    sigset_t set, old_set;
+    pthread_t thread;
+
+    if (save_state != SAVE_NONE) return 1;
+
+    /* signals are handled by the main thread */
+    sigfillset( &set );
+    pthread_sigmask( SIG_BLOCK, &set, &old_set );
+    if (!pthread_create( &thread, NULL, save_thread, NULL ))
+    {
+        pthread_detach( thread );
+        save_state = SAVE_IDLE;
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    return save_state != SAVE_NONE;
+}
+
+/* complete the branch saves done by the save thread; return 0 if it is still writing them */
+static int finish_thread_saves( int wait )
+{
+    int i;
+
+    pthread_mutex_lock( &save_mutex );
+    if (save_state == SAVE_QUEUED && !wait)
+    {
+        pthread_mutex_unlock( &save_mutex );
+        return 0;
+    }
+    while (save_state == SAVE_QUEUED) pthread_cond_wait( &save_cond, &save_mutex );
+    pthread_mutex_unlock( &save_mutex );
+
+    if (save_state != SAVE_WRITTEN) return 1;
+    for (i = 0; i < save_branch_count; i++)
+    {
+        struct save_branch_info *info = &save_branch_info[i];
+        if (info->file) complete_branch_save( info, info->status );
+    }
+    save_state = SAVE_IDLE;
+    if (save_check_user) remove_timeout_user( save_check_user );
+    save_check_user = NULL;
+    return 1;
+}
+
+/* check if the save thread is done */
+static void check_thread_saves( void *arg )
+{
+    save_check_user = NULL;
+    if (fchdir( config_dir_fd ) == -1) return;
+    if (!finish_thread_saves( 0 )) save_check_user = add_timeout_user( -TICKS_PER_SEC / 10, check_thread_saves, NULL );
+    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
-    int i;
+    int i, count = 0;
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+
+    /* the image and the file of a branch are busy until the previous save is done */
+    if (finish_thread_saves( 0 ))
+    {
+        if (start_save_thread())
+        {
+            for (i = 0; i < save_branch_count; i++)
+                if (prepare_branch_save( &save_branch_info[i] ) > 0) count++;
+        }
+        else
+        {
+            for (i = 0; i < save_branch_count; i++) save_branch( &save_branch_info[i] );
+        }
+    }
+
+    if (count)
+    {
+        pthread_mutex_lock( &save_mutex );
+        save_state = SAVE_QUEUED;
+        pthread_cond_broadcast( &save_cond );
+        pthread_mutex_unlock( &save_mutex );
+        save_check_user = add_timeout_user( -TICKS_PER_SEC / 10, check_thread_saves, NULL );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2145,9 +2951,10 @@ void flush_registry(void)
     int i;
 
     if (fchdir( config_dir_fd ) == -1) return;
+    finish_thread_saves( 1 );
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i] ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
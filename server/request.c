@@ -31,11 +31,15 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
@@ -44,6 +48,7 @@
 #endif
 #include <unistd.h>
 #include <poll.h>
+#include <pthread.h>
 #ifdef __APPLE__
 # include <mach/mach_time.h>
 #endif
@@ -118,8 +123,8 @@ static const struct fd_ops master_socket_fd_ops =
 };
 
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+__thread struct thread *current = NULL;  /* thread handling the current request */
+__thread unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 char *server_dir = NULL;   /* server directory */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
@@ -246,46 +251,129 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
-/* send a reply to the current thread */
-static void send_reply( union generic_reply *reply )
+#ifdef __linux__
+static void wake_request_shm( struct request_shm *shm )
 {
-    int ret;
+    syscall( __NR_futex, &shm->state, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+}
+#endif
 
-    if (!current->reply_size)
+/* create the shared memory used to send replies to a thread; return the fd to send to the client */
+int create_request_shm( struct thread *thread )
+{
+#ifdef __linux__
+    const char *env = getenv( "WINEREQUESTSHM" );
+    void *ptr;
+    int fd;
+
+    if (env && atoi( env ))
     {
-        if ((ret = write( get_unix_fd( current->reply_fd ),
-                          reply, sizeof(*reply) )) != sizeof(*reply)) goto error;
+        if (thread->request_shm)
+        {
+            set_error( STATUS_ACCESS_DENIED );
+            return -1;
+        }
+        if ((fd = create_temp_file( REQUEST_SHM_SIZE )) == -1)
+        {
+            file_set_error();
+            return -1;
+        }
+        if ((ptr = mmap( NULL, REQUEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+        {
+            file_set_error();
+            close( fd );
+            return -1;
+        }
+        thread->request_shm = ptr;
+        thread->request_shm->size = REQUEST_SHM_SIZE - sizeof(struct request_shm) - sizeof(union generic_reply);
+        return fd;
     }
-    else
-    {
-        struct iovec vec[2];
+#endif
+    set_error( STATUS_NOT_IMPLEMENTED );
+    return -1;
+}
+
+/* unmap the reply shared memory of a thread, waking up the client if it's waiting for a reply */
+void close_request_shm( struct thread *thread )
+{
+#ifdef __linux__
+    if (!thread->request_shm) return;
+    if (__atomic_exchange_n( &thread->request_shm->state, REQUEST_SHM_CLOSED,
+                             __ATOMIC_SEQ_CST ) == REQUEST_SHM_WAITING)
+        wake_request_shm( thread->request_shm );
+    munmap( thread->request_shm, REQUEST_SHM_SIZE );
+    thread->request_shm = NULL;
+#endif
+}
+
+/* send a reply through the shared memory if the client expects it there */
+static int send_shm_reply( struct thread *thread, union generic_reply *reply )
+{
+#ifdef __linux__
+    struct request_shm *shm = thread->request_shm;
+    union generic_reply *shm_reply = (union generic_reply *)(shm + 1);
+    int state = __atomic_load_n( &shm->state, __ATOMIC_ACQUIRE );
+
+    if (state != REQUEST_SHM_PENDING && state != REQUEST_SHM_WAITING) return 0;
+    if (thread->reply_size > REQUEST_SHM_SIZE - sizeof(*shm) - sizeof(*reply)) return 0;
+
+    *shm_reply = *reply;
+    memcpy( shm_reply + 1, thread->reply_data, thread->reply_size );
+    if (__atomic_exchange_n( &shm->state, REQUEST_SHM_REPLY, __ATOMIC_SEQ_CST ) == REQUEST_SHM_WAITING)
+        wake_request_shm( shm );
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* write a reply and its data to the client; return the number of bytes written */
+static int try_send_reply( struct thread *thread, union generic_reply *reply )
+{
+    struct iovec vec[2];
+
+    if (thread->request_shm && send_shm_reply( thread, reply ))
+        return sizeof(*reply) + thread->reply_size;
 
-        vec[0].iov_base = (void *)reply;
-        vec[0].iov_len  = sizeof(*reply);
-        vec[1].iov_base = current->reply_data;
-        vec[1].iov_len  = current->reply_size;
+    if (!thread->reply_size) return write( get_unix_fd( thread->reply_fd ), reply, sizeof(*reply) );
 
-        if ((ret = writev( get_unix_fd( current->reply_fd ), vec, 2 )) < sizeof(*reply)) goto error;
+    vec[0].iov_base = (void *)reply;
+    vec[0].iov_len  = sizeof(*reply);
+    vec[1].iov_base = thread->reply_data;
+    vec[1].iov_len  = thread->reply_size;
+    return writev( get_unix_fd( thread->reply_fd ), vec, 2 );
+}
 
-        if ((current->reply_towrite = current->reply_size - (ret - sizeof(*reply))))
+/* handle the result of try_send_reply */
+static void finish_reply( struct thread *thread, int ret, int err )
+{
+    if (ret >= (int)sizeof(union generic_reply))
+    {
+        if ((thread->reply_towrite = thread->reply_size - (ret - sizeof(union generic_reply))))
         {
             /* couldn't write it all, wait for POLLOUT */
-            set_fd_events( current->reply_fd, POLLOUT );
-            set_fd_events( current->request_fd, 0 );
+            set_fd_events( thread->reply_fd, POLLOUT );
+            set_fd_events( thread->request_fd, 0 );
             return;
         }
+        free( thread->reply_data );
+        thread->reply_data = NULL;
+        return;
     }
-    free( current->reply_data );
-    current->reply_data = NULL;
-    return;
 
- error:
     if (ret >= 0)
-        fatal_protocol_error( current, "partial write %d\n", ret );
-    else if (errno == EPIPE)
-        kill_thread( current, 0 );  /* normal death */
+        fatal_protocol_error( thread, "partial write %d\n", ret );
+    else if (err == EPIPE)
+        kill_thread( thread, 0 );  /* normal death */
     else
-        fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
+        fatal_protocol_error( thread, "reply write: %s\n", strerror( err ));
+}
+
+/* send a reply to the current thread */
+static void send_reply( union generic_reply *reply )
+{
+    int ret = try_send_reply( current, reply );
+    finish_reply( current, ret, errno );
 }
 
 /* call a request handler */
@@ -324,6 +412,197 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* Concurrent dispatch of read-only requests
+ *
+ * Requests that only look at server state can be run by a pool of worker
+ * threads. They are collected while the main loop processes a round of poll
+ * events, and run together once the round is over. The main thread takes part
+ * in the batch and doesn't touch any object until all the handlers are done,
+ * so the handlers only race against each other; they must not modify anything
+ * except object reference counts, which are updated atomically while a batch
+ * is running. Replies that can't be written at once, and errors, are handled
+ * by the main thread afterwards.
+ */
+
+#define MAX_BATCHED_REQUESTS 256
+
+struct batched_request
+{
+    struct thread *thread;  /* thread that sent the request */
+    int            ret;     /* result of the reply write */
+    int            err;     /* errno of the reply write */
+};
+
+static const enum request concurrent_request_list[] =
+{
+    REQ_query_event,
+    REQ_query_semaphore,
+    REQ_query_mutex,
+    REQ_get_object_info,
+    REQ_get_object_name,
+    REQ_get_key_value,
+    REQ_enum_key,
+    REQ_enum_key_value,
+};
+
+int concurrent_dispatch = 0;  /* set while a batch of requests is running */
+
+static unsigned char is_concurrent_request[REQ_NB_REQUESTS];
+static struct batched_request batch[MAX_BATCHED_REQUESTS];
+static unsigned int batch_count;
+static unsigned int batch_next;        /* next entry to run, updated atomically */
+static unsigned int batch_done;        /* number of entries finished */
+static unsigned int batch_generation;  /* incremented for each batch */
+static unsigned int nb_workers;
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batch_done_cond = PTHREAD_COND_INITIALIZER;
+
+/* run a batched request handler and write the reply */
+static void run_batched_request( struct batched_request *entry )
+{
+    union generic_reply reply;
+    struct thread *thread = entry->thread;
+
+    current = thread;
+    current->reply_size = 0;
+    clear_error();
+    memset( &reply, 0, sizeof(reply) );
+
+    req_handlers[thread->req.request_header.req]( &current->req, &reply );
+
+    reply.reply_header.error = current->error;
+    reply.reply_header.reply_size = current->reply_size;
+    entry->ret = try_send_reply( thread, &reply );
+    entry->err = errno;
+    current = NULL;
+}
+
+/* run batch entries until there are none left */
+static void run_batch_entries(void)
+{
+    unsigned int i, count = 0;
+
+    while ((i = __atomic_fetch_add( &batch_next, 1, __ATOMIC_RELAXED )) < batch_count)
+    {
+        run_batched_request( &batch[i] );
+        count++;
+    }
+    if (!count) return;
+
+    pthread_mutex_lock( &batch_mutex );
+    if ((batch_done += count) == batch_count) pthread_cond_signal( &batch_done_cond );
+    pthread_mutex_unlock( &batch_mutex );
+}
+
+static void *request_worker( void *arg )
+{
+    unsigned int generation = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &batch_mutex );
+        while (generation == batch_generation) pthread_cond_wait( &batch_start_cond, &batch_mutex );
+        generation = batch_generation;
+        pthread_mutex_unlock( &batch_mutex );
+        run_batch_entries();
+    }
+    return NULL;
+}
+
+/* start the request worker threads, if enabled */
+void init_request_workers(void)
+{
+    const char *env = getenv( "WINESERVER_THREADS" );
+    sigset_t set, old_set;
+    pthread_t thread;
+    int i, count;
+
+    if (!env || (count = atoi( env )) <= 1) return;
+    if (count > 64) count = 64;
+
+    for (i = 0; i < ARRAY_SIZE(concurrent_request_list); i++)
+        is_concurrent_request[concurrent_request_list[i]] = 1;
+
+    /* signals are handled by the main thread */
+    sigfillset( &set );
+    pthread_sigmask( SIG_BLOCK, &set, &old_set );
+    for (i = 1; i < count; i++)  /* the main thread is a worker too */
+    {
+        if (pthread_create( &thread, NULL, request_worker, NULL )) break;
+        pthread_detach( thread );
+        nb_workers++;
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+}
+
+/* run the requests collected during the last round of poll events */
+void process_batched_requests(void)
+{
+    unsigned int i, count = 0;
+
+    if (!batch_count) return;
+
+    /* drop the requests of the threads that died in the meantime */
+    for (i = 0; i < batch_count; i++)
+    {
+        if (batch[i].thread->reply_fd) batch[count++] = batch[i];
+        else release_object( batch[i].thread );
+    }
+    batch_count = count;
+
+    if (batch_count == 1) run_batched_request( &batch[0] );
+    else if (batch_count)
+    {
+        concurrent_dispatch = 1;
+        batch_next = batch_done = 0;
+        pthread_mutex_lock( &batch_mutex );
+        batch_generation++;
+        pthread_cond_broadcast( &batch_start_cond );
+        pthread_mutex_unlock( &batch_mutex );
+
+        run_batch_entries();
+
+        pthread_mutex_lock( &batch_mutex );
+        while (batch_done < batch_count) pthread_cond_wait( &batch_done_cond, &batch_mutex );
+        pthread_mutex_unlock( &batch_mutex );
+        concurrent_dispatch = 0;
+    }
+
+    for (i = 0; i < batch_count; i++)
+    {
+        struct thread *thread = batch[i].thread;
+
+        if (thread->reply_fd)
+        {
+            finish_reply( thread, batch[i].ret, batch[i].err );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            if (thread->request_fd && !thread->reply_towrite) set_fd_events( thread->request_fd, POLLIN );
+        }
+        release_object( thread );
+    }
+    batch_count = 0;
+}
+
+/* handle a request that has been read completely */
+static void handle_request( struct thread *thread )
+{
+    enum request req = thread->req.request_header.req;
+
+    if (nb_workers && !debug_level && req < REQ_NB_REQUESTS && is_concurrent_request[req])
+    {
+        /* no more requests from this thread until it gets the reply */
+        set_fd_events( thread->request_fd, 0 );
+        batch[batch_count++].thread = (struct thread *)grab_object( thread );
+        if (batch_count == MAX_BATCHED_REQUESTS) process_batched_requests();
+        return;
+    }
+    call_req_handler( thread );
+    free( thread->req_data );
+    thread->req_data = NULL;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
@@ -336,7 +615,7 @@ void read_request( struct thread *thread )
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
-            call_req_handler( thread );
+            handle_request( thread );
             return;
         }
         if (!(thread->req_data = malloc( thread->req_toread )))
@@ -357,9 +636,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
-            call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            handle_request( thread );
             return;
         }
     }
@@ -54,6 +54,10 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern int create_request_shm( struct thread *thread );
+extern void close_request_shm( struct thread *thread );
+extern void init_request_workers(void);
+extern void process_batched_requests(void);
 extern timeout_t monotonic_counter(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -126,6 +130,7 @@ DECL_HANDLER(get_startup_info);
 DECL_HANDLER(init_process_done);
 DECL_HANDLER(init_first_thread);
 DECL_HANDLER(init_thread);
+DECL_HANDLER(get_request_shm);
 DECL_HANDLER(terminate_process);
 DECL_HANDLER(terminate_thread);
 DECL_HANDLER(get_process_info);
@@ -141,6 +146,7 @@ DECL_HANDLER(resume_thread);
 DECL_HANDLER(queue_apc);
 DECL_HANDLER(get_apc_result);
 DECL_HANDLER(close_handle);
+DECL_HANDLER(get_handle_table_shm);
 DECL_HANDLER(set_handle_info);
 DECL_HANDLER(dup_handle);
 DECL_HANDLER(compare_objects);
@@ -161,6 +167,9 @@ DECL_HANDLER(query_mutex);
 DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
+DECL_HANDLER(get_fast_sync_shm);
+DECL_HANDLER(get_fast_sync_slot);
+DECL_HANDLER(fast_sync_wake);
 DECL_HANDLER(open_semaphore);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
@@ -188,6 +197,7 @@ DECL_HANDLER(unmap_view);
 DECL_HANDLER(get_mapping_committed_range);
 DECL_HANDLER(add_mapping_committed_range);
 DECL_HANDLER(is_same_mapping);
+DECL_HANDLER(add_import_cache);
 DECL_HANDLER(get_mapping_filename);
 DECL_HANDLER(list_processes);
 DECL_HANDLER(create_debug_obj);
@@ -229,6 +239,7 @@ DECL_HANDLER(get_msg_queue);
 DECL_HANDLER(set_queue_fd);
 DECL_HANDLER(set_queue_mask);
 DECL_HANDLER(get_queue_status);
+DECL_HANDLER(get_queue_shm);
 DECL_HANDLER(get_process_idle_event);
 DECL_HANDLER(send_message);
 DECL_HANDLER(post_quit_message);
@@ -371,7 +382,11 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
+DECL_HANDLER(create_wait_completion_packet);
+DECL_HANDLER(associate_wait_completion_packet);
+DECL_HANDLER(cancel_wait_completion_packet);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
 DECL_HANDLER(set_fd_completion_mode);
@@ -410,6 +425,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_init_process_done,
     (req_handler)req_init_first_thread,
     (req_handler)req_init_thread,
+    (req_handler)req_get_request_shm,
     (req_handler)req_terminate_process,
     (req_handler)req_terminate_thread,
     (req_handler)req_get_process_info,
@@ -425,6 +441,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_queue_apc,
     (req_handler)req_get_apc_result,
     (req_handler)req_close_handle,
+    (req_handler)req_get_handle_table_shm,
     (req_handler)req_set_handle_info,
     (req_handler)req_dup_handle,
     (req_handler)req_compare_objects,
@@ -445,6 +462,9 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_semaphore,
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
+    (req_handler)req_get_fast_sync_shm,
+    (req_handler)req_get_fast_sync_slot,
+    (req_handler)req_fast_sync_wake,
     (req_handler)req_open_semaphore,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
@@ -472,6 +492,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_mapping_committed_range,
     (req_handler)req_add_mapping_committed_range,
     (req_handler)req_is_same_mapping,
+    (req_handler)req_add_import_cache,
     (req_handler)req_get_mapping_filename,
     (req_handler)req_list_processes,
     (req_handler)req_create_debug_obj,
@@ -513,6 +534,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_queue_fd,
     (req_handler)req_set_queue_mask,
     (req_handler)req_get_queue_status,
+    (req_handler)req_get_queue_shm,
     (req_handler)req_get_process_idle_event,
     (req_handler)req_send_message,
     (req_handler)req_post_quit_message,
@@ -655,7 +677,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
+    (req_handler)req_create_wait_completion_packet,
+    (req_handler)req_associate_wait_completion_packet,
+    (req_handler)req_cancel_wait_completion_packet,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
     (req_handler)req_set_fd_completion_mode,
@@ -771,6 +797,9 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_request, entry) == 32 );
 C_ASSERT( sizeof(struct init_thread_request) == 40 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, suspend) == 8 );
 C_ASSERT( sizeof(struct init_thread_reply) == 16 );
+C_ASSERT( sizeof(struct get_request_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_request_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, exit_code) == 16 );
 C_ASSERT( sizeof(struct terminate_process_request) == 24 );
@@ -867,6 +896,9 @@ C_ASSERT( FIELD_OFFSET(struct get_apc_result_reply, result) == 8 );
 C_ASSERT( sizeof(struct get_apc_result_reply) == 48 );
 C_ASSERT( FIELD_OFFSET(struct close_handle_request, handle) == 12 );
 C_ASSERT( sizeof(struct close_handle_request) == 16 );
+C_ASSERT( sizeof(struct get_handle_table_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_handle_table_shm_reply, count) == 8 );
+C_ASSERT( sizeof(struct get_handle_table_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, mask) == 20 );
@@ -978,6 +1010,17 @@ C_ASSERT( sizeof(struct query_semaphore_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_semaphore_reply, current) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_semaphore_reply, max) == 12 );
 C_ASSERT( sizeof(struct query_semaphore_reply) == 16 );
+C_ASSERT( sizeof(struct get_fast_sync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_shm_reply, count) == 8 );
+C_ASSERT( sizeof(struct get_fast_sync_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_slot_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_reply, index) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_reply, serial) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_slot_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_fast_sync_slot_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct fast_sync_wake_request, handle) == 12 );
+C_ASSERT( sizeof(struct fast_sync_wake_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
@@ -1133,6 +1176,10 @@ C_ASSERT( sizeof(struct add_mapping_committed_range_request) == 40 );
 C_ASSERT( FIELD_OFFSET(struct is_same_mapping_request, base1) == 16 );
 C_ASSERT( FIELD_OFFSET(struct is_same_mapping_request, base2) == 24 );
 C_ASSERT( sizeof(struct is_same_mapping_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct add_import_cache_request, hash) == 12 );
+C_ASSERT( FIELD_OFFSET(struct add_import_cache_request, descr) == 16 );
+C_ASSERT( FIELD_OFFSET(struct add_import_cache_request, modules) == 20 );
+C_ASSERT( sizeof(struct add_import_cache_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_filename_request, process) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_mapping_filename_request, addr) == 16 );
 C_ASSERT( sizeof(struct get_mapping_filename_request) == 24 );
@@ -1325,6 +1372,10 @@ C_ASSERT( sizeof(struct get_queue_status_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_queue_status_reply, wake_bits) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_queue_status_reply, changed_bits) == 12 );
 C_ASSERT( sizeof(struct get_queue_status_reply) == 16 );
+C_ASSERT( sizeof(struct get_queue_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_reply, offset) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_shm_reply, id) == 12 );
+C_ASSERT( sizeof(struct get_queue_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_process_idle_event_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_process_idle_event_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_process_idle_event_reply, event) == 8 );
@@ -2160,10 +2211,30 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
 C_ASSERT( sizeof(struct query_completion_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_wait_completion_packet_request, access) == 12 );
+C_ASSERT( sizeof(struct create_wait_completion_packet_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_wait_completion_packet_reply, handle) == 8 );
+C_ASSERT( sizeof(struct create_wait_completion_packet_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, packet) == 12 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, completion) == 16 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, target) == 20 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, ckey) == 24 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, cvalue) == 32 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, information) == 40 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, status) == 48 );
+C_ASSERT( sizeof(struct associate_wait_completion_packet_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_reply, signaled) == 8 );
+C_ASSERT( sizeof(struct associate_wait_completion_packet_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct cancel_wait_completion_packet_request, packet) == 12 );
+C_ASSERT( FIELD_OFFSET(struct cancel_wait_completion_packet_request, remove_signaled) == 16 );
+C_ASSERT( sizeof(struct cancel_wait_completion_packet_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, ckey) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, chandle) == 24 );
@@ -237,6 +237,7 @@ struct sock
     struct accept_req  *accept_recv_req; /* pending accept-into request which will recv on this socket */
     struct connect_req *connect_req; /* pending connection request */
     struct poll_req    *main_poll;   /* main poll */
+    struct fast_sync   *fast_sync;   /* requests that the client may complete by itself */
     union win_sockaddr  addr;        /* socket name */
     int                 addr_len;    /* socket name length */
     unsigned int        rcvbuf;      /* advisory recv buffer size */
@@ -747,6 +748,69 @@ void sock_init(void)
     }
 }
 
+static int sock_is_polled( struct sock *sock )
+{
+    struct poll_req *req;
+    unsigned int i;
+
+    LIST_FOR_EACH_ENTRY( req, &poll_list, struct poll_req, entry )
+    {
+        for (i = 0; i < req->count; ++i)
+            if (req->sockets[i].sock == sock) return 1;
+    }
+    return 0;
+}
+
+/* Update the requests that clients may complete on their own when they
+ * succeed immediately. This is only possible if nobody can observe that
+ * the server was not told about them: no completion port entry or handle
+ * signal is due on success, no other request is queued, and no event
+ * selection or poll depends on the events being reset.
+ * Polls can be done by the client as long as the socket state doesn't
+ * need to be updated from the poll results, i.e. there is no pending
+ * connection and no hangup or error to be recorded yet. */
+static void sock_update_fast_sync( struct sock *sock )
+{
+    const unsigned int skip_flags = FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE;
+    struct completion *completion;
+    unsigned int flags = 0;
+    apc_param_t key;
+
+    if (!sock->fast_sync) return;
+
+    if (sock->fd && (completion = fd_get_completion( sock->fd, &key )))
+    {
+        flags |= FAST_SYNC_SOCKET_COMPLETION;
+        release_object( completion );
+    }
+
+    if ((sock->state == SOCK_CONNECTED || sock->state == SOCK_CONNECTIONLESS ||
+         sock->state == SOCK_LISTENING) && !sock->aborted && !sock->reset && !sock->hangup &&
+        !sock->errors[AFD_POLL_BIT_CONNECT_ERR])
+    {
+        flags |= FAST_SYNC_SOCKET_POLL;
+        if (sock->type == WS_SOCK_STREAM) flags |= FAST_SYNC_SOCKET_STREAM;
+        if (sock->state == SOCK_LISTENING) flags |= FAST_SYNC_SOCKET_LISTENING;
+        if (sock->state == SOCK_CONNECTED) flags |= FAST_SYNC_SOCKET_CONNECTED;
+    }
+
+    /* ICMP sockets may be emulated over datagram sockets, which need the server
+     * to keep track of the echo ids, so only the server may complete them */
+    if (sock->fd && (get_fd_comp_flags( sock->fd ) & skip_flags) == skip_flags &&
+        sock->proto != WS_IPPROTO_ICMP && (sock->state == SOCK_CONNECTED || sock->state == SOCK_CONNECTIONLESS) &&
+        !sock->aborted && !sock->reset && !sock->mask && !sock_is_polled( sock ))
+    {
+        if (!sock->rd_shutdown && !async_queued( &sock->read_q ) &&
+            !((sock->pending_events | sock->reported_events) & AFD_POLL_READ))
+            flags |= FAST_SYNC_SOCKET_RECV;
+
+        if (!sock->wr_shutdown && !sock->wr_shutdown_pending && !async_queued( &sock->write_q ) &&
+            (sock->type != WS_SOCK_DGRAM || sock->bound))
+            flags |= FAST_SYNC_SOCKET_SEND;
+    }
+    fast_sync_set_state( sock->fast_sync, flags );
+}
+
 static void sock_reselect( struct sock *sock )
 {
     int ev = sock_get_poll_events( sock->fd );
@@ -755,6 +819,23 @@ static void sock_reselect( struct sock *sock )
         fprintf(stderr,"sock_reselect(%p): new mask %x\n", sock, ev);
 
     set_fd_events( sock->fd, ev );
+    sock_update_fast_sync( sock );
+}
+
+struct fast_sync *get_sock_fast_sync( struct object *obj )
+{
+    struct sock *sock = (struct sock *)obj;
+
+    if (obj->ops != &sock_ops) return NULL;
+    /* the completion flags may have changed since the last update */
+    sock_update_fast_sync( sock );
+    return sock->fast_sync;
+}
+
+/* the completion port or flags of the socket fd have changed */
+void sock_completion_changed( struct object *obj )
+{
+    if (obj && obj->ops == &sock_ops) sock_update_fast_sync( (struct sock *)obj );
 }
 
 static unsigned int afd_poll_flag_to_win32( unsigned int flags )
@@ -1691,6 +1772,7 @@ static void sock_destroy( struct object *obj )
     free_async_queue( &sock->poll_q );
     if (sock->event) release_object( sock->event );
     if (sock->fd) release_object( sock->fd );
+    if (sock->fast_sync) free_fast_sync( sock->fast_sync );
 }
 
 static struct sock *create_socket(void)
@@ -1716,6 +1798,7 @@ static struct sock *create_socket(void)
     sock->accept_recv_req = NULL;
     sock->connect_req = NULL;
     sock->main_poll = NULL;
+    sock->fast_sync = alloc_fast_sync( FAST_SYNC_SOCKET, 0, 0 );
     memset( &sock->addr, 0, sizeof(sock->addr) );
     sock->addr_len = 0;
     sock->rd_shutdown = 0;
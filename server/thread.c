@@ -67,6 +67,8 @@ struct thread_wait
     abstime_t               when;
     struct timeout_user    *user;
     int                     status;     /* status to return (unless STATUS_PENDING) */
+    registered_wait_callback callback;  /* callback for registered waits */
+    void                   *private;    /* callback private data */
     struct wait_queue_entry queues[1];
 };
 
@@ -240,6 +242,7 @@ static inline void init_thread_structure( struct thread *thread )
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->request_shm     = NULL;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -420,6 +423,7 @@ static void cleanup_thread( struct thread *thread )
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    close_request_shm( thread );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
     free_msg_queue( thread );
@@ -793,6 +797,7 @@ static int wait_on( const select_op_t *select_op, unsigned int count, struct obj
     wait->user    = NULL;
     wait->when = when;
     wait->abandoned = 0;
+    wait->callback = NULL;
     current->wait = wait;
 
     for (i = 0, entry = wait->queues; i < count; i++, entry++)
@@ -942,6 +947,70 @@ int wake_thread_queue_entry( struct wait_queue_entry *entry )
     return 1;
 }
 
+/* satisfy a registered wait if its object is signaled; return 1 if it was */
+static int wake_registered_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = wait->queues;
+    registered_wait_callback callback = wait->callback;
+    void *private = wait->private;
+    unsigned int status;
+
+    if (!entry->obj->ops->signaled( entry->obj, entry )) return 0;
+
+    wait->status = STATUS_WAIT_0;
+    entry->obj->ops->satisfied( entry->obj, entry );
+    status = wait->status;
+    if (wait->abandoned) status += STATUS_ABANDONED_WAIT_0;
+    entry->obj->ops->remove_queue( entry->obj, entry );
+    free( wait );
+
+    callback( private, status );
+    return 1;
+}
+
+/* register a one-shot wait on an object on behalf of a thread, without blocking it */
+/* the callback is invoked once the wait is satisfied, after the wait structure is freed, */
+/* possibly before this function returns */
+int register_wait( struct thread *thread, struct object *obj, registered_wait_callback callback,
+                   void *private, struct thread_wait **ret )
+{
+    struct thread_wait *wait;
+
+    if (!(wait = mem_alloc( sizeof(*wait) ))) return 0;
+    wait->next      = NULL;
+    wait->thread    = thread;
+    wait->count     = 1;
+    wait->flags     = 0;
+    wait->select    = SELECT_WAIT;
+    wait->key       = 0;
+    wait->cookie    = 0;
+    wait->user      = NULL;
+    wait->when      = TIMEOUT_INFINITE;
+    wait->abandoned = 0;
+    wait->callback  = callback;
+    wait->private   = private;
+    wait->queues[0].wait = wait;
+
+    if (!obj->ops->add_queue( obj, &wait->queues[0] ))
+    {
+        free( wait );
+        return 0;
+    }
+    *ret = wait;
+    wake_registered_wait( wait );
+    return 1;
+}
+
+/* cancel a registered wait that has not been satisfied yet */
+void unregister_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = wait->queues;
+
+    assert( wait->callback );
+    entry->obj->ops->remove_queue( entry->obj, entry );
+    free( wait );
+}
+
 /* thread wait timeout */
 static void thread_timeout( void *ptr )
 {
@@ -1065,7 +1134,9 @@ void wake_up( struct object *obj, int max )
     LIST_FOR_EACH( ptr, &obj->wait_queue )
     {
         struct wait_queue_entry *entry = LIST_ENTRY( ptr, struct wait_queue_entry, entry );
-        if (!(ret = wake_thread( get_wait_queue_thread( entry )))) continue;
+        if (entry->wait->callback) ret = wake_registered_wait( entry->wait );
+        else ret = wake_thread( get_wait_queue_thread( entry ));
+        if (!ret) continue;
         if (ret > 0 && max && !--max) break;
         /* restart at the head of the list since a wake up can change the object wait queue */
         ptr = &obj->wait_queue;
@@ -1452,6 +1523,17 @@ DECL_HANDLER(init_thread)
     reply->suspend = (current->suspend || current->process->suspend || current->context != NULL);
 }
 
+/* get the shared memory used to send the replies to the current thread */
+DECL_HANDLER(get_request_shm)
+{
+    int fd;
+
+    if ((fd = create_request_shm( current )) == -1) return;
+    send_client_fd( current->process, fd, 0 );
+    close( fd );
+    reply->size = REQUEST_SHM_SIZE;
+}
+
 /* terminate a thread */
 DECL_HANDLER(terminate_thread)
 {
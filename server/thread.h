@@ -32,6 +32,9 @@ struct debug_obj;
 struct debug_event;
 struct msg_queue;
 
+/* callback invoked when a registered wait is satisfied */
+typedef void (*registered_wait_callback)( void *private, unsigned int status );
+
 enum run_state
 {
     RUNNING,    /* running normally */
@@ -70,6 +73,7 @@ struct thread
     struct fd             *request_fd;    /* fd for receiving client requests */
     struct fd             *reply_fd;      /* fd to send a reply to a client */
     struct fd             *wait_fd;       /* fd to use to wake a sleeping client */
+    struct request_shm    *request_shm;   /* shared memory to send replies to the client */
     enum run_state         state;         /* running state */
     int                    exit_code;     /* thread exit code */
     int                    unix_pid;      /* Unix pid of client */
@@ -92,7 +96,7 @@ struct thread
     WCHAR                 *desc;          /* thread description string */
 };
 
-extern struct thread *current;
+extern __thread struct thread *current;
 
 /* thread functions */
 
@@ -114,6 +118,9 @@ extern int add_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void remove_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void kill_thread( struct thread *thread, int violent_death );
 extern void wake_up( struct object *obj, int max );
+extern int register_wait( struct thread *thread, struct object *obj, registered_wait_callback callback,
+                          void *private, struct thread_wait **ret );
+extern void unregister_wait( struct thread_wait *wait );
 extern int thread_queue_apc( struct process *process, struct thread *thread, struct object *owner, const apc_call_t *call_data );
 extern void thread_cancel_apc( struct thread *thread, struct object *owner, enum apc_type type );
 extern int thread_add_inflight_fd( struct thread *thread, int client, int server );
@@ -133,7 +140,7 @@ extern int send_thread_signal( struct thread *thread, int sig );
 extern void get_selector_entry( struct thread *thread, int entry, unsigned int *base,
                                 unsigned int *limit, unsigned char *flags );
 
-extern unsigned int global_error;  /* global error code for when no thread is current */
+extern __thread unsigned int global_error;  /* global error code for when no thread is current */
 
 static inline unsigned int get_error(void)       { return current ? current->error : global_error; }
 static inline void set_error( unsigned int err ) { global_error = err; if (current) current->error = err; }
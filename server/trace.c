@@ -1339,6 +1339,25 @@ static void dump_varargs_rawinput_devices(const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_entries( const char *prefix, data_size_t size )
+{
+    const struct completion_entry *entry;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*entry))
+    {
+        entry = cur_data;
+        dump_uint64( "{ckey=", &entry->ckey );
+        dump_uint64( ",cvalue=", &entry->cvalue );
+        dump_uint64( ",information=", &entry->information );
+        fprintf( stderr, ",status=%s}", get_status_name( entry->status ));
+        size -= sizeof(*entry);
+        remove_data( sizeof(*entry) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
 {
     const struct handle_info *handle;
@@ -1470,6 +1489,15 @@ static void dump_init_thread_reply( const struct init_thread_reply *req )
     fprintf( stderr, " suspend=%d", req->suspend );
 }
 
+static void dump_get_request_shm_request( const struct get_request_shm_request *req )
+{
+}
+
+static void dump_get_request_shm_reply( const struct get_request_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
 static void dump_terminate_process_request( const struct terminate_process_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1652,6 +1680,15 @@ static void dump_close_handle_request( const struct close_handle_request *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_handle_table_shm_request( const struct get_handle_table_shm_request *req )
+{
+}
+
+static void dump_get_handle_table_shm_reply( const struct get_handle_table_shm_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+}
+
 static void dump_set_handle_info_request( const struct set_handle_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1888,6 +1925,32 @@ static void dump_query_semaphore_reply( const struct query_semaphore_reply *req
     fprintf( stderr, ", max=%08x", req->max );
 }
 
+static void dump_get_fast_sync_shm_request( const struct get_fast_sync_shm_request *req )
+{
+}
+
+static void dump_get_fast_sync_shm_reply( const struct get_fast_sync_shm_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+}
+
+static void dump_get_fast_sync_slot_request( const struct get_fast_sync_slot_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fast_sync_slot_reply( const struct get_fast_sync_slot_reply *req )
+{
+    fprintf( stderr, " index=%08x", req->index );
+    fprintf( stderr, ", serial=%08x", req->serial );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_fast_sync_wake_request( const struct fast_sync_wake_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_open_semaphore_request( const struct open_semaphore_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2200,6 +2263,14 @@ static void dump_is_same_mapping_request( const struct is_same_mapping_request *
     dump_uint64( ", base2=", &req->base2 );
 }
 
+static void dump_add_import_cache_request( const struct add_import_cache_request *req )
+{
+    fprintf( stderr, " hash=%08x", req->hash );
+    fprintf( stderr, ", descr=%08x", req->descr );
+    fprintf( stderr, ", modules=%08x", req->modules );
+    dump_varargs_bytes( ", data=", cur_size );
+}
+
 static void dump_get_mapping_filename_request( const struct get_mapping_filename_request *req )
 {
     fprintf( stderr, " process=%04x", req->process );
@@ -2619,6 +2690,16 @@ static void dump_get_queue_status_reply( const struct get_queue_status_reply *re
     fprintf( stderr, ", changed_bits=%08x", req->changed_bits );
 }
 
+static void dump_get_queue_shm_request( const struct get_queue_shm_request *req )
+{
+}
+
+static void dump_get_queue_shm_reply( const struct get_queue_shm_reply *req )
+{
+    fprintf( stderr, " offset=%08x", req->offset );
+    fprintf( stderr, ", id=%08x", req->id );
+}
+
 static void dump_get_process_idle_event_request( const struct get_process_idle_event_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4284,6 +4365,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_entries( " entries=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4294,6 +4385,39 @@ static void dump_query_completion_reply( const struct query_completion_reply *re
     fprintf( stderr, " depth=%08x", req->depth );
 }
 
+static void dump_create_wait_completion_packet_request( const struct create_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " access=%08x", req->access );
+    dump_varargs_object_attributes( ", objattr=", cur_size );
+}
+
+static void dump_create_wait_completion_packet_reply( const struct create_wait_completion_packet_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_associate_wait_completion_packet_request( const struct associate_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " packet=%04x", req->packet );
+    fprintf( stderr, ", completion=%04x", req->completion );
+    fprintf( stderr, ", target=%04x", req->target );
+    dump_uint64( ", ckey=", &req->ckey );
+    dump_uint64( ", cvalue=", &req->cvalue );
+    dump_uint64( ", information=", &req->information );
+    fprintf( stderr, ", status=%08x", req->status );
+}
+
+static void dump_associate_wait_completion_packet_reply( const struct associate_wait_completion_packet_reply *req )
+{
+    fprintf( stderr, " signaled=%d", req->signaled );
+}
+
+static void dump_cancel_wait_completion_packet_request( const struct cancel_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " packet=%04x", req->packet );
+    fprintf( stderr, ", remove_signaled=%d", req->remove_signaled );
+}
+
 static void dump_set_completion_info_request( const struct set_completion_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4522,6 +4646,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_init_process_done_request,
     (dump_func)dump_init_first_thread_request,
     (dump_func)dump_init_thread_request,
+    (dump_func)dump_get_request_shm_request,
     (dump_func)dump_terminate_process_request,
     (dump_func)dump_terminate_thread_request,
     (dump_func)dump_get_process_info_request,
@@ -4537,6 +4662,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_request,
     (dump_func)dump_get_apc_result_request,
     (dump_func)dump_close_handle_request,
+    (dump_func)dump_get_handle_table_shm_request,
     (dump_func)dump_set_handle_info_request,
     (dump_func)dump_dup_handle_request,
     (dump_func)dump_compare_objects_request,
@@ -4557,6 +4683,9 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_semaphore_request,
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
+    (dump_func)dump_get_fast_sync_shm_request,
+    (dump_func)dump_get_fast_sync_slot_request,
+    (dump_func)dump_fast_sync_wake_request,
     (dump_func)dump_open_semaphore_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
@@ -4584,6 +4713,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_committed_range_request,
     (dump_func)dump_add_mapping_committed_range_request,
     (dump_func)dump_is_same_mapping_request,
+    (dump_func)dump_add_import_cache_request,
     (dump_func)dump_get_mapping_filename_request,
     (dump_func)dump_list_processes_request,
     (dump_func)dump_create_debug_obj_request,
@@ -4625,6 +4755,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_queue_fd_request,
     (dump_func)dump_set_queue_mask_request,
     (dump_func)dump_get_queue_status_request,
+    (dump_func)dump_get_queue_shm_request,
     (dump_func)dump_get_process_idle_event_request,
     (dump_func)dump_send_message_request,
     (dump_func)dump_post_quit_message_request,
@@ -4767,7 +4898,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
+    (dump_func)dump_create_wait_completion_packet_request,
+    (dump_func)dump_associate_wait_completion_packet_request,
+    (dump_func)dump_cancel_wait_completion_packet_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
     (dump_func)dump_set_fd_completion_mode_request,
@@ -4803,6 +4938,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_init_process_done_reply,
     (dump_func)dump_init_first_thread_reply,
     (dump_func)dump_init_thread_reply,
+    (dump_func)dump_get_request_shm_reply,
     (dump_func)dump_terminate_process_reply,
     (dump_func)dump_terminate_thread_reply,
     (dump_func)dump_get_process_info_reply,
@@ -4818,6 +4954,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_reply,
     (dump_func)dump_get_apc_result_reply,
     NULL,
+    (dump_func)dump_get_handle_table_shm_reply,
     (dump_func)dump_set_handle_info_reply,
     (dump_func)dump_dup_handle_reply,
     NULL,
@@ -4838,6 +4975,9 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_semaphore_reply,
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
+    (dump_func)dump_get_fast_sync_shm_reply,
+    (dump_func)dump_get_fast_sync_slot_reply,
+    NULL,
     (dump_func)dump_open_semaphore_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
@@ -4865,6 +5005,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_committed_range_reply,
     NULL,
     NULL,
+    NULL,
     (dump_func)dump_get_mapping_filename_reply,
     (dump_func)dump_list_processes_reply,
     (dump_func)dump_create_debug_obj_reply,
@@ -4906,6 +5047,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_set_queue_mask_reply,
     (dump_func)dump_get_queue_status_reply,
+    (dump_func)dump_get_queue_shm_reply,
     (dump_func)dump_get_process_idle_event_reply,
     NULL,
     NULL,
@@ -5048,7 +5190,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
+    (dump_func)dump_create_wait_completion_packet_reply,
+    (dump_func)dump_associate_wait_completion_packet_reply,
+    NULL,
     NULL,
     NULL,
     NULL,
@@ -5084,6 +5230,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "init_process_done",
     "init_first_thread",
     "init_thread",
+    "get_request_shm",
     "terminate_process",
     "terminate_thread",
     "get_process_info",
@@ -5099,6 +5246,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "queue_apc",
     "get_apc_result",
     "close_handle",
+    "get_handle_table_shm",
     "set_handle_info",
     "dup_handle",
     "compare_objects",
@@ -5119,6 +5267,9 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "create_semaphore",
     "release_semaphore",
     "query_semaphore",
+    "get_fast_sync_shm",
+    "get_fast_sync_slot",
+    "fast_sync_wake",
     "open_semaphore",
     "create_file",
     "open_file_object",
@@ -5146,6 +5297,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_mapping_committed_range",
     "add_mapping_committed_range",
     "is_same_mapping",
+    "add_import_cache",
     "get_mapping_filename",
     "list_processes",
     "create_debug_obj",
@@ -5187,6 +5339,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_queue_fd",
     "set_queue_mask",
     "get_queue_status",
+    "get_queue_shm",
     "get_process_idle_event",
     "send_message",
     "post_quit_message",
@@ -5329,7 +5482,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
+    "create_wait_completion_packet",
+    "associate_wait_completion_packet",
+    "cancel_wait_completion_packet",
     "set_completion_info",
     "add_fd_completion",
     "set_fd_completion_mode",
@@ -5427,6 +5584,7 @@ static const struct
     { "INVALID_LOCK_SEQUENCE",       STATUS_INVALID_LOCK_SEQUENCE },
     { "INVALID_OWNER",               STATUS_INVALID_OWNER },
     { "INVALID_PARAMETER",           STATUS_INVALID_PARAMETER },
+    { "INVALID_PARAMETER_1",         STATUS_INVALID_PARAMETER_1 },
     { "INVALID_PIPE_STATE",          STATUS_INVALID_PIPE_STATE },
     { "INVALID_READ_MODE",           STATUS_INVALID_READ_MODE },
     { "INVALID_SECURITY_DESCR",      STATUS_INVALID_SECURITY_DESCR },
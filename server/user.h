@@ -77,6 +77,7 @@ struct desktop
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
     unsigned char        keystate[256];    /* asynchronous key state */
+    struct desktop_shm  *shm;              /* input state in the user shared memory */
 };
 
 /* user handles functions */
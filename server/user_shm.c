@@ -0,0 +1,154 @@
+/*
+ * Server-side user shared memory
+ *
+ * The input state of desktops, thread inputs and message queues, and the
+ * state of the windows are mirrored in a section that all the clients map
+ * read-only, so that win32u can query it without a server round trip. Every
+ * object starts with a sequence number that is odd while the server updates
+ * it; readers copy the object and retry until they saw the same even sequence
+ * number before and after the copy. The start of the section holds a table
+ * indexed by user handle that gives the location of the mirrored objects.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "request.h"
+
+#define USER_SHM_ALIGN        64  /* allocation granularity */
+#define USER_SHM_NB_CLASSES   16  /* number of size classes, up to 1024 bytes */
+
+struct free_list
+{
+    unsigned int *offsets;        /* stack of free block offsets */
+    unsigned int  count;          /* number of entries in the stack */
+    unsigned int  size;           /* allocated size of the stack */
+};
+
+static char *user_shm;                                 /* base of the shared section */
+static unsigned int user_shm_used;                     /* end of the allocated part of the section */
+static unsigned int user_shm_last_id;                  /* last allocated object id */
+static struct free_list free_lists[USER_SHM_NB_CLASSES];
+
+/* create the shared section holding the objects */
+void init_user_shm( struct object *root, const struct unicode_str *name )
+{
+    struct object *mapping;
+    void *ptr;
+
+    if (!(mapping = create_shared_mapping( root, name, OBJ_PERMANENT, USER_SHM_SIZE, NULL, &ptr )))
+        return;
+    user_shm = ptr;
+    user_shm_used = USER_SHM_HANDLES_OFFSET + USER_SHM_MAX_HANDLES * sizeof(struct user_handle_shm);
+    user_shm_used = (user_shm_used + USER_SHM_ALIGN - 1) & ~(USER_SHM_ALIGN - 1);
+    release_object( mapping );
+}
+
+/* start modifying an object; clients retry reading it until user_shm_write_end */
+void user_shm_write_begin( struct user_shm_header *hdr )
+{
+    __atomic_store_n( &hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+void user_shm_write_end( struct user_shm_header *hdr )
+{
+    __atomic_store_n( &hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE );
+}
+
+/* allocate a zeroed object; return NULL if the shared memory is not available */
+void *alloc_user_shm( data_size_t size )
+{
+    unsigned int class = (size + USER_SHM_ALIGN - 1) / USER_SHM_ALIGN - 1;
+    struct user_shm_header *hdr;
+    unsigned int offset;
+
+    if (!user_shm || class >= USER_SHM_NB_CLASSES) return NULL;
+    size = (class + 1) * USER_SHM_ALIGN;
+
+    if (free_lists[class].count) offset = free_lists[class].offsets[--free_lists[class].count];
+    else if (user_shm_used + size <= USER_SHM_SIZE)
+    {
+        offset = user_shm_used;
+        user_shm_used += size;
+    }
+    else return NULL;
+
+    hdr = (struct user_shm_header *)(user_shm + offset);
+    user_shm_write_begin( hdr );
+    memset( hdr + 1, 0, size - sizeof(*hdr) );
+    if (!++user_shm_last_id) ++user_shm_last_id;
+    hdr->id = user_shm_last_id;
+    user_shm_write_end( hdr );
+    return hdr;
+}
+
+/* free an object allocated with alloc_user_shm */
+void free_user_shm( void *ptr, data_size_t size )
+{
+    unsigned int class = (size + USER_SHM_ALIGN - 1) / USER_SHM_ALIGN - 1;
+    struct free_list *list = &free_lists[class];
+    struct user_shm_header *hdr = ptr;
+
+    if (!hdr) return;
+    user_shm_write_begin( hdr );
+    hdr->id = 0;
+    user_shm_write_end( hdr );
+
+    if (list->count == list->size)
+    {
+        unsigned int new_size = max( 16, list->size * 2 );
+        unsigned int *new_offsets = realloc( list->offsets, new_size * sizeof(*new_offsets) );
+
+        if (!new_offsets) return;  /* leak the block */
+        list->offsets = new_offsets;
+        list->size = new_size;
+    }
+    list->offsets[list->count++] = (char *)hdr - user_shm;
+}
+
+/* get the offset of an object in the shared section, 0 if none */
+unsigned int get_user_shm_offset( const void *ptr )
+{
+    return ptr ? (const char *)ptr - user_shm : 0;
+}
+
+/* set the object mirroring a user handle in the handle table, or clear it if ptr is NULL */
+void set_user_handle_shm( user_handle_t handle, const void *ptr )
+{
+    unsigned int index = ((handle & 0xffff) - FIRST_USER_HANDLE) >> 1;
+    struct user_handle_shm *entry;
+
+    if (!user_shm || index >= USER_SHM_MAX_HANDLES) return;
+    entry = (struct user_handle_shm *)(user_shm + USER_SHM_HANDLES_OFFSET) + index;
+    user_shm_write_begin( &entry->hdr );
+    entry->hdr.id = ptr ? handle : 0;
+    entry->offset = get_user_shm_offset( ptr );
+    entry->id     = ptr ? ((const struct user_shm_header *)ptr)->id : 0;
+    user_shm_write_end( &entry->hdr );
+}
@@ -94,6 +94,11 @@ struct window
     struct property *properties;      /* window properties array */
     int              nb_extra_bytes;  /* number of extra bytes */
     char            *extra_bytes;     /* extra bytes storage */
+    struct window_shm *shm;           /* state mirrored in the user shared memory */
+    struct region   *vis_rgn;         /* cached visible region (relative to window rect) */
+    unsigned int     vis_rgn_flags;   /* DCX_* flags the cached visible region was computed for */
+    unsigned int     vis_rgn_computed;/* number of visible region computations */
+    unsigned int     vis_rgn_reused;  /* number of times the cached visible region was reused */
 };
 
 static void window_dump( struct object *obj, int verbose );
@@ -160,7 +165,8 @@ static void window_dump( struct object *obj, int verbose )
 {
     struct window *win = (struct window *)obj;
     assert( obj->ops == &window_ops );
-    fprintf( stderr, "window %p handle %x\n", win, win->handle );
+    fprintf( stderr, "window %p handle %x vis_rgn computed %u reused %u\n",
+             win, win->handle, win->vis_rgn_computed, win->vis_rgn_reused );
 }
 
 static void window_destroy( struct object *obj )
@@ -177,6 +183,7 @@ static void window_destroy( struct object *obj )
 
     if (win->win_region) free_region( win->win_region );
     if (win->update_region) free_region( win->update_region );
+    if (win->vis_rgn) free_region( win->vis_rgn );
     if (win->class) release_class( win->class );
     free( win->text );
 
@@ -237,6 +244,91 @@ static inline struct window *get_last_child( struct window *win )
     return ptr ? LIST_ENTRY( ptr, struct window, entry ) : NULL;
 }
 
+/* update the window state mirrored in the user shared memory */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *shm = win->shm;
+
+    if (!shm) return;
+    user_shm_write_begin( &shm->hdr );
+    shm->handle      = win->handle;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->is_unicode  = win->is_unicode;
+    shm->dpi         = win->dpi;
+    shm->awareness   = win->dpi_awareness;
+    shm->window_rect = win->window_rect;
+    shm->client_rect = win->client_rect;
+    user_shm_write_end( &shm->hdr );
+}
+
+/* let the clients know that the list of children of a window has changed */
+static void invalidate_window_children( struct window *win )
+{
+    struct window_shm *shm = win->shm;
+
+    if (!shm) return;
+    user_shm_write_begin( &shm->hdr );
+    shm->zorder_gen++;
+    user_shm_write_end( &shm->hdr );
+}
+
+/* remove the window from the user shared memory */
+static void free_window_shm( struct window *win )
+{
+    if (!win->shm) return;
+    set_user_handle_shm( win->handle, NULL );
+    free_user_shm( win->shm, sizeof(*win->shm) );
+    win->shm = NULL;
+}
+
+/* invalidate the cached visible regions of a window and all its descendants */
+static void invalidate_vis_rgn_tree( struct window *win )
+{
+    struct window *child;
+
+    if (win->vis_rgn)
+    {
+        free_region( win->vis_rgn );
+        win->vis_rgn = NULL;
+    }
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        invalidate_vis_rgn_tree( child );
+    LIST_FOR_EACH_ENTRY( child, &win->unlinked, struct window, entry )
+        invalidate_vis_rgn_tree( child );
+}
+
+/* invalidate the cached visible regions that depend on the position, shape or visibility of a window */
+static void invalidate_vis_rgn( struct window *win )
+{
+    struct window *ptr;
+
+    invalidate_vis_rgn_tree( win );
+
+    /* top-level windows are not clipped by their siblings, and the desktop isn't clipped at all */
+    if (!win->parent || is_desktop_window( win->parent )) return;
+
+    /* the parent clips its children, the siblings below the window clip it out */
+    if (win->parent->vis_rgn)
+    {
+        free_region( win->parent->vis_rgn );
+        win->parent->vis_rgn = NULL;
+    }
+    if (!win->is_linked) return;
+    for (ptr = get_next_window( win ); ptr; ptr = get_next_window( ptr ))
+        invalidate_vis_rgn_tree( ptr );
+}
+
+/* invalidate the cached visible regions that depend on the z-order of the children of a window */
+static void invalidate_children_vis_rgn( struct window *parent )
+{
+    if (!is_desktop_window( parent )) invalidate_vis_rgn_tree( parent );
+}
+
 /* set the PAINT_PIXEL_FORMAT_CHILD flag on all the parents */
 /* note: we never reset the flag, it's just a heuristic */
 static inline void update_pixel_format_flags( struct window *win )
@@ -309,6 +401,9 @@ static int link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    if (old_prev != win->entry.prev) invalidate_children_vis_rgn( win->parent );
+    invalidate_window_children( win->parent );
+    update_window_shm( win );
     return old_prev != win->entry.prev;
 }
 
@@ -327,6 +422,12 @@ static int set_parent_window( struct window *win, struct window *parent )
         }
     }
 
+    if (win->parent)
+    {
+        invalidate_window_children( win->parent );
+        invalidate_vis_rgn( win );
+    }
+
     if (parent)
     {
         if (win->parent) release_object( win->parent );
@@ -354,6 +455,8 @@ static int set_parent_window( struct window *win, struct window *parent )
         win->is_linked = 0;
         win->is_orphan = 1;
     }
+    invalidate_vis_rgn_tree( win );
+    update_window_shm( win );
     return 1;
 }
 
@@ -492,6 +595,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -584,6 +688,11 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->properties     = NULL;
     win->nb_extra_bytes = 0;
     win->extra_bytes    = NULL;
+    win->shm            = NULL;
+    win->vis_rgn        = NULL;
+    win->vis_rgn_flags  = 0;
+    win->vis_rgn_computed = 0;
+    win->vis_rgn_reused = 0;
     win->window_rect = win->visible_rect = win->surface_rect = win->client_rect = empty_rect;
     list_init( &win->children );
     list_init( &win->unlinked );
@@ -625,6 +734,12 @@ static struct window *create_window( struct window *parent, struct window *owner
         }
     }
 
+    if ((win->shm = alloc_user_shm( sizeof(*win->shm) )))
+    {
+        update_window_shm( win );
+        set_user_handle_shm( win->handle, win->shm );
+    }
+
     current->desktop_users++;
     return win;
 
@@ -1115,7 +1230,7 @@ static inline struct window *get_top_clipping_window( struct window *win )
 
 
 /* compute the visible region of a window, in window coordinates */
-static struct region *get_visible_region( struct window *win, unsigned int flags )
+static struct region *compute_visible_region( struct window *win, unsigned int flags )
 {
     struct region *tmp = NULL, *region;
     int offset_x, offset_y;
@@ -1194,6 +1309,39 @@ error:
 }
 
 
+/* get the visible region of a window, in window coordinates, reusing the cached one if possible */
+static struct region *get_visible_region( struct window *win, unsigned int flags )
+{
+    struct region *region;
+
+    flags &= DCX_PARENTCLIP | DCX_WINDOW | DCX_CLIPCHILDREN;  /* the only ones that matter */
+
+    if (win->vis_rgn && win->vis_rgn_flags == flags)
+    {
+        if (!(region = create_empty_region())) return NULL;
+        if (!copy_region( region, win->vis_rgn ))
+        {
+            free_region( region );
+            return NULL;
+        }
+        win->vis_rgn_reused++;
+        return region;
+    }
+
+    if (!(region = compute_visible_region( win, flags ))) return NULL;
+    win->vis_rgn_computed++;
+
+    if (!win->vis_rgn && !(win->vis_rgn = create_empty_region())) return region;
+    if (copy_region( win->vis_rgn, region )) win->vis_rgn_flags = flags;
+    else
+    {
+        free_region( win->vis_rgn );
+        win->vis_rgn = NULL;
+    }
+    return region;
+}
+
+
 /* clip all children with a custom pixel format out of the visible region */
 static struct region *clip_pixel_format_children( struct window *parent, struct region *parent_clip,
                                                   struct region *region, int offset_x, int offset_y )
@@ -1824,8 +1972,11 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
+    invalidate_vis_rgn( win );
+    update_window_shm( win );
 
     /* reset cursor clip rectangle when the desktop changes size */
     if (win == win->desktop->top_window) win->desktop->cursor.clip = *window_rect;
@@ -1965,6 +2116,7 @@ static void set_window_region( struct window *win, struct region *region, int re
 
     if (win->win_region) free_region( win->win_region );
     win->win_region = region;
+    invalidate_vis_rgn( win );
 
     /* expose anything revealed by the change */
     if (old_vis_rgn && ((exposed_rgn = expose_window( win, &win->window_rect, old_vis_rgn, 0 ))))
@@ -1990,6 +2142,7 @@ void free_window_handle( struct window *win )
     {
         struct region *vis_rgn = get_visible_region( win, DCX_WINDOW );
         win->style &= ~WS_VISIBLE;
+        invalidate_vis_rgn( win );
         if (vis_rgn)
         {
             struct region *exposed_rgn = expose_window( win, &win->window_rect, vis_rgn, 0 );
@@ -1998,6 +2151,7 @@ void free_window_handle( struct window *win )
         }
         validate_whole_window( win );
         validate_children( win );
+        update_window_shm( win );
     }
 
     /* destroy all children */
@@ -2017,6 +2171,10 @@ void free_window_handle( struct window *win )
         else
             send_notify_message( child->handle, WM_WINE_DESTROYWINDOW, 0, 0 );
     }
+    /* the remaining children will be destroyed by their own thread, stop mirroring */
+    /* them since their parent is about to lose its handle */
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        if (child->handle) set_user_handle_shm( child->handle, NULL );
 
     /* reset global window pointers, if the corresponding window is destroyed */
     if (win == shell_window) shell_window = NULL;
@@ -2041,6 +2199,7 @@ void free_window_handle( struct window *win )
     detach_window_thread( win );
 
     if (win->parent) set_parent_window( win, NULL );
+    free_window_shm( win );
     free_user_handle( win->handle );
     win->handle = 0;
     release_object( win );
@@ -2096,6 +2255,7 @@ DECL_HANDLER(create_window)
     }
     win->style = req->style;
     win->ex_style = req->ex_style;
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2163,6 +2323,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2175,6 +2336,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2210,6 +2372,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2281,6 +2444,12 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_USERDATA) win->user_data = req->user_data;
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE | SET_WIN_UNICODE)) update_window_shm( win );
+
+    /* the visible region depends on these styles, WS_MINIMIZE through is_visible() on the children */
+    if (((reply->old_style ^ win->style) & (WS_VISIBLE | WS_CLIPSIBLINGS | WS_MINIMIZE)) ||
+        ((reply->old_ex_style ^ win->ex_style) & WS_EX_TRANSPARENT))
+        invalidate_vis_rgn( win );
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
@@ -2806,6 +2975,8 @@ DECL_HANDLER(update_window_zorder)
         {
             list_remove( &win->entry );
             list_add_before( &ptr->entry, &win->entry );
+            invalidate_children_vis_rgn( win->parent );
+            invalidate_window_children( win->parent );
         }
         break;
     }